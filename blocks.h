@@ -1,15 +1,83 @@
 #ifndef CHOWDER_BLOCK
 #define CHOWDER_BLOCK
 
-#include "include/hashmap.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-#ifdef BLOCK_NAMES
-extern size_t block_names_len;
-extern char **block_names;
+/* The tables below live in blocks_gen.c, which the Makefile generates from
+ * gamedata/blocks.json + gamedata/block_attributes.txt with utils/blockgen.
+ * They're plain constant data, so they're ready as soon as the process
+ * starts. */
 
-void free_block_names();
-#endif
+/* block state ID -> "name;property=value;..." w/ properties sorted */
+extern const size_t block_names_len;
+extern const char *const block_names[];
+
+struct block_key {
+	const char *name;
+	uint16_t id;
+};
+
+/* a minimal perfect hash of every block state's name, plus the bare name of
+ * every block for its default state. see block_id() */
+extern const size_t block_keys_len;
+extern const struct block_key block_keys[];
+extern const size_t block_key_seeds_len;
+extern const uint16_t block_key_seeds[];
+
+/* FNV-1a + a murmur3 finalizer, seeded so utils/blockgen can try different
+ * hashes until every key gets its own slot */
+static inline uint32_t block_key_hash(const char *key, size_t len, uint32_t seed) {
+	uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+	for (size_t i = 0; i < len; ++i)
+		h = (h ^ (uint8_t) key[i]) * 16777619u;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+enum block_flag {
+	BLOCK_AIR = 1,
+	/* light + sight don't go through it */
+	BLOCK_OPAQUE = 2,
+	/* stops the MOTION_BLOCKING heightmap: anything with a collision box,
+	 * or a fluid */
+	BLOCK_MOTION_BLOCKING = 4,
+};
+
+enum block_shape {
+	BLOCK_SHAPE_EMPTY,
+	BLOCK_SHAPE_PARTIAL,
+	BLOCK_SHAPE_FULL,
+};
+
+/* per-state attributes from gamedata/block_attributes.txt, indexed by state
+ * ID so the hot loops over sections are one load per block. light levels
+ * are 0-15 */
+extern const uint8_t block_flags[];
+extern const uint8_t block_light_emission[];
+extern const uint8_t block_light_filter[];
+/* enum block_shape */
+extern const uint8_t block_shapes[];
+
+static inline bool block_is_air(uint16_t id) {
+	return block_flags[id] & BLOCK_AIR;
+}
+
+static inline bool block_is_opaque(uint16_t id) {
+	return block_flags[id] & BLOCK_OPAQUE;
+}
+
+static inline bool block_motion_blocking(uint16_t id) {
+	return block_flags[id] & BLOCK_MOTION_BLOCKING;
+}
 
-struct hashmap *create_block_table(char *block_json_path);
+/* takes a name like "minecraft:water;level=5", or just "minecraft:water" for
+ * the default state. returns its block state ID, or -1 */
+int block_id(const char *name, size_t len);
 
 #endif
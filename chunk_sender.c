@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chunk_sender.h"
+#include "conn.h"
+#include "protocol.h"
+#include "world.h"
+
+enum chunk_state {
+	CHUNK_UNSENT = 0,
+	/* sent to the client or queued to be, and the sender holds a ticket
+	 * for it */
+	CHUNK_SENT,
+	/* there's no chunk there, so there was nothing to send */
+	CHUNK_EMPTY,
+};
+
+/* offsets from the view center, ring by ring, so chunks closer to the
+ * player always come first */
+#define SPIRAL_LEN (CHUNK_SENDER_WIDTH * CHUNK_SENDER_WIDTH)
+static int spiral[SPIRAL_LEN][2];
+static bool spiral_built = false;
+
+static void build_spiral() {
+	int i = 0;
+	spiral[i][0] = 0;
+	spiral[i][1] = 0;
+	++i;
+	for (int d = 1; d <= MAX_VIEW_DISTANCE; ++d) {
+		/* walk around the ring, starting from its north-west corner */
+		for (int x = -d; x < d; ++x, ++i) {
+			spiral[i][0] = x;
+			spiral[i][1] = -d;
+		}
+		for (int z = -d; z < d; ++z, ++i) {
+			spiral[i][0] = d;
+			spiral[i][1] = z;
+		}
+		for (int x = d; x > -d; --x, ++i) {
+			spiral[i][0] = x;
+			spiral[i][1] = d;
+		}
+		for (int z = d; z > -d; --z, ++i) {
+			spiral[i][0] = -d;
+			spiral[i][1] = z;
+		}
+	}
+	spiral_built = true;
+}
+
+static int spiral_len(int radius) {
+	return (2 * radius + 1) * (2 * radius + 1);
+}
+
+static uint8_t *chunk_state(struct chunk_sender *s, int x, int z) {
+	int i = ((x % CHUNK_SENDER_WIDTH) + CHUNK_SENDER_WIDTH) % CHUNK_SENDER_WIDTH;
+	int j = ((z % CHUNK_SENDER_WIDTH) + CHUNK_SENDER_WIDTH) % CHUNK_SENDER_WIDTH;
+	return &(s->state[j][i]);
+}
+
+static bool in_view(int center_x, int center_z, int radius, int x, int z) {
+	return abs(x - center_x) <= radius && abs(z - center_z) <= radius;
+}
+
+void chunk_sender_init(struct chunk_sender *s, int x, int z, int radius) {
+	if (!spiral_built)
+		build_spiral();
+
+	memset(s, 0, sizeof(struct chunk_sender));
+	s->x = x;
+	s->z = z;
+	/* past MAX_VIEW_DISTANCE chunks would share states, and some tickets
+	 * would never be given back */
+	if (radius < MIN_VIEW_DISTANCE)
+		radius = MIN_VIEW_DISTANCE;
+	else if (radius > MAX_VIEW_DISTANCE)
+		radius = MAX_VIEW_DISTANCE;
+	s->radius = radius;
+}
+
+int chunk_sender_move(struct conn *c, struct world *w, int x, int z) {
+	struct chunk_sender *s = &(c->player->sender);
+	if (s->x == x && s->z == z)
+		return 0;
+
+	for (int c_z = s->z - s->radius; c_z <= s->z + s->radius; ++c_z) {
+		for (int c_x = s->x - s->radius; c_x <= s->x + s->radius; ++c_x) {
+			if (in_view(x, z, s->radius, c_x, c_z))
+				continue;
+
+			uint8_t *state = chunk_state(s, c_x, c_z);
+			if (*state == CHUNK_SENT) {
+				world_remove_ticket(w, c_x, c_z);
+				if (unload_chunk(c, c_x, c_z) < 0)
+					return -1;
+			}
+			*state = CHUNK_UNSENT;
+		}
+	}
+
+	s->x = x;
+	s->z = z;
+	s->next = 0;
+	return update_view_position(c, x, z);
+}
+
+void chunk_sender_plan(struct conn *c, struct world *w, size_t max_bytes) {
+	struct chunk_sender *s = &(c->player->sender);
+	int len = spiral_len(s->radius);
+	/* until a chunk has been sent there's nothing to go on, so that's one */
+	size_t estimate = s->chunk_bytes > 0 ? s->chunk_bytes : max_bytes;
+	size_t planned = 0;
+	while (s->next < len && s->queue_len < CHUNK_SENDER_QUEUE_LEN
+			&& (s->queue_len == 0 || planned < max_bytes)) {
+		int x = s->x + spiral[s->next][0];
+		int z = s->z + spiral[s->next][1];
+		uint8_t *state = chunk_state(s, x, z);
+		if (*state == CHUNK_UNSENT) {
+			struct chunk *chunk = world_add_ticket(w, x, z);
+			if (chunk == NULL) {
+				*state = CHUNK_EMPTY;
+			} else {
+				*state = CHUNK_SENT;
+				s->queue[s->queue_len].x = x;
+				s->queue[s->queue_len].z = z;
+				s->queue[s->queue_len].chunk = chunk;
+				++(s->queue_len);
+				planned += estimate;
+			}
+		}
+		++(s->next);
+	}
+}
+
+ssize_t chunk_sender_send(struct conn *c) {
+	struct chunk_sender *s = &(c->player->sender);
+	size_t sent = 0;
+	for (int i = 0; i < s->queue_len; ++i) {
+		int x = s->queue[i].x;
+		int z = s->queue[i].z;
+		int n = chunk_data(c, s->queue[i].chunk, x, z, true);
+		if (n < 0) {
+			fprintf(stderr, "error sending chunk (%d, %d)\n", x, z);
+			/* the rest still hold tickets, which chunk_sender_finish()
+			 * gives back */
+			s->queue_len = 0;
+			return -1;
+		}
+		sent += n;
+		s->chunk_bytes = s->chunk_bytes > 0 ? (3 * s->chunk_bytes + n) / 4 : (size_t) n;
+	}
+	s->queue_len = 0;
+	return sent;
+}
+
+ssize_t chunk_sender_tick(struct conn *c, struct world *w, size_t max_bytes) {
+	chunk_sender_plan(c, w, max_bytes);
+	return chunk_sender_send(c);
+}
+
+void chunk_sender_finish(struct chunk_sender *s, struct world *w) {
+	for (int c_z = s->z - s->radius; c_z <= s->z + s->radius; ++c_z) {
+		for (int c_x = s->x - s->radius; c_x <= s->x + s->radius; ++c_x) {
+			uint8_t *state = chunk_state(s, c_x, c_z);
+			if (*state == CHUNK_SENT)
+				world_remove_ticket(w, c_x, c_z);
+			*state = CHUNK_UNSENT;
+		}
+	}
+}
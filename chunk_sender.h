@@ -0,0 +1,73 @@
+/* Streams the chunks around a player to its client, nearest first, a limited
+ * number of bytes at a time, and unloads the ones it moves away from.
+ *
+ * Sending is split in two so the expensive half can run off the tick
+ * thread: chunk_sender_plan() takes tickets for the next chunks (loading
+ * them if it has to) and queues them, and chunk_sender_send() only encodes
+ * + writes what's queued, without touching the world.
+ */
+#ifndef CHOWDER_CHUNK_SENDER_H
+#define CHOWDER_CHUNK_SENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MIN_VIEW_DISTANCE 2
+#define MAX_VIEW_DISTANCE 32
+
+/* width of the grid tracking which chunks the client has */
+#define CHUNK_SENDER_WIDTH (2 * MAX_VIEW_DISTANCE + 1)
+/* most chunks that can be planned at once */
+#define CHUNK_SENDER_QUEUE_LEN 64
+
+struct chunk;
+struct conn;
+struct world;
+
+struct chunk_sender {
+	/* chunk coords of the client's view center */
+	int x;
+	int z;
+	/* the view distance every ticket the sender holds was taken with.
+	 * it's fixed at chunk_sender_init(), so moving + finishing release
+	 * exactly the chunks that were taken, whatever the player's
+	 * view_distance says by then */
+	int radius;
+	/* index in the spiral around x,z of the next chunk to send */
+	int next;
+	/* what the client has for every chunk in view, see chunk_sender.c.
+	 * indexed by chunk coords modulo CHUNK_SENDER_WIDTH */
+	uint8_t state[CHUNK_SENDER_WIDTH][CHUNK_SENDER_WIDTH];
+
+	/* planned chunks that haven't been sent yet, with their chunk coords */
+	int queue_len;
+	struct {
+		int x;
+		int z;
+		const struct chunk *chunk;
+	} queue[CHUNK_SENDER_QUEUE_LEN];
+	/* running average of the bytes a chunk takes to send, for planning.
+	 * 0 until the first one is sent */
+	size_t chunk_bytes;
+};
+
+/* radius is clamped to MIN_VIEW_DISTANCE..MAX_VIEW_DISTANCE */
+void chunk_sender_init(struct chunk_sender *, int x, int z, int radius);
+/* moves the view center to chunk x,z, unloading + releasing the chunks that
+ * are out of view afterwards, and starts sending from the new center. has
+ * to be called with nothing planned */
+int chunk_sender_move(struct conn *, struct world *, int x, int z);
+/* takes tickets for + queues the nearest unsent chunks, as many as should
+ * take about max_bytes to send (always at least one). tick thread only */
+void chunk_sender_plan(struct conn *, struct world *, size_t max_bytes);
+/* sends everything planned. the world must not change while it runs, but
+ * it doesn't touch the world itself so it can run on any thread. returns
+ * the # of bytes sent, or -1 */
+ssize_t chunk_sender_send(struct conn *);
+/* plans + sends right away */
+ssize_t chunk_sender_tick(struct conn *, struct world *, size_t max_bytes);
+/* releases the tickets for every chunk the client has */
+void chunk_sender_finish(struct chunk_sender *, struct world *);
+
+#endif
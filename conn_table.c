@@ -0,0 +1,79 @@
+#include <stdlib.h>
+
+#include "conn_table.h"
+
+#define MIN_CAP 8
+#define NO_SLOT UINT32_MAX
+
+void conn_table_init(struct conn_table *t) {
+	*t = (struct conn_table) {0};
+	t->free_slot = NO_SLOT;
+}
+
+void conn_table_finish(struct conn_table *t) {
+	free(t->conns);
+	free(t->conn_slots);
+	free(t->slots);
+	conn_table_init(t);
+}
+
+/* conns + slots grow together, since there's never more slots than the
+ * most connections there's been at once */
+static void grow(struct conn_table *t) {
+	t->cap = t->cap > 0 ? t->cap * 2 : MIN_CAP;
+	t->conns = realloc(t->conns, sizeof(struct conn) * t->cap);
+	t->conn_slots = realloc(t->conn_slots, sizeof(uint32_t) * t->cap);
+	t->slots = realloc(t->slots, sizeof(struct conn_slot) * t->cap);
+}
+
+struct conn_handle conn_table_add(struct conn_table *t, const struct conn *c) {
+	if (t->len == t->cap)
+		grow(t);
+
+	uint32_t slot = t->free_slot;
+	if (slot != NO_SLOT) {
+		t->free_slot = t->slots[slot].index;
+	} else {
+		slot = t->slots_len++;
+		t->slots[slot].generation = 1;
+	}
+	t->slots[slot].index = t->len;
+
+	t->conns[t->len] = *c;
+	t->conn_slots[t->len] = slot;
+	++(t->len);
+	return (struct conn_handle) {slot, t->slots[slot].generation};
+}
+
+struct conn *conn_table_get(struct conn_table *t, struct conn_handle h) {
+	if (h.slot >= t->slots_len || t->slots[h.slot].generation != h.generation)
+		return NULL;
+	return &(t->conns[t->slots[h.slot].index]);
+}
+
+struct conn_handle conn_table_handle(const struct conn_table *t, size_t i) {
+	uint32_t slot = t->conn_slots[i];
+	return (struct conn_handle) {slot, t->slots[slot].generation};
+}
+
+void conn_table_remove_at(struct conn_table *t, size_t i) {
+	uint32_t slot = t->conn_slots[i];
+	/* outdates every handle to the slot */
+	if (++(t->slots[slot].generation) == 0)
+		t->slots[slot].generation = 1;
+	t->slots[slot].index = t->free_slot;
+	t->free_slot = slot;
+
+	size_t last = --(t->len);
+	if (i != last) {
+		t->conns[i] = t->conns[last];
+		t->conn_slots[i] = t->conn_slots[last];
+		t->slots[t->conn_slots[i]].index = i;
+	}
+}
+
+void conn_table_remove(struct conn_table *t, struct conn_handle h) {
+	struct conn *c = conn_table_get(t, h);
+	if (c != NULL)
+		conn_table_remove_at(t, c - t->conns);
+}
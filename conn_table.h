@@ -0,0 +1,57 @@
+/* Every live connection, stored by value in one dense array so the tick
+ * loop walks contiguous memory. Removing a connection moves the last one
+ * into its place, so anything that has to find a connection again later
+ * holds a handle instead of a pointer or index: handles stay valid until
+ * their connection is removed, and are never mistaken for whichever
+ * connection reuses the slot afterwards.
+ */
+#ifndef CHOWDER_CONN_TABLE_H
+#define CHOWDER_CONN_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "conn.h"
+
+struct conn_handle {
+	uint32_t slot;
+	/* 0 is never handed out, so a zeroed handle is always stale */
+	uint32_t generation;
+};
+
+struct conn_slot {
+	uint32_t generation;
+	/* index into conns while the slot is in use, the next free slot
+	 * otherwise */
+	uint32_t index;
+};
+
+struct conn_table {
+	/* conns[0] to conns[len - 1] are live. pointers into it are only good
+	 * until the next add or remove */
+	size_t len;
+	size_t cap;
+	struct conn *conns;
+	/* the slot each of conns was handed out with */
+	uint32_t *conn_slots;
+	uint32_t slots_len;
+	struct conn_slot *slots;
+	uint32_t free_slot;
+};
+
+void conn_table_init(struct conn_table *);
+/* frees the table itself, any connections left in it have to be finished
+ * by the caller first */
+void conn_table_finish(struct conn_table *);
+
+/* copies c into the table */
+struct conn_handle conn_table_add(struct conn_table *, const struct conn *c);
+/* returns NULL if the handle's connection has been removed */
+struct conn *conn_table_get(struct conn_table *, struct conn_handle);
+struct conn_handle conn_table_handle(const struct conn_table *, size_t i);
+/* removes conns[i] by moving the last connection into it, so a loop
+ * removing as it goes shouldn't step past i afterwards */
+void conn_table_remove_at(struct conn_table *, size_t i);
+void conn_table_remove(struct conn_table *, struct conn_handle);
+
+#endif
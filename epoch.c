@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "epoch.h"
+
+/* epoch 0 means "not reading", so the global epoch starts at 1 */
+#define EPOCH_FIRST 1
+/* retired pointers that haven't been tagged by epoch_collect() yet */
+#define EPOCH_PENDING 0
+
+void epoch_init(struct epoch *e) {
+	atomic_init(&(e->global), EPOCH_FIRST);
+	atomic_init(&(e->readers), NULL);
+	e->retired_len = 0;
+	e->retired_cap = 0;
+	e->retired = NULL;
+}
+
+void epoch_finish(struct epoch *e) {
+	for (size_t i = 0; i < e->retired_len; ++i)
+		e->retired[i].free_item(e->retired[i].ptr);
+	free(e->retired);
+	e->retired = NULL;
+	e->retired_len = 0;
+	e->retired_cap = 0;
+
+	struct epoch_reader *r = atomic_load(&(e->readers));
+	while (r != NULL) {
+		struct epoch_reader *next = r->next;
+		free(r);
+		r = next;
+	}
+	atomic_store(&(e->readers), NULL);
+}
+
+struct epoch_reader *epoch_reader_new(struct epoch *e) {
+	struct epoch_reader *r = malloc(sizeof(struct epoch_reader));
+	atomic_init(&(r->epoch), 0);
+
+	/* readers only ever get pushed onto the front of the list */
+	r->next = atomic_load(&(e->readers));
+	while (!atomic_compare_exchange_weak(&(e->readers), &(r->next), r))
+		;
+	return r;
+}
+
+void epoch_reader_free(struct epoch_reader *r) {
+	/* the reader stays in the list until epoch_finish(), so nothing has to
+	 * unlink it while other threads might be pushing new readers */
+	atomic_store_explicit(&(r->epoch), 0, memory_order_release);
+}
+
+void epoch_enter(struct epoch *e, struct epoch_reader *r) {
+	/* seq_cst, so the writer can't miss this store if it's about to free
+	 * something this reader is going to load */
+	atomic_store(&(r->epoch), atomic_load(&(e->global)));
+}
+
+void epoch_exit(struct epoch_reader *r) {
+	atomic_store_explicit(&(r->epoch), 0, memory_order_release);
+}
+
+void epoch_retire(struct epoch *e, void *ptr, epoch_free_func free_item) {
+	if (e->retired_len == e->retired_cap) {
+		e->retired_cap = e->retired_cap == 0 ? 64 : e->retired_cap * 2;
+		e->retired = realloc(e->retired, e->retired_cap * sizeof(struct epoch_retired));
+	}
+	struct epoch_retired *item = &(e->retired[e->retired_len++]);
+	item->ptr = ptr;
+	item->free_item = free_item;
+	item->epoch = EPOCH_PENDING;
+}
+
+/* the oldest epoch any reader is currently in, or UINT64_MAX if none are */
+static uint64_t epoch_min_active(struct epoch *e) {
+	uint64_t min = UINT64_MAX;
+	struct epoch_reader *r = atomic_load(&(e->readers));
+	while (r != NULL) {
+		uint64_t reader_epoch = atomic_load(&(r->epoch));
+		if (reader_epoch != 0 && reader_epoch < min)
+			min = reader_epoch;
+		r = r->next;
+	}
+	return min;
+}
+
+size_t epoch_collect(struct epoch *e) {
+	/* everything retired so far was unlinked before this increment, so
+	 * readers that enter at the new epoch or later can't be holding it */
+	uint64_t now = atomic_fetch_add(&(e->global), 1) + 1;
+	for (size_t i = 0; i < e->retired_len; ++i)
+		if (e->retired[i].epoch == EPOCH_PENDING)
+			e->retired[i].epoch = now;
+
+	uint64_t min = epoch_min_active(e);
+	size_t kept = 0;
+	size_t freed = 0;
+	for (size_t i = 0; i < e->retired_len; ++i) {
+		struct epoch_retired *item = &(e->retired[i]);
+		if (item->epoch <= min) {
+			item->free_item(item->ptr);
+			++freed;
+		} else {
+			e->retired[kept++] = *item;
+		}
+	}
+	e->retired_len = kept;
+	return freed;
+}
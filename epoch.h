@@ -0,0 +1,57 @@
+/* Epoch-based reclamation, for freeing memory that other threads might still
+ * be reading.
+ *
+ * One thread (the tick thread) owns the domain: it unlinks things from shared
+ * structures, hands them to epoch_retire(), and calls epoch_collect() every
+ * so often to free whatever no reader can still see. Any number of other
+ * threads can read those structures between epoch_enter() and epoch_exit(),
+ * which never block or retry.
+ */
+#ifndef CHOWDER_EPOCH_H
+#define CHOWDER_EPOCH_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*epoch_free_func)(void *);
+
+struct epoch_reader {
+	/* epoch the reader entered at, or 0 when it's outside a critical section */
+	_Atomic uint64_t epoch;
+	struct epoch_reader *next;
+};
+
+struct epoch_retired {
+	void *ptr;
+	epoch_free_func free_item;
+	uint64_t epoch;
+};
+
+struct epoch {
+	_Atomic uint64_t global;
+	_Atomic(struct epoch_reader *) readers;
+
+	/* owned by the writer thread */
+	size_t retired_len;
+	size_t retired_cap;
+	struct epoch_retired *retired;
+};
+
+void epoch_init(struct epoch *);
+/* frees everything still waiting to be freed, so no readers can be active */
+void epoch_finish(struct epoch *);
+
+/* readers are registered once per thread and can be used from that thread
+ * until epoch_reader_free(). their memory is released by epoch_finish() */
+struct epoch_reader *epoch_reader_new(struct epoch *);
+void epoch_reader_free(struct epoch_reader *);
+void epoch_enter(struct epoch *, struct epoch_reader *);
+void epoch_exit(struct epoch_reader *);
+
+/* writer only. ptr must already be unreachable for new readers */
+void epoch_retire(struct epoch *, void *ptr, epoch_free_func);
+/* writer only. returns how many retired pointers were freed */
+size_t epoch_collect(struct epoch *);
+
+#endif
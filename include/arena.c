@@ -0,0 +1,97 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* most arenas hold one chunk's NBT or less */
+#define BLOCK_LEN (64 * 1024)
+#define ALIGN _Alignof(max_align_t)
+
+struct arena_block {
+	struct arena_block *next;
+	size_t len;
+	size_t used;
+	_Alignas(max_align_t) unsigned char data[];
+};
+
+void arena_init(struct arena *a) {
+	a->blocks = NULL;
+	a->used = 0;
+}
+
+void arena_free(struct arena *a) {
+	struct arena_block *b = a->blocks;
+	while (b != NULL) {
+		struct arena_block *next = b->next;
+		free(b);
+		b = next;
+	}
+	arena_init(a);
+}
+
+void arena_reset(struct arena *a) {
+	/* keep the biggest block */
+	struct arena_block *keep = NULL;
+	for (struct arena_block *b = a->blocks; b != NULL; b = b->next) {
+		if (keep == NULL || b->len > keep->len)
+			keep = b;
+	}
+
+	struct arena_block *b = a->blocks;
+	while (b != NULL) {
+		struct arena_block *next = b->next;
+		if (b != keep)
+			free(b);
+		b = next;
+	}
+	if (keep != NULL) {
+		keep->next = NULL;
+		keep->used = 0;
+	}
+	a->blocks = keep;
+	a->used = 0;
+}
+
+void *arena_alloc(struct arena *a, size_t len) {
+	len = (len + ALIGN - 1) & ~(ALIGN - 1);
+	struct arena_block *b = a->blocks;
+	if (b == NULL || b->len - b->used < len) {
+		size_t block_len = len > BLOCK_LEN ? len : BLOCK_LEN;
+		b = malloc(sizeof(struct arena_block) + block_len);
+		if (b == NULL)
+			return NULL;
+		b->len = block_len;
+		b->used = 0;
+		/* a block that's mostly empty stays in front, so one big
+		 * allocation doesn't waste the rest of it */
+		if (a->blocks != NULL && len > BLOCK_LEN) {
+			b->next = a->blocks->next;
+			a->blocks->next = b;
+		} else {
+			b->next = a->blocks;
+			a->blocks = b;
+		}
+	}
+
+	void *p = b->data + b->used;
+	b->used += len;
+	a->used += len;
+	return p;
+}
+
+void *arena_calloc(struct arena *a, size_t len) {
+	void *p = arena_alloc(a, len);
+	if (p != NULL)
+		memset(p, 0, len);
+	return p;
+}
+
+char *arena_strndup(struct arena *a, const char *s, size_t len) {
+	char *p = arena_alloc(a, len + 1);
+	if (p != NULL) {
+		memcpy(p, s, len);
+		p[len] = '\0';
+	}
+	return p;
+}
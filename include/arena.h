@@ -0,0 +1,30 @@
+/* an arena, handing out memory from big blocks that all get freed at once.
+ * Nothing allocated from an arena is freed on its own: arena_reset() frees
+ * everything at once but keeps a block around for reuse, so an arena that's
+ * reset after every job stops calling malloc() once it's big enough. */
+#ifndef CHOWDER_ARENA_H
+#define CHOWDER_ARENA_H
+
+#include <stddef.h>
+
+struct arena_block;
+
+struct arena {
+	/* most recent first */
+	struct arena_block *blocks;
+	/* bytes handed out since the last reset, for sizing */
+	size_t used;
+};
+
+/* a zeroed struct arena is ready to use too */
+void arena_init(struct arena *);
+void arena_free(struct arena *);
+void arena_reset(struct arena *);
+
+/* both return memory aligned for any type */
+void *arena_alloc(struct arena *, size_t len);
+void *arena_calloc(struct arena *, size_t len);
+/* len doesn't include the '\0', which is added */
+char *arena_strndup(struct arena *, const char *s, size_t len);
+
+#endif
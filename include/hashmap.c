@@ -1,107 +1,194 @@
 #include "hashmap.h"
 
 #include <stdbool.h>
-#include <stdint.h>
-#include "linked_list.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
 
-struct bucket_entry {
+#define MIN_CAP 8
+
+struct hashmap_entry {
+	/* 0 for free slots */
+	uint64_t hash;
+	/* copied when added, NULL for integer keys */
 	char *key;
+	uint64_t int_key;
 	void *value;
 };
 
 struct hashmap {
-	size_t buckets_len;
-	struct node **buckets;
+	/* always a power of 2 */
+	size_t cap;
+	size_t len;
+	struct hashmap_entry *entries;
 };
 
+/* https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function#FNV-1a_hash
+ * + a finalizer, since FNV's low bits alone are what picks the slot */
+static uint64_t str_hash(const char *key) {
+	uint64_t hash = 0xcbf29ce484222325;
+	while (*key != '\0') {
+		hash ^= (uint8_t) *key;
+		hash *= 0x100000001b3;
+		++key;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccd;
+	hash ^= hash >> 33;
+	return hash != 0 ? hash : 1;
+}
+
+/* splitmix64's finalizer */
+static uint64_t int_hash(uint64_t key) {
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111eb;
+	key ^= key >> 31;
+	return key != 0 ? key : 1;
+}
+
+/* how far the entry in slot i is from the slot its hash wants */
+static size_t probe_len(const struct hashmap *hm, size_t i) {
+	return (i - (hm->entries[i].hash & (hm->cap - 1))) & (hm->cap - 1);
+}
+
+static bool entry_equal(const struct hashmap_entry *e, uint64_t hash, const char *key, uint64_t int_key) {
+	if (e->hash != hash)
+		return false;
+	if (key == NULL)
+		return e->key == NULL && e->int_key == int_key;
+	return e->key != NULL && strcmp(e->key, key) == 0;
+}
+
 struct hashmap *hashmap_new(size_t elems) {
 	struct hashmap *hm = malloc(sizeof(struct hashmap));
-	hm->buckets_len = elems + (elems / 4);
-	hm->buckets = calloc(hm->buckets_len, sizeof(struct node *));
+	hm->cap = MIN_CAP;
+	while (hm->cap / 4 * 3 < elems)
+		hm->cap *= 2;
+	hm->len = 0;
+	hm->entries = calloc(hm->cap, sizeof(struct hashmap_entry));
 	return hm;
 }
 
 void hashmap_free(struct hashmap *hm, free_item_func free_item) {
-	for (size_t i = 0; i < hm->buckets_len; ++i) {
-		struct node *bucket = hm->buckets[i];
-		while (bucket != NULL && !list_empty(bucket)) {
-			struct bucket_entry *b = list_remove(bucket);
-			free(b->key);
-			free_item(b->value);
-			free(b);
-		}
-		free(bucket);
+	for (size_t i = 0; i < hm->cap; ++i) {
+		struct hashmap_entry *e = &(hm->entries[i]);
+		if (e->hash == 0)
+			continue;
+		free(e->key);
+		if (free_item != NULL)
+			free_item(e->value);
 	}
-	free(hm->buckets);
+	free(hm->entries);
 	free(hm);
 }
 
-/* https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function#FNV-1a_hash */
-static uint64_t fnv1a(char *key) {
-	uint64_t hash = 0xcbf29ce484222325;
-	while (*key != '\0') {
-		hash ^= *key;
-		hash *= 0x100000001b3;
-		++key;
+/* returns the slot holding key, or -1 */
+static ssize_t find(const struct hashmap *hm, uint64_t hash, const char *key, uint64_t int_key) {
+	size_t mask = hm->cap - 1;
+	size_t i = hash & mask;
+	/* once we've gone further than the entry in this slot did, key would
+	 * have taken its place if it were here */
+	for (size_t dist = 0; hm->entries[i].hash != 0 && dist <= probe_len(hm, i); ++dist) {
+		if (entry_equal(&(hm->entries[i]), hash, key, int_key))
+			return i;
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+/* puts e in the table, which has to have room for it + not already have
+ * its key */
+static void insert(struct hashmap *hm, struct hashmap_entry e) {
+	size_t mask = hm->cap - 1;
+	size_t i = e.hash & mask;
+	size_t dist = 0;
+	while (hm->entries[i].hash != 0) {
+		size_t existing = probe_len(hm, i);
+		if (existing < dist) {
+			struct hashmap_entry tmp = hm->entries[i];
+			hm->entries[i] = e;
+			e = tmp;
+			dist = existing;
+		}
+		i = (i + 1) & mask;
+		++dist;
 	}
-	return hash;
+	hm->entries[i] = e;
+	++(hm->len);
 }
 
-static size_t hashmap_index(struct hashmap *hm, char *key) {
-	return fnv1a(key) % hm->buckets_len;
+static void grow(struct hashmap *hm) {
+	size_t old_cap = hm->cap;
+	struct hashmap_entry *old = hm->entries;
+	hm->cap *= 2;
+	hm->len = 0;
+	hm->entries = calloc(hm->cap, sizeof(struct hashmap_entry));
+	for (size_t i = 0; i < old_cap; ++i) {
+		if (old[i].hash != 0)
+			insert(hm, old[i]);
+	}
+	free(old);
 }
 
-static struct bucket_entry *make_bucket_entry(char *key, void *value) {
-	struct bucket_entry *b = malloc(sizeof(struct bucket_entry));
-	b->key = strdup(key);
-	b->value = value;
-	return b;
+static void *add(struct hashmap *hm, uint64_t hash, char *key, uint64_t int_key, void *value) {
+	ssize_t i = find(hm, hash, key, int_key);
+	if (i >= 0) {
+		void *old = hm->entries[i].value;
+		hm->entries[i].value = value;
+		return old;
+	}
+
+	if (hm->len + 1 > hm->cap / 4 * 3)
+		grow(hm);
+	struct hashmap_entry e = {hash, key != NULL ? strdup(key) : NULL, int_key, value};
+	insert(hm, e);
+	return NULL;
 }
 
-void hashmap_add(struct hashmap *hm, char *key, void *value) {
-	struct bucket_entry *b = make_bucket_entry(key, value);
-	size_t i = hashmap_index(hm, key);
-	struct node *bucket = hm->buckets[i];
-	if (bucket == NULL) {
-		bucket = list_new();
-		list_append(bucket, sizeof(struct bucket_entry *), &b);
-		hm->buckets[i] = bucket;
-	} else {
-		list_append(bucket, sizeof(struct bucket_entry *), &b);
+/* backward shift deletion: entries after the removed one move back a slot
+ * until one is already in its home slot, so no tombstones are needed */
+static void *remove_at(struct hashmap *hm, ssize_t i) {
+	if (i < 0)
+		return NULL;
+	void *value = hm->entries[i].value;
+	free(hm->entries[i].key);
+
+	size_t mask = hm->cap - 1;
+	size_t next = (i + 1) & mask;
+	while (hm->entries[next].hash != 0 && probe_len(hm, next) > 0) {
+		hm->entries[i] = hm->entries[next];
+		i = next;
+		next = (next + 1) & mask;
 	}
+	hm->entries[i] = (struct hashmap_entry) {0};
+	--(hm->len);
+	return value;
+}
+
+void *hashmap_add(struct hashmap *hm, char *key, void *value) {
+	return add(hm, str_hash(key), key, 0, value);
 }
 
-static bool hashmap_bucket_entry_equal(void *p1, void *p2) {
-	struct bucket_entry *b1 = p1;
-	struct bucket_entry *b2 = p2;
-	return strcmp(b1->key, b2->key) == 0;
+void *hashmap_add_int(struct hashmap *hm, uint64_t key, void *value) {
+	return add(hm, int_hash(key), NULL, key, value);
 }
 
 void *hashmap_get(struct hashmap *hm, char *key) {
-	size_t i = hashmap_index(hm, key);
-	struct node *bucket = hm->buckets[i];
-	if (bucket != NULL) {
-		struct bucket_entry b = { .key = key };
-		struct bucket_entry *v = list_item(list_find(bucket, hashmap_bucket_entry_equal, &b));
-		if (v != NULL) {
-			return v->value;
-		}
-	}
-	return NULL;
+	ssize_t i = find(hm, str_hash(key), key, 0);
+	return i >= 0 ? hm->entries[i].value : NULL;
+}
+
+void *hashmap_get_int(struct hashmap *hm, uint64_t key) {
+	ssize_t i = find(hm, int_hash(key), NULL, key);
+	return i >= 0 ? hm->entries[i].value : NULL;
 }
 
 void *hashmap_remove(struct hashmap *hm, char *key) {
-	size_t i = hashmap_index(hm, key);
-	struct node *bucket = hm->buckets[i];
-	if (bucket != NULL) {
-		struct bucket_entry b = { .key = key };
-		struct bucket_entry *v = list_remove(list_find(bucket, hashmap_bucket_entry_equal, &b));
-		if (v != NULL) {
-			free(v->key);
-			void *value = v->value;
-			free(v);
-			return value;
-		}
-	}
-	return NULL;
+	return remove_at(hm, find(hm, str_hash(key), key, 0));
+}
+
+void *hashmap_remove_int(struct hashmap *hm, uint64_t key) {
+	return remove_at(hm, find(hm, int_hash(key), NULL, key));
 }
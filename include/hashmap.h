@@ -1,13 +1,33 @@
-/* a hashmap, with strings as keys and pointers to dynamically allocated objects as values */
+/* a hashmap, with strings or integers as keys and pointers to dynamically
+ * allocated objects as values.
+ *
+ * It's one flat array of entries with open addressing + Robin Hood probing:
+ * an entry that's further from its home slot takes the slot of one that's
+ * closer to its own, which keeps every probe sequence short. Hashes are
+ * stored next to the keys, so a probe only compares keys whose hashes match,
+ * and the table doubles whenever it gets 3/4 full. */
+#ifndef CHOWDER_HASHMAP_H
+#define CHOWDER_HASHMAP_H
+
 #include <stddef.h>
+#include <stdint.h>
 
 typedef void (*free_item_func)(void *);
 
 struct hashmap;
 
+/* elems is how many entries to make room for up front */
 struct hashmap *hashmap_new(size_t elems);
+/* free_item can be NULL if the map doesn't own its values */
 void hashmap_free(struct hashmap *, free_item_func);
 
-void hashmap_add(struct hashmap *, char *key, void *value);
+/* both return the value that was already there for key, or NULL */
+void *hashmap_add(struct hashmap *, char *key, void *value);
+void *hashmap_add_int(struct hashmap *, uint64_t key, void *value);
 void *hashmap_get(struct hashmap *, char *key);
+void *hashmap_get_int(struct hashmap *, uint64_t key);
+/* return the removed value, or NULL */
 void *hashmap_remove(struct hashmap *, char *key);
+void *hashmap_remove_int(struct hashmap *, uint64_t key);
+
+#endif
@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "histogram.h"
+
+static int bucket_of(uint32_t v) {
+	if (v < HISTOGRAM_SUB_BUCKETS)
+		return v;
+	/* the top HISTOGRAM_SUB_BITS bits pick the bucket within v's power of
+	 * two, and the highest of them is always set */
+	int shift = 31 - __builtin_clz(v) - (HISTOGRAM_SUB_BITS - 1);
+	int sub = (v >> shift) - HISTOGRAM_HALF_BUCKETS;
+	return HISTOGRAM_SUB_BUCKETS + (shift - 1) * HISTOGRAM_HALF_BUCKETS + sub;
+}
+
+/* the largest value that goes in bucket b */
+static uint32_t bucket_top(int b) {
+	if (b < HISTOGRAM_SUB_BUCKETS)
+		return b;
+	b -= HISTOGRAM_SUB_BUCKETS;
+	int shift = b / HISTOGRAM_HALF_BUCKETS + 1;
+	uint64_t sub = b % HISTOGRAM_HALF_BUCKETS + HISTOGRAM_HALF_BUCKETS;
+	return ((sub + 1) << shift) - 1;
+}
+
+void histogram_clear(struct histogram *h) {
+	memset(h, 0, sizeof(struct histogram));
+}
+
+void histogram_record(struct histogram *h, uint32_t value) {
+	if (h->count == 0 || value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+	++(h->count);
+	h->sum += value;
+	++(h->buckets[bucket_of(value)]);
+}
+
+void histogram_merge(struct histogram *dst, const struct histogram *src) {
+	if (src->count == 0)
+		return;
+	if (dst->count == 0 || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (int b = 0; b < HISTOGRAM_BUCKETS; ++b)
+		dst->buckets[b] += src->buckets[b];
+}
+
+double histogram_mean(const struct histogram *h) {
+	return h->count > 0 ? (double) h->sum / h->count : 0;
+}
+
+uint32_t histogram_percentile(const struct histogram *h, double p) {
+	if (h->count == 0)
+		return 0;
+	uint64_t want = (uint64_t) (p / 100 * h->count + 0.5);
+	if (want < 1)
+		want = 1;
+	uint64_t seen = 0;
+	for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+		seen += h->buckets[b];
+		if (seen >= want) {
+			/* nothing recorded is bigger than max */
+			uint32_t top = bucket_top(b);
+			return top < h->max ? top : h->max;
+		}
+	}
+	return h->max;
+}
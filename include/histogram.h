@@ -0,0 +1,41 @@
+/* A log-linear (HDR style) histogram of durations. Every power of two gets
+ * the same number of buckets, so values are kept to within about 3% of what
+ * they were whether they're microseconds or seconds, in a fixed 3.5 KiB.
+ *
+ * Values are unsigned 32 bit, and it's up to the caller what unit they're
+ * in. Histograms can be merged, so a rolling window can be built out of a
+ * ring of them.
+ */
+#ifndef CHOWDER_HISTOGRAM_H
+#define CHOWDER_HISTOGRAM_H
+
+#include <stdint.h>
+
+/* each power of two is split into 2^(HISTOGRAM_SUB_BITS - 1) buckets */
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_HALF_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+/* values below HISTOGRAM_SUB_BUCKETS get a bucket each, then every power
+ * of two up to 2^31 gets HISTOGRAM_HALF_BUCKETS */
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + (32 - HISTOGRAM_SUB_BITS) * HISTOGRAM_HALF_BUCKETS)
+
+struct histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint32_t min;
+	uint32_t max;
+	uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/* a zeroed struct histogram is empty too */
+void histogram_clear(struct histogram *);
+void histogram_record(struct histogram *, uint32_t value);
+/* adds everything recorded in src to dst */
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+
+double histogram_mean(const struct histogram *);
+/* the smallest value that at least p percent (0-100) of the recorded values
+ * are at or below, rounded up to the top of its bucket. 0 if it's empty */
+uint32_t histogram_percentile(const struct histogram *, double p);
+
+#endif
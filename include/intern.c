@@ -0,0 +1,111 @@
+#include "intern.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define INTERN_MIN_CAP 256
+/* slots in each thread's cache of strings it's interned recently */
+#define RECENT_LEN 64
+#define FNV_OFFSET 14695981039346656037u
+#define FNV_PRIME 1099511628211u
+
+struct interned {
+	uint64_t hash;
+	size_t len;
+	/* NULL if the slot is free */
+	const char *s;
+};
+
+/* open addressing w/ linear probing, kept at most half full. the strings
+ * themselves all go in one arena */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t table_cap = 0;
+static size_t table_len = 0;
+static struct interned *table = NULL;
+static struct arena strings;
+/* bumped by intern_free(), which leaves every thread's cache stale */
+static atomic_uint generation = 1;
+
+/* the same few strings get interned over + over by the same thread, so
+ * most lookups are answered here without taking the lock */
+static _Thread_local unsigned recent_generation = 0;
+static _Thread_local struct interned recent[RECENT_LEN];
+
+static uint64_t hash_string(const char *s, size_t len) {
+	uint64_t h = FNV_OFFSET;
+	for (size_t i = 0; i < len; ++i)
+		h = (h ^ (uint8_t) s[i]) * FNV_PRIME;
+	return h;
+}
+
+/* the slot holding s, or the free slot it would go in */
+static size_t find_slot(uint64_t hash, const char *s, size_t len) {
+	size_t mask = table_cap - 1;
+	size_t i = hash & mask;
+	while (table[i].s != NULL && !(table[i].hash == hash && table[i].len == len
+				&& memcmp(table[i].s, s, len) == 0))
+		i = (i + 1) & mask;
+	return i;
+}
+
+static void grow() {
+	size_t old_cap = table_cap;
+	struct interned *old = table;
+	table_cap = old_cap > 0 ? old_cap * 2 : INTERN_MIN_CAP;
+	table = calloc(table_cap, sizeof(struct interned));
+	for (size_t i = 0; i < old_cap; ++i) {
+		if (old[i].s != NULL)
+			table[find_slot(old[i].hash, old[i].s, old[i].len)] = old[i];
+	}
+	free(old);
+}
+
+/* the calling thread's cache slot for hash */
+static struct interned *recent_slot(uint64_t hash) {
+	unsigned gen = atomic_load_explicit(&generation, memory_order_acquire);
+	if (recent_generation != gen) {
+		memset(recent, 0, sizeof(recent));
+		recent_generation = gen;
+	}
+	return &(recent[hash % RECENT_LEN]);
+}
+
+static bool is_recent(const struct interned *r, uint64_t hash, const char *s, size_t len) {
+	return r->s != NULL && r->hash == hash && r->len == len && memcmp(r->s, s, len) == 0;
+}
+
+const char *intern(const char *s, size_t len) {
+	uint64_t hash = hash_string(s, len);
+	struct interned *r = recent_slot(hash);
+	if (is_recent(r, hash, s, len))
+		return r->s;
+
+	pthread_mutex_lock(&lock);
+	if ((table_len + 1) * 2 > table_cap)
+		grow();
+	size_t i = find_slot(hash, s, len);
+	if (table[i].s == NULL) {
+		table[i] = (struct interned) {hash, len, arena_strndup(&strings, s, len)};
+		++table_len;
+	}
+	*r = table[i];
+	pthread_mutex_unlock(&lock);
+	return r->s;
+}
+
+void intern_free() {
+	pthread_mutex_lock(&lock);
+	free(table);
+	table = NULL;
+	table_cap = 0;
+	table_len = 0;
+	arena_free(&strings);
+	atomic_fetch_add_explicit(&generation, 1, memory_order_release);
+	pthread_mutex_unlock(&lock);
+}
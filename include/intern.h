@@ -0,0 +1,18 @@
+/* interned strings: one shared copy of every distinct string, so two
+ * interned strings are equal exactly when they're the same pointer.
+ *
+ * Interned strings are never freed on their own, only all at once by
+ * intern_free(), so they're meant for the small set of strings that keep
+ * coming back, like the palette cache's block state keys. Everything here
+ * is safe to call from any thread. */
+#ifndef CHOWDER_INTERN_H
+#define CHOWDER_INTERN_H
+
+#include <stddef.h>
+
+/* returns the '\0' terminated copy of the len bytes at s, adding it if it
+ * isn't there yet */
+const char *intern(const char *s, size_t len);
+void intern_free();
+
+#endif
@@ -0,0 +1,3 @@
+/* jsmn is header-only: everything else includes it with JSMN_HEADER, and this
+ * is where its functions get compiled */
+#include "include/jsmn/jsmn.h"
@@ -15,25 +15,40 @@
 
 #include <assert.h>
 
-#include "blocks.h"
 #include "protocol.h"
 #include "login.h"
 #include "server.h"
 #include "conn.h"
+#include "conn_table.h"
 #include "rsa.h"
 #include "world.h"
+#include "pool.h"
+#include "profiler.h"
+#include "shard.h"
+#include "tick.h"
+#include "include/intern.h"
 
 #define PLAYERS    4
 #define PORT       25565
 #define LEVEL_PATH "levels/default"
 
-#define BLOCKS_PATH "gamedata/blocks.json"
-
 #define TICK_LEN_NSEC 50000000
+/* how far behind the server can fall before it stops catching up, in ticks */
+#define MAX_CATCH_UP_TICKS 10
+
+/* roughly how much memory chunks nobody can see are allowed to take up */
+#define CHUNK_MEM_BUDGET (128 * 1024 * 1024)
+/* how much memory unloaded chunks can take up while compressed */
+#define COLD_CHUNK_MEM_BUDGET (64 * 1024 * 1024)
+/* how often changed chunks get written back to the level, in ticks */
+#define SAVE_INTERVAL_TICKS (20 * 30)
 
 static bool running = true;
+/* set by SIGUSR1, which prints the profiler's report */
+static volatile sig_atomic_t report_wanted = 0;
 
 void sigint_handler(int);
+void sigusr1_handler(int);
 int check_level_path(char *);
 int bind_socket();
 
@@ -42,19 +57,19 @@ int main() {
 	act.sa_handler = sigint_handler;
 	if (sigaction(SIGINT, &act, NULL) < 0)
 		perror("sigaction");
+	act.sa_handler = sigusr1_handler;
+	if (sigaction(SIGUSR1, &act, NULL) < 0)
+		perror("sigaction");
 
 	/* socket init */
 	int sfd = bind_socket();
 	if (sfd < 0)
 		exit(EXIT_FAILURE);
 
-	/* make sure level exists + load the block table */
+	/* make sure level exists */
 	int failed = check_level_path(LEVEL_PATH);
 	if (failed)
 		exit(EXIT_FAILURE);
-	struct hashmap *block_table = create_block_table(BLOCKS_PATH);
-	if (block_table == NULL)
-		exit(EXIT_FAILURE);
 
 	/* RSA keygen */
 	EVP_PKEY *pkey = NULL;
@@ -71,21 +86,29 @@ int main() {
 		exit(EXIT_FAILURE);
 
 	struct world *w = world_new();
-	w->block_table = block_table;
-	struct node *connections = list_new();
+	w->level_path = LEVEL_PATH;
+	w->chunk_mem_budget = CHUNK_MEM_BUDGET;
+	w->cold_mem_budget = COLD_CHUNK_MEM_BUDGET;
+	w->pool = pool_new(0);
+	if (w->pool == NULL)
+		fprintf(stderr, "no worker threads, running everything on the tick thread\n");
+	struct conn_table conns;
+	conn_table_init(&conns);
 	struct packet packet;
 	packet_init(&packet);
+	struct shards shards;
+	shards_init(&shards);
 
-	/* TODO: keep track of a "tick debt" so the server can catch up when a
-	 *       tick takes too long */
-	struct timespec tick_start_time;
-	struct timespec current_time;
+	struct profiler *prof = profiler_new();
+	if (prof == NULL)
+		exit(EXIT_FAILURE);
+	struct tick_clock ticks;
+	if (tick_clock_init(&ticks, TICK_LEN_NSEC, MAX_CATCH_UP_TICKS) < 0)
+		exit(EXIT_FAILURE);
+	unsigned long tick = 0;
 	while (running) {
-		if (clock_gettime(CLOCK_MONOTONIC, &tick_start_time) < 0) {
-			perror("clock_gettime");
-			break;
-		}
-
+		profiler_tick_start(prof);
+		profiler_phase(prof, PHASE_ACCEPT);
 		int conn = accept(sfd, NULL, NULL);
 		if (conn == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
 			perror("accept");
@@ -95,43 +118,78 @@ int main() {
 			l_ctx.pubkey_len = der_len;
 			l_ctx.pubkey = der;
 
-			struct conn *c = server_accept_connection(conn, &packet, w, &l_ctx);
-			if (c != NULL) {
-				list_append(connections, sizeof(struct conn *), &c);
+			struct conn c;
+			if (server_accept_connection(conn, &packet, w, &l_ctx, &c) == 0)
+				conn_table_add(&conns, &c);
+		}
+
+		profiler_phase(prof, PHASE_NET_READ);
+		shards_build(&shards, &conns);
+		shards_run(&shards, w->pool);
+		/* the shards ran in parallel, so the wait for them gets split
+		 * up by where their time went */
+		profiler_split(prof, shards.phase_ns);
+
+		profiler_phase(prof, PHASE_PACKETS);
+		shards_apply(&shards, w);
+		/* backwards, so removing only ever moves a connection that's
+		 * already been looked at */
+		for (size_t i = conns.len; i-- > 0;) {
+			if (shards.results[i] <= 0) {
+				server_close_connection(&(conns.conns[i]), w);
+				conn_table_remove_at(&conns, i);
 			}
 		}
 
-		struct node *connection = connections;
-		while (!list_empty(connection)) {
-			int status = server_play(list_item(connection), w);
-			if (status <= 0) {
-				struct conn *c = list_remove(connection);
-				conn_finish(c);
-				free(c);
+		profiler_phase(prof, PHASE_CHUNKS);
+		for (size_t i = 0; i < conns.len;) {
+			if (server_update(&(conns.conns[i]), w) < 0) {
+				server_close_connection(&(conns.conns[i]), w);
+				conn_table_remove_at(&conns, i);
 			} else {
-				connection = list_next(connection);
+				++i;
 			}
 		}
 
-		if (clock_gettime(CLOCK_MONOTONIC, &current_time) < 0) {
-			perror("clock_gettime");
-			break;
-		} else if (current_time.tv_nsec - tick_start_time.tv_nsec < TICK_LEN_NSEC) {
-			struct timespec sleep_time = {0};
-			sleep_time.tv_nsec = TICK_LEN_NSEC - (current_time.tv_nsec - tick_start_time.tv_nsec);
-			/* TODO: handle interrupted sleep, probably */
-			clock_nanosleep(CLOCK_MONOTONIC, 0, &sleep_time, NULL);
+		profiler_phase(prof, PHASE_WORLD);
+		if (++tick % SAVE_INTERVAL_TICKS == 0)
+			world_save_dirty(w);
+		world_unload_chunks(w);
+		world_collect(w);
+		profiler_tick_end(prof);
+
+		if (report_wanted) {
+			report_wanted = 0;
+			printf("tick debt: %.1f ms\n", ticks.debt / 1000000.0);
+			profiler_report(prof, stdout, false);
+			pool_report(w->pool, stdout);
 		}
+		if (tick_clock_wait(&ticks) < 0)
+			break;
 	}
 
 	puts("shutdown time");
-
+	printf("ticks: %lu run, %lu skipped, %.1f tps\n", ticks.ticks, ticks.skipped, ticks.tps);
+	profiler_report(prof, stdout, true);
+	profiler_free(prof);
+	pool_report(w->pool, stdout);
+	printf("cold chunks: %zu hits, %zu misses\n", w->cold_hits, w->cold_misses);
+
+	for (size_t i = 0; i < conns.len; ++i)
+		server_close_connection(&(conns.conns[i]), w);
+	conn_table_finish(&conns);
+	shards_free(&shards);
 	free(packet.data);
 	free(der);
 	EVP_PKEY_CTX_free(ctx);
 	EVP_PKEY_free(pkey);
 	close(sfd);
+	world_save_dirty(w);
+	pool_wait(w->pool);
+	pool_free(w->pool);
 	world_free(w);
+	read_chunk_buffers_free();
+	intern_free();
 
 	exit(EXIT_SUCCESS);
 }
@@ -141,6 +199,11 @@ void sigint_handler(int signum) {
 	running = false;
 }
 
+void sigusr1_handler(int signum) {
+	assert(signum == SIGUSR1);
+	report_wanted = 1;
+}
+
 int check_level_path(char *level_path) {
 	/* check if LEVEL_PATH actually exists */
 	FILE *level_dir = fopen(level_path, "r");
@@ -4,312 +4,315 @@
 #include <stdbool.h>
 #include <arpa/inet.h>
 #include <endian.h>
-#include "include/linked_list.h"
 
 #include "nbt.h"
 
-struct nbt *nbt_new(enum tag t, char *name) {
-	struct nbt *root = calloc(1, sizeof(struct nbt));
-	root->tag = t;
-	if (name != NULL) {
-		root->name = strdup(name);
-	}
-	return root;
-}
-
-static void nbt_free_node_data(struct nbt *);
-
-static void nbt_free_list(struct nbt_list *l) {
-	while (!list_empty(l->head)) {
-		struct nbt *node = list_remove(l->head);
-		nbt_free_node_data(node);
-		free(node);
-	}
-	list_free(l->head);
-	free(l);
-}
-
-static void nbt_free_node(struct nbt *);
-
-static void nbt_free_node_data(struct nbt *node) {
-	switch (node->tag) {
-		case TAG_String:
-			free(node->data.string);
+/* https://wiki.vg/NBT#Specification: "implementations must support at least
+ * 512 levels of nesting" */
+#define MAX_DEPTH 512
+#define MIN_CHILDREN_CAP 4
+
+static void nbt_init(struct arena *a, struct nbt *n, enum tag t, const char *name) {
+	*n = (struct nbt) {0};
+	n->tag = t;
+	if (name != NULL)
+		n->name = arena_strndup(a, name, strlen(name));
+	switch (t) {
+		case TAG_Compound:
+		case TAG_List:
+			n->data.list = arena_calloc(a, sizeof(struct nbt_list));
+			n->data.list->type = TAG_End;
 			break;
 		case TAG_Byte_Array:
 		case TAG_Int_Array:
 		case TAG_Long_Array:
-			free(node->data.array->data.bytes);
-			free(node->data.array);
-			break;
-		case TAG_List:
-			nbt_free_list(node->data.list);
-			break;
-		case TAG_Compound:
-			nbt_free_node(node);
+			n->data.array = arena_calloc(a, sizeof(struct nbt_array));
+			n->data.array->type = t;
 			break;
 		default:
 			break;
 	}
 }
 
-static void nbt_free_child(struct nbt *child) {
-	nbt_free_node_data(child);
-	if (child->tag != TAG_Compound) {
-		free(child->name);
-	}
-	free(child);
+struct nbt *nbt_new(struct arena *a, enum tag t, const char *name) {
+	struct nbt *n = arena_alloc(a, sizeof(struct nbt));
+	nbt_init(a, n, t, name);
+	return n;
 }
 
-static void nbt_free_node(struct nbt *root) {
-	free(root->name);
-	while (!list_empty(root->data.children)) {
-		struct nbt *child = list_remove(root->data.children);
-		nbt_free_child(child);
+struct nbt *nbt_add(struct arena *a, struct nbt *root, enum tag t, const char *name) {
+	struct nbt_list *l = root->data.list;
+	if (root->tag == TAG_List)
+		l->type = t;
+	if (l->len == l->cap) {
+		/* the old items stay in the arena until it's reset */
+		int32_t cap = l->cap > 0 ? l->cap * 2 : MIN_CHILDREN_CAP;
+		struct nbt *items = arena_alloc(a, sizeof(struct nbt) * cap);
+		if (l->len > 0)
+			memcpy(items, l->items, sizeof(struct nbt) * l->len);
+		l->items = items;
+		l->cap = cap;
 	}
-	list_free(root->data.children);
+
+	struct nbt *child = &(l->items[l->len++]);
+	nbt_init(a, child, t, name);
+	return child;
 }
 
-void nbt_free(struct nbt *root) {
-	if (root->tag == TAG_Compound) {
-		nbt_free_node(root);
-		free(root);
-	} else {
-		nbt_free_child(root);
-	}
+void nbt_remove(struct nbt *root, struct nbt *child) {
+	struct nbt_list *l = root->data.children;
+	ptrdiff_t i = child - l->items;
+	if (i < 0 || i >= l->len)
+		return;
+	memmove(&(l->items[i]), &(l->items[i + 1]), sizeof(struct nbt) * (l->len - i - 1));
+	--(l->len);
 }
 
-static int nbt_read_bytes(size_t n, void *dest, size_t i, size_t len, const uint8_t *data) {
-	if (n < len && i < len - n) {
-		memcpy(dest, data + i, n);
-		return n;
-	}
-	return -1;
+void nbt_set_string(struct arena *a, struct nbt *n, const char *value) {
+	n->data.string = arena_strndup(a, value, strlen(value));
+}
+
+void *nbt_set_array(struct arena *a, struct nbt *n, int32_t len) {
+	size_t elem_len = n->tag == TAG_Long_Array ? 8 : n->tag == TAG_Int_Array ? 4 : 1;
+	n->data.array->len = len;
+	n->data.array->data.bytes = arena_calloc(a, elem_len * len);
+	return n->data.array->data.bytes;
 }
 
-static int nbt_read_short(int16_t *v, size_t i, size_t len, const uint8_t *data) {
-	int n = nbt_read_bytes(2, v, i, len, data);
-	if (n > 0) {
-		*v = ntohs(*v);
+/* Unpacking is one pass over the buffer, with every node + payload going
+ * into the arena. Compound children are read onto a scratch stack first,
+ * since there's no telling how many there are until the TAG_End, then
+ * copied into the arena together once the compound ends. */
+struct reader {
+	struct arena *arena;
+	size_t len;
+	const uint8_t *data;
+	size_t i;
+	int depth;
+	bool err;
+
+	size_t stack_len;
+	size_t stack_cap;
+	struct nbt *stack;
+};
+
+static bool has_bytes(struct reader *r, size_t n) {
+	if (r->err || r->len - r->i < n) {
+		r->err = true;
+		return false;
 	}
-	return n;
+	return true;
+}
+
+static uint8_t read_byte(struct reader *r) {
+	return has_bytes(r, 1) ? r->data[r->i++] : 0;
 }
 
-static int nbt_read_int(int32_t *v, size_t i, size_t len, const uint8_t *data) {
-	int n = nbt_read_bytes(4, v, i, len, data);
-	if (n > 0) {
-		*v = ntohl(*v);
+static int16_t read_short(struct reader *r) {
+	int16_t v = 0;
+	if (has_bytes(r, 2)) {
+		memcpy(&v, r->data + r->i, 2);
+		r->i += 2;
 	}
-	return n;
+	return ntohs(v);
 }
 
-static int nbt_read_long(int64_t *v, size_t i, size_t len, const uint8_t *data) {
-	int n = nbt_read_bytes(8, v, i, len, data);
-	if (n > 0) {
-		*v = be64toh(*v);
+static int32_t read_int(struct reader *r) {
+	int32_t v = 0;
+	if (has_bytes(r, 4)) {
+		memcpy(&v, r->data + r->i, 4);
+		r->i += 4;
 	}
-	return n;
+	return ntohl(v);
 }
 
-static size_t nbt_read_string(char **name, size_t len, const uint8_t *data) {
-	size_t i = 0;
-
-	uint16_t name_len;
-	int n = nbt_read_short((int16_t *) &name_len, i, len, data);
-	if (n > 0) {
-		i += n;
-		if (name_len > 0) {
-			*name = malloc(sizeof(char) * (name_len + 1));
-			n = nbt_read_bytes(name_len, *name, i, len, data);
-			if (n > 0) {
-				i += n;
-				(*name)[n] = '\0';
-			}
-		}
+static int64_t read_long(struct reader *r) {
+	int64_t v = 0;
+	if (has_bytes(r, 8)) {
+		memcpy(&v, r->data + r->i, 8);
+		r->i += 8;
 	}
-	return i;
+	return be64toh(v);
 }
 
-static int nbt_unpack_node_data(struct nbt *, size_t, size_t, const uint8_t *);
+static char *read_string(struct reader *r) {
+	uint16_t len = read_short(r);
+	if (!has_bytes(r, len))
+		return NULL;
+	char *s = arena_strndup(r->arena, (const char *) r->data + r->i, len);
+	r->i += len;
+	return s;
+}
 
-static int nbt_read_list(struct nbt_list *l, size_t len, const uint8_t *data) {
-	l->type = data[0];
-	int32_t list_len;
-	size_t i = 1;
-	int n = nbt_read_int(&list_len, i, len, data);
-	if (n > 0) {
-		i += n;
+static struct nbt_array *read_array(struct reader *r, enum tag t, size_t elem_len) {
+	int32_t len = read_int(r);
+	if (len < 0 || !has_bytes(r, len * elem_len)) {
+		r->err = true;
+		return NULL;
 	}
 
-	l->head = list_new();
-	int16_t elem = 0;
-	while (n > 0 && elem < list_len) {
-		struct nbt *nbt = malloc(sizeof(struct nbt));
-		nbt->tag = l->type;
-		nbt->name = NULL;
-
-		int n = nbt_unpack_node_data(nbt, i, len, data);
-		if (n > 0) {
-			i += n;
-		}
+	struct nbt_array *a = arena_alloc(r->arena, sizeof(struct nbt_array));
+	a->type = t;
+	a->len = len;
+	a->data.bytes = arena_alloc(r->arena, len * elem_len);
+	memcpy(a->data.bytes, r->data + r->i, len * elem_len);
+	r->i += len * elem_len;
 
-		++elem;
-		list_append(l->head, sizeof(struct nbt *), &nbt);
+	if (t == TAG_Int_Array) {
+		for (int32_t i = 0; i < len; ++i)
+			a->data.ints[i] = ntohl(a->data.ints[i]);
+	} else if (t == TAG_Long_Array) {
+		for (int32_t i = 0; i < len; ++i)
+			a->data.longs[i] = be64toh(a->data.longs[i]);
 	}
+	return a;
+}
+
+static void read_payload(struct reader *, struct nbt *);
 
-	if (n <= 0) {
-		return -1;
+static struct nbt_list *read_list(struct reader *r) {
+	struct nbt_list *l = arena_calloc(r->arena, sizeof(struct nbt_list));
+	l->type = read_byte(r);
+	int32_t len = read_int(r);
+	/* every item takes at least a byte, except in lists of nothing */
+	if (l->type > TAG_Long_Array || len < 0
+			|| (l->type != TAG_End && (size_t) len > r->len - r->i)) {
+		r->err = true;
+		return l;
 	}
-	return i;
-}
-
-static int nbt_read_array(struct nbt_array *a, size_t elem_bytes, size_t len, const uint8_t *data) {
-	size_t i = 0;
-	int n = nbt_read_int(&(a->len), i, len, data);
-	if (n > 0) {
-		i += n;
-		if (i < len - a->len * elem_bytes) {
-			a->data.bytes = malloc(a->len * elem_bytes);
-			memcpy(a->data.bytes, data + i, a->len * elem_bytes);
-			i += a->len * elem_bytes;
-		} else {
-			return -1;
-		}
-	} else {
-		return -1;
+	if (l->type == TAG_End)
+		return l;
+
+	l->items = arena_alloc(r->arena, sizeof(struct nbt) * len);
+	for (int32_t i = 0; i < len && !r->err; ++i) {
+		l->items[i] = (struct nbt) {0};
+		l->items[i].tag = l->type;
+		read_payload(r, &(l->items[i]));
+		l->len = l->cap = i + 1;
 	}
-	return i;
+	return l;
 }
 
-static int nbt_read_int_array(struct nbt_array **array, size_t len, const uint8_t *data) {
-	struct nbt_array *a = malloc(sizeof(struct nbt_array));
-	a->type = TAG_Int_Array;
-	int n = nbt_read_array(a, 4, len, data);
-	for (int32_t i = 0; i < a->len; ++i) {
-		a->data.ints[i] = ntohl(a->data.ints[i]);
+static void push_child(struct reader *r, const struct nbt *child) {
+	if (r->stack_len == r->stack_cap) {
+		r->stack_cap = r->stack_cap > 0 ? r->stack_cap * 2 : 64;
+		r->stack = realloc(r->stack, sizeof(struct nbt) * r->stack_cap);
 	}
-	*array = a;
-	return n;
+	r->stack[r->stack_len++] = *child;
 }
 
-static int nbt_read_long_array(struct nbt_array **array, size_t len, const uint8_t *data) {
-	struct nbt_array *a = malloc(sizeof(struct nbt_array));
-	a->type = TAG_Long_Array;
-	int n = nbt_read_array(a, 8, len, data);
-	for (int32_t i = 0; i < a->len; ++i) {
-		a->data.longs[i] = be64toh(a->data.longs[i]);
+static struct nbt_list *read_compound(struct reader *r) {
+	size_t base = r->stack_len;
+	while (!r->err) {
+		uint8_t t = read_byte(r);
+		if (r->err || t == TAG_End)
+			break;
+		if (t > TAG_Long_Array) {
+			r->err = true;
+			break;
+		}
+		struct nbt child = {0};
+		child.tag = t;
+		child.name = read_string(r);
+		read_payload(r, &child);
+		push_child(r, &child);
 	}
-	*array = a;
-	return n;
+
+	struct nbt_list *l = arena_calloc(r->arena, sizeof(struct nbt_list));
+	l->type = TAG_End;
+	l->len = l->cap = r->stack_len - base;
+	if (l->len > 0) {
+		l->items = arena_alloc(r->arena, sizeof(struct nbt) * l->len);
+		memcpy(l->items, r->stack + base, sizeof(struct nbt) * l->len);
+	}
+	r->stack_len = base;
+	return l;
 }
 
-static ssize_t nbt_unpack_node(struct nbt *, size_t, size_t, const uint8_t *);
+static void read_payload(struct reader *r, struct nbt *n) {
+	if (++(r->depth) > MAX_DEPTH)
+		r->err = true;
+	if (r->err) {
+		--(r->depth);
+		return;
+	}
 
-static int nbt_unpack_node_data(struct nbt *nbt, size_t i, size_t len, const uint8_t *data) {
-	int n = 0;
-	switch (nbt->tag) {
+	switch (n->tag) {
 		case TAG_Byte:
-			if (i < len) {
-				nbt->data.t_byte = data[i];
-				n = 1;
-			} else {
-				n = -1;
-			}
+			n->data.t_byte = read_byte(r);
 			break;
 		case TAG_Short:
-			n = nbt_read_short(&(nbt->data.t_short), i, len, data);
+			n->data.t_short = read_short(r);
 			break;
 		case TAG_Int:
-			n = nbt_read_int(&(nbt->data.t_int), i, len, data);
+			n->data.t_int = read_int(r);
 			break;
 		case TAG_Long:
-			n = nbt_read_long(&(nbt->data.t_long), i, len, data);
+			n->data.t_long = read_long(r);
 			break;
-		case TAG_Float:
-			n = nbt_read_int((int32_t *) &(nbt->data.t_float), i, len, data);
+		case TAG_Float: {
+			int32_t i = read_int(r);
+			memcpy(&(n->data.t_float), &i, 4);
 			break;
-		case TAG_Double:
-			n = nbt_read_long((int64_t *) &(nbt->data.t_double), i, len, data);
+		}
+		case TAG_Double: {
+			int64_t l = read_long(r);
+			memcpy(&(n->data.t_double), &l, 8);
 			break;
+		}
 		case TAG_Byte_Array:
-			nbt->data.array = malloc(sizeof(struct nbt_array));
-			nbt->data.array->type = TAG_Byte_Array;
-			n = nbt_read_array(nbt->data.array, 1, len - i, data + i);
+			n->data.array = read_array(r, TAG_Byte_Array, 1);
 			break;
 		case TAG_String:
-			n = nbt_read_string(&(nbt->data.string), len - i, data + i);
+			n->data.string = read_string(r);
 			break;
 		case TAG_List:
-			nbt->data.list = malloc(sizeof(struct nbt_list));
-			n = nbt_read_list(nbt->data.list, len - i, data + i);
+			n->data.list = read_list(r);
 			break;
 		case TAG_Compound:
-			if (i < len) {
-				/* FIXME: this isn't very clear */
-				n = nbt_unpack_node(nbt, i, len, data) - i;
-			} else {
-				n = -1;
-			}
+			n->data.children = read_compound(r);
 			break;
 		case TAG_Int_Array:
-			n = nbt_read_int_array(&(nbt->data.array), len - i, data + i);
+			n->data.array = read_array(r, TAG_Int_Array, 4);
 			break;
 		case TAG_Long_Array:
-			n = nbt_read_long_array(&(nbt->data.array), len - i, data + i);
+			n->data.array = read_array(r, TAG_Long_Array, 8);
 			break;
 		default:
-			n = -2;
+			r->err = true;
 			break;
 	}
-	return n;
+	--(r->depth);
 }
 
-static ssize_t nbt_unpack_node(struct nbt *root, size_t i, size_t len, const uint8_t *data) {
-	root->data.children = list_new();
-	bool valid_nbt = true;
-	while (valid_nbt && i < len && data[i] != TAG_End) {
-		struct nbt *child = malloc(sizeof(struct nbt));
-		child->tag = data[i];
-		++i;
-		i += nbt_read_string(&(child->name), len - i, data + i);
-
-		int n = nbt_unpack_node_data(child, i, len, data);
-		valid_nbt = n > 0;
-		i += n;
+struct nbt *nbt_unpack(struct arena *a, size_t len, const uint8_t *data) {
+	struct reader r = {0};
+	r.arena = a;
+	r.len = len;
+	r.data = data;
 
-		list_append(root->data.children, sizeof(struct node *), &child);
+	struct nbt *root = arena_calloc(a, sizeof(struct nbt));
+	root->tag = TAG_Compound;
+	if (len > 0 && data[0] == TAG_Compound) {
+		++(r.i);
+		root->name = read_string(&r);
 	}
-
-	if (!valid_nbt) {
-		return -1;
-	}
-	return i + 1;
+	read_payload(&r, root);
+	free(r.stack);
+	return r.err ? NULL : root;
 }
 
-struct nbt *nbt_unpack(size_t len, const uint8_t *data) {
-	size_t i = 0;
-	char *root_name = NULL;
-	if (data[i] == TAG_Compound) {
-		++i;
-		i += nbt_read_string(&root_name, len - i, data + i);
-	}
-	struct nbt *root = nbt_new(TAG_Compound, root_name);
-	if (nbt_unpack_node(root, i, len, data) < 0) {
-		nbt_free(root);
-		return NULL;
-	}
-	return root;
+/* empty strings are NULL in trees that weren't unpacked */
+static size_t nbt_strlen(const char *s) {
+	return s == NULL ? 0 : strlen(s);
 }
 
 static size_t nbt_data_len(struct nbt *);
 
 static size_t nbt_list_len(struct nbt_list *list) {
 	size_t len = 5;
-	struct node *l = list->head;
-	while (!list_empty(l)) {
-		len += nbt_data_len(list_item(l));
-		l = list_next(l);
-	}
+	for (int32_t i = 0; i < list->len; ++i)
+		len += nbt_data_len(&(list->items[i]));
 	return len;
 }
 
@@ -334,7 +337,7 @@ static size_t nbt_data_len(struct nbt *node) {
 		case TAG_Byte_Array:
 			return 4 + node->data.array->len;
 		case TAG_String:
-			return 2 + strlen(node->data.string);
+			return 2 + nbt_strlen(node->data.string);
 		case TAG_List:
 			return nbt_list_len(node->data.list);
 		case TAG_Compound:
@@ -349,23 +352,17 @@ static size_t nbt_data_len(struct nbt *node) {
 
 static size_t nbt_node_len(struct nbt *n) {
 	size_t len = 0;
-
-	struct node *l = n->data.children;
-	while (!list_empty(l)) {
-		struct nbt *child = list_item(l);
-		len += 3 + strlen(child->name);
+	struct nbt_list *children = n->data.children;
+	for (int32_t i = 0; i < children->len; ++i) {
+		struct nbt *child = &(children->items[i]);
+		len += 3 + nbt_strlen(child->name);
 		len += nbt_data_len(child);
-		l = list_next(l);
 	}
-
 	return len + 1;
 }
 
 static size_t nbt_len(struct nbt *root) {
-	size_t len = 3;
-	if (root->name != NULL) {
-		len += strlen(root->name);
-	}
+	size_t len = 3 + nbt_strlen(root->name);
 
 	return len + nbt_node_len(root);
 }
@@ -401,18 +398,11 @@ static size_t nbt_write_double(double d, uint8_t *data) {
 }
 
 static size_t nbt_write_string(const char *s, uint8_t *data) {
-	size_t len = 0;
-	size_t s_len = strlen(s);
-	len += nbt_write_short(s_len, data);
-	data += len;
-
-	while (*s != '\0') {
-		*data = *s;
-		++data;
-		++s;
-		++len;
-	}
-	return len;
+	size_t s_len = nbt_strlen(s);
+	size_t len = nbt_write_short(s_len, data);
+	if (s_len > 0)
+		memcpy(data + len, s, s_len);
+	return len + s_len;
 }
 
 
@@ -431,13 +421,10 @@ static size_t nbt_write_list(struct nbt_list *list, uint8_t *data) {
 	size_t len = 0;
 	data[0] = list->type;
 	++len;
-	len += nbt_write_int(list_len(list->head), data + 1);
+	len += nbt_write_int(list->len, data + 1);
 
-	struct node *l = list->head;
-	while (!list_empty(l)) {
-		len += nbt_pack_node_data(list_item(l), data + len);
-		l = list_next(l);
-	}
+	for (int32_t i = 0; i < list->len; ++i)
+		len += nbt_pack_node_data(&(list->items[i]), data + len);
 	return len;
 }
 
@@ -493,16 +480,13 @@ static size_t nbt_pack_node_data(struct nbt *n, uint8_t *data) {
 
 static size_t nbt_pack_node(struct nbt *n, uint8_t *data) {
 	size_t len = 0;
-
-	struct node *l = n->data.children;
-	while (!list_empty(l)) {
-		struct nbt *child = list_item(l);
+	struct nbt_list *children = n->data.children;
+	for (int32_t i = 0; i < children->len; ++i) {
+		struct nbt *child = &(children->items[i]);
 		data[len] = child->tag;
 		++len;
 		len += nbt_write_string(child->name, data + len);
 		len += nbt_pack_node_data(child, data + len);
-
-		l = list_next(l);
 	}
 
 	data[len] = TAG_End;
@@ -522,7 +506,7 @@ size_t nbt_pack(struct nbt *root, uint8_t **data) {
 		len += nbt_pack_node(root, (*data) + len);
 	} else {
 		const size_t fake_root_len = 4;
-		const size_t root_header_len = 3 + strlen(root->name);
+		const size_t root_header_len = 3 + nbt_strlen(root->name);
 		buf_len = fake_root_len + root_header_len + nbt_data_len(root);
 		*data = malloc(buf_len);
 
@@ -542,29 +526,23 @@ size_t nbt_pack(struct nbt *root, uint8_t **data) {
 	return buf_len;
 }
 
-static struct nbt *nbt_tree_search(struct nbt *, enum tag, char *, bool);
+static struct nbt *nbt_tree_search(struct nbt *, enum tag, const char *, bool);
 
-static struct nbt *nbt_list_search(struct nbt_list *l, enum tag t, char *name) {
+static struct nbt *nbt_list_search(struct nbt_list *l, enum tag t, const char *name) {
 	assert(l->type == TAG_Compound);
 	struct nbt *node = NULL;
-
-	struct node *head = l->head;
-	while (!list_empty(head) && node == NULL) {
-		struct nbt *item = list_item(head);
-		node = nbt_tree_search(item, t, name, true);
-		head = list_next(head);
-	}
-
+	for (int32_t i = 0; i < l->len && node == NULL; ++i)
+		node = nbt_tree_search(&(l->items[i]), t, name, true);
 	return node;
 }
 
-static struct nbt *nbt_tree_search(struct nbt *root, enum tag t, char *name, bool recurse) {
+static struct nbt *nbt_tree_search(struct nbt *root, enum tag t, const char *name, bool recurse) {
 	struct nbt *node = NULL;
 
-	struct node *head = root->data.children;
-	while (!list_empty(head) && node == NULL) {
-		struct nbt *child = list_item(head);
-		if (child->tag == t && strcmp(child->name, name) == 0) {
+	struct nbt_list *children = root->data.children;
+	for (int32_t i = 0; i < children->len && node == NULL; ++i) {
+		struct nbt *child = &(children->items[i]);
+		if (child->tag == t && child->name != NULL && strcmp(child->name, name) == 0) {
 			node = child;
 		} else if (child->tag == TAG_Compound && recurse) {
 			node = nbt_tree_search(child, t, name, recurse);
@@ -573,16 +551,15 @@ static struct nbt *nbt_tree_search(struct nbt *root, enum tag t, char *name, boo
 				&& recurse) {
 			node = nbt_list_search(child->data.list, t, name);
 		}
-		head = list_next(head);
 	}
 
 	return node;
 }
 
-struct nbt *nbt_get(struct nbt *root, enum tag t, char *name) {
+struct nbt *nbt_get(struct nbt *root, enum tag t, const char *name) {
 	return nbt_tree_search(root, t, name, false);
 }
 
-struct nbt *nbt_find(struct nbt *root, enum tag t, char *name) {
+struct nbt *nbt_find(struct nbt *root, enum tag t, const char *name) {
 	return nbt_tree_search(root, t, name, true);
 }
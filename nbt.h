@@ -4,9 +4,9 @@
 #ifndef CHOWDER_NBT_H
 #define CHOWDER_NBT_H
 
+#include <stddef.h>
 #include <stdint.h>
-#include "include/linked_list.h"
-
+#include "include/arena.h"
 
 enum tag {
 	TAG_End,
@@ -34,12 +34,14 @@ union nbt_data {
 	char *string;
 	struct nbt_array *array;
 	struct nbt_list *list;
-	struct node *children;
+	/* a compound's children, in a list of type TAG_End */
+	struct nbt_list *children;
 };
 
 struct nbt {
 	enum tag tag;
-	char *name;
+	/* NULL for list items */
+	const char *name;
 	union nbt_data data;
 };
 
@@ -53,20 +55,36 @@ struct nbt_array {
 	} data;
 };
 
+/* items are stored by value, one after another */
 struct nbt_list {
 	enum tag type;
-	struct node *head;
+	int32_t len;
+	int32_t cap;
+	struct nbt *items;
 };
 
-struct nbt *nbt_new(enum tag, char *name);
-void nbt_free(struct nbt *);
+/* Every node, name + payload in a tree lives in the arena the tree was made
+ * in, so there's no freeing trees, only resetting or freeing their arena.
+ *
+ * Compounds + lists come with no children. Pointers to a compound's or
+ * list's children are only good until the next nbt_add() or nbt_remove() on
+ * it, since its children can move. */
+struct nbt *nbt_new(struct arena *, enum tag, const char *name);
+/* appends a new child to a compound or list, and returns it */
+struct nbt *nbt_add(struct arena *, struct nbt *, enum tag, const char *name);
+/* removes one of a compound's direct children */
+void nbt_remove(struct nbt *, struct nbt *child);
+void nbt_set_string(struct arena *, struct nbt *, const char *value);
+/* gives an array tag len zeroed elements, and returns them */
+void *nbt_set_array(struct arena *, struct nbt *, int32_t len);
 
-struct nbt *nbt_unpack(size_t len, const uint8_t *b);
+/* returns NULL if b isn't valid NBT */
+struct nbt *nbt_unpack(struct arena *, size_t len, const uint8_t *b);
 size_t nbt_pack(struct nbt *, uint8_t **b);
 
 /* returns direct children only */
-struct nbt *nbt_get(struct nbt *, enum tag, char *name);
+struct nbt *nbt_get(struct nbt *, enum tag, const char *name);
 /* searches the whole tree */
-struct nbt *nbt_find(struct nbt *, enum tag, char *name);
+struct nbt *nbt_find(struct nbt *, enum tag, const char *name);
 
 #endif
@@ -0,0 +1,374 @@
+#include <stdbool.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include "nbt_reader.h"
+
+#define MAX_COMPONENTS 16
+#define MAX_DEPTH 512
+
+struct component {
+	const char *s;
+	size_t len;
+};
+
+struct path {
+	int len;
+	struct component components[MAX_COMPONENTS];
+};
+
+struct reader {
+	size_t len;
+	const uint8_t *data;
+	size_t i;
+	int depth;
+	/* 0, -1 for invalid NBT, or what the callback stopped with */
+	int err;
+
+	int paths_len;
+	struct path paths[NBT_READER_MAX_PATHS];
+	nbt_event_func f;
+	void *ctx;
+};
+
+static int compile_path(struct path *p, const char *s) {
+	p->len = 0;
+	while (*s != '\0') {
+		if (p->len == MAX_COMPONENTS)
+			return -1;
+		struct component *c = &(p->components[p->len++]);
+		c->s = s;
+		if (strncmp(s, "[]", 2) == 0) {
+			c->len = 2;
+		} else {
+			c->len = strcspn(s, ".[");
+		}
+		s += c->len;
+		if (*s == '.')
+			++s;
+	}
+	return 0;
+}
+
+static bool is_component(const struct component *c, const char *s) {
+	return c->len == strlen(s) && strncmp(c->s, s, c->len) == 0;
+}
+
+/* which of the paths in mask go on to a child at depth, called name or
+ * just being a list item */
+static uint32_t child_mask(const struct reader *r, uint32_t mask, int depth, const char *name, size_t name_len, bool list_item) {
+	uint32_t child = 0;
+	for (int p = 0; p < r->paths_len; ++p) {
+		const struct path *path = &(r->paths[p]);
+		if (!(mask & (1u << p)) || path->len <= depth)
+			continue;
+		const struct component *c = &(path->components[depth]);
+		bool match;
+		if (list_item)
+			match = is_component(c, "[]");
+		else
+			match = is_component(c, "*") || (c->len == name_len && memcmp(c->s, name, name_len) == 0);
+		if (match)
+			child |= 1u << p;
+	}
+	return child;
+}
+
+/* which of the paths in mask end at depth */
+static uint32_t exact_mask(const struct reader *r, uint32_t mask, int depth) {
+	uint32_t exact = 0;
+	for (int p = 0; p < r->paths_len; ++p) {
+		if ((mask & (1u << p)) && r->paths[p].len == depth + 1)
+			exact |= 1u << p;
+	}
+	return exact;
+}
+
+static void emit(struct reader *r, uint32_t mask, const struct nbt_event *e) {
+	for (int p = 0; p < r->paths_len && r->err == 0 && mask != 0; ++p) {
+		if (mask & (1u << p)) {
+			int n = r->f(r->ctx, p, e);
+			if (n < 0)
+				r->err = n;
+		}
+	}
+}
+
+static bool has_bytes(struct reader *r, size_t n) {
+	if (r->err == 0 && r->len - r->i < n)
+		r->err = -1;
+	return r->err == 0;
+}
+
+static const uint8_t *take(struct reader *r, size_t n) {
+	if (!has_bytes(r, n))
+		return NULL;
+	const uint8_t *p = r->data + r->i;
+	r->i += n;
+	return p;
+}
+
+static uint8_t read_byte(struct reader *r) {
+	const uint8_t *p = take(r, 1);
+	return p != NULL ? *p : 0;
+}
+
+static uint16_t read_short(struct reader *r) {
+	uint16_t v = 0;
+	const uint8_t *p = take(r, 2);
+	if (p != NULL)
+		memcpy(&v, p, 2);
+	return ntohs(v);
+}
+
+static int32_t read_int(struct reader *r) {
+	uint32_t v = 0;
+	const uint8_t *p = take(r, 4);
+	if (p != NULL)
+		memcpy(&v, p, 4);
+	return ntohl(v);
+}
+
+static int64_t read_long(struct reader *r) {
+	uint64_t v = 0;
+	const uint8_t *p = take(r, 8);
+	if (p != NULL)
+		memcpy(&v, p, 8);
+	return be64toh(v);
+}
+
+/* payload size of tags that always take the same space, otherwise 0 */
+static size_t fixed_len(enum tag t) {
+	switch (t) {
+		case TAG_Byte:
+			return 1;
+		case TAG_Short:
+			return 2;
+		case TAG_Int:
+		case TAG_Float:
+			return 4;
+		case TAG_Long:
+		case TAG_Double:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+static size_t array_elem_len(enum tag t) {
+	return t == TAG_Long_Array ? 8 : t == TAG_Int_Array ? 4 : 1;
+}
+
+static void skip(struct reader *r, enum tag t) {
+	if (++(r->depth) > MAX_DEPTH && r->err == 0)
+		r->err = -1;
+	if (r->err != 0) {
+		--(r->depth);
+		return;
+	}
+
+	size_t fixed = fixed_len(t);
+	if (fixed > 0) {
+		take(r, fixed);
+	} else if (t == TAG_String) {
+		take(r, read_short(r));
+	} else if (t == TAG_Byte_Array || t == TAG_Int_Array || t == TAG_Long_Array) {
+		int32_t len = read_int(r);
+		if (len < 0 && r->err == 0)
+			r->err = -1;
+		take(r, (size_t) len * array_elem_len(t));
+	} else if (t == TAG_List) {
+		enum tag type = read_byte(r);
+		int32_t len = read_int(r);
+		if ((len < 0 || type > TAG_Long_Array) && r->err == 0)
+			r->err = -1;
+		/* lists of numbers skip in one go */
+		if (fixed_len(type) > 0) {
+			take(r, (size_t) len * fixed_len(type));
+		} else if (type != TAG_End) {
+			for (int32_t i = 0; i < len && r->err == 0; ++i)
+				skip(r, type);
+		}
+	} else if (t == TAG_Compound) {
+		enum tag child;
+		while (r->err == 0 && (child = read_byte(r)) != TAG_End) {
+			take(r, read_short(r));
+			skip(r, child);
+		}
+	} else if (r->err == 0) {
+		r->err = -1;
+	}
+	--(r->depth);
+}
+
+static void visit(struct reader *, struct nbt_event *, uint32_t mask, int depth);
+
+static void visit_compound(struct reader *r, uint32_t deeper, int depth) {
+	enum tag t;
+	while (r->err == 0 && (t = read_byte(r)) != TAG_End) {
+		if (t > TAG_Long_Array) {
+			r->err = -1;
+			break;
+		}
+		struct nbt_event child = {0};
+		child.tag = t;
+		child.name_len = read_short(r);
+		child.name = (const char *) take(r, child.name_len);
+		child.index = -1;
+		if (r->err != 0)
+			break;
+		uint32_t mask = child_mask(r, deeper, depth + 1, child.name, child.name_len, false);
+		visit(r, &child, mask, depth + 1);
+	}
+}
+
+static void visit_list(struct reader *r, enum tag type, int32_t len, uint32_t deeper, int depth) {
+	uint32_t mask = child_mask(r, deeper, depth + 1, NULL, 0, true);
+	for (int32_t i = 0; i < len && r->err == 0; ++i) {
+		struct nbt_event item = {0};
+		item.tag = type;
+		item.index = i;
+		visit(r, &item, mask, depth + 1);
+	}
+}
+
+/* e has the tag + name filled in, and the reader is at its payload */
+static void visit(struct reader *r, struct nbt_event *e, uint32_t mask, int depth) {
+	if (mask == 0) {
+		skip(r, e->tag);
+		return;
+	}
+	if (++(r->depth) > MAX_DEPTH && r->err == 0)
+		r->err = -1;
+	if (r->err != 0) {
+		--(r->depth);
+		return;
+	}
+
+	uint32_t exact = exact_mask(r, mask, depth);
+	uint32_t deeper = mask & ~exact;
+	switch (e->tag) {
+		case TAG_Compound:
+			e->type = NBT_EVENT_BEGIN;
+			emit(r, exact, e);
+			if (deeper != 0)
+				visit_compound(r, deeper, depth);
+			else
+				skip(r, TAG_Compound);
+			e->type = NBT_EVENT_END;
+			emit(r, exact, e);
+			break;
+		case TAG_List:
+			e->value.array.type = read_byte(r);
+			e->value.array.len = read_int(r);
+			if ((e->value.array.len < 0 || e->value.array.type > TAG_Long_Array) && r->err == 0)
+				r->err = -1;
+			e->type = NBT_EVENT_BEGIN;
+			emit(r, exact, e);
+			if (deeper != 0 && e->value.array.type != TAG_End) {
+				visit_list(r, e->value.array.type, e->value.array.len, deeper, depth);
+			} else if (fixed_len(e->value.array.type) > 0) {
+				take(r, (size_t) e->value.array.len * fixed_len(e->value.array.type));
+			} else if (e->value.array.type != TAG_End) {
+				for (int32_t i = 0; i < e->value.array.len && r->err == 0; ++i)
+					skip(r, e->value.array.type);
+			}
+			e->type = NBT_EVENT_END;
+			emit(r, exact, e);
+			break;
+		case TAG_String:
+			e->value.string.len = read_short(r);
+			e->value.string.s = (const char *) take(r, e->value.string.len);
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		case TAG_Byte_Array:
+		case TAG_Int_Array:
+		case TAG_Long_Array:
+			e->value.array.type = e->tag;
+			e->value.array.len = read_int(r);
+			if (e->value.array.len < 0 && r->err == 0)
+				r->err = -1;
+			e->value.array.data = take(r, (size_t) e->value.array.len * array_elem_len(e->tag));
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		case TAG_Byte:
+			e->value.integer = (int8_t) read_byte(r);
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		case TAG_Short:
+			e->value.integer = (int16_t) read_short(r);
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		case TAG_Int:
+			e->value.integer = read_int(r);
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		case TAG_Long:
+			e->value.integer = read_long(r);
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		case TAG_Float: {
+			int32_t i = read_int(r);
+			float f;
+			memcpy(&f, &i, 4);
+			e->value.real = f;
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		}
+		case TAG_Double: {
+			int64_t l = read_long(r);
+			memcpy(&(e->value.real), &l, 8);
+			e->type = NBT_EVENT_VALUE;
+			emit(r, exact, e);
+			break;
+		}
+		default:
+			r->err = -1;
+			break;
+	}
+	--(r->depth);
+}
+
+int nbt_read_paths(size_t len, const uint8_t *data, const char *const *paths, int paths_len, nbt_event_func f, void *ctx) {
+	if (paths_len > NBT_READER_MAX_PATHS)
+		return -1;
+	struct reader r = {0};
+	r.len = len;
+	r.data = data;
+	r.f = f;
+	r.ctx = ctx;
+	r.paths_len = paths_len;
+	for (int p = 0; p < paths_len; ++p) {
+		if (compile_path(&(r.paths[p]), paths[p]) < 0)
+			return -1;
+	}
+
+	/* the root compound + its name */
+	if (read_byte(&r) != TAG_Compound)
+		return -1;
+	take(&r, read_short(&r));
+	uint32_t all = paths_len == 32 ? UINT32_MAX : (1u << paths_len) - 1;
+	/* the root's children are at depth 0, so it's at -1 */
+	visit_compound(&r, all, -1);
+	return r.err;
+}
+
+void nbt_event_longs(const struct nbt_event *e, int64_t *dst) {
+	memcpy(dst, e->value.array.data, sizeof(int64_t) * e->value.array.len);
+	for (int32_t i = 0; i < e->value.array.len; ++i)
+		dst[i] = be64toh(dst[i]);
+}
+
+void nbt_event_ints(const struct nbt_event *e, int32_t *dst) {
+	memcpy(dst, e->value.array.data, sizeof(int32_t) * e->value.array.len);
+	for (int32_t i = 0; i < e->value.array.len; ++i)
+		dst[i] = ntohl(dst[i]);
+}
@@ -0,0 +1,65 @@
+/* Reads just the parts of an NBT blob that are asked for, in one pass over
+ * the buffer and without allocating, by calling back with events for the
+ * tags at the given paths and skipping every subtree that can't hold one.
+ *
+ * Paths are tag names separated by '.', where "[]" stands for every item of
+ * a list and "*" for every child of a compound, like
+ * "Level.Sections[].Palette[].Properties.*". The root compound isn't part
+ * of any path.
+ */
+#ifndef CHOWDER_NBT_READER_H
+#define CHOWDER_NBT_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nbt.h"
+
+#define NBT_READER_MAX_PATHS 32
+
+enum nbt_event_type {
+	/* a compound or list at one of the paths is starting. its children
+	 * are only visited if some longer path goes into them */
+	NBT_EVENT_BEGIN,
+	NBT_EVENT_END,
+	/* any other tag */
+	NBT_EVENT_VALUE,
+};
+
+/* names, strings + arrays point into the buffer being read. strings aren't
+ * '\0' terminated, and arrays are still big endian, see nbt_event_longs() */
+struct nbt_event {
+	enum nbt_event_type type;
+	enum tag tag;
+	const char *name;
+	uint16_t name_len;
+	/* for list items, otherwise -1 */
+	int32_t index;
+	union {
+		int64_t integer;
+		double real;
+		struct {
+			const char *s;
+			uint16_t len;
+		} string;
+		/* also the item type + length of a list */
+		struct {
+			enum tag type;
+			int32_t len;
+			const uint8_t *data;
+		} array;
+	} value;
+};
+
+/* path is the index into the paths given to nbt_read_paths(). returning
+ * < 0 stops reading */
+typedef int (*nbt_event_func)(void *ctx, int path, const struct nbt_event *);
+
+/* returns 0, -1 for invalid NBT, or whatever < 0 the callback stopped with */
+int nbt_read_paths(size_t len, const uint8_t *data, const char *const *paths, int paths_len, nbt_event_func, void *ctx);
+
+/* copies a long array event's values to dst, in host byte order */
+void nbt_event_longs(const struct nbt_event *, int64_t *dst);
+void nbt_event_ints(const struct nbt_event *, int32_t *dst);
+
+#endif
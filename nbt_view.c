@@ -0,0 +1,372 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include "nbt_view.h"
+
+#define MAX_DEPTH 512
+#define TAGS_MIN_CAP 64
+
+static uint16_t be16(const uint8_t *p) {
+	uint16_t v;
+	memcpy(&v, p, 2);
+	return ntohs(v);
+}
+
+static uint32_t be32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return ntohl(v);
+}
+
+static uint64_t be64(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return be64toh(v);
+}
+
+static bool fits(const struct nbt_view *v, size_t off, size_t n) {
+	return off <= v->len && v->len - off >= n;
+}
+
+/* payload size of tags that always take the same space, otherwise 0 */
+static size_t fixed_len(enum tag t) {
+	switch (t) {
+		case TAG_Byte:
+			return 1;
+		case TAG_Short:
+			return 2;
+		case TAG_Int:
+		case TAG_Float:
+			return 4;
+		case TAG_Long:
+		case TAG_Double:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+static size_t array_elem_len(enum tag t) {
+	return t == TAG_Long_Array ? 8 : t == TAG_Int_Array ? 4 : 1;
+}
+
+/* returns the offset just past the payload of a t at off, or 0 if it isn't
+ * valid */
+static size_t skip_payload(const struct nbt_view *v, size_t off, enum tag t, int depth) {
+	if (depth > MAX_DEPTH)
+		return 0;
+
+	size_t fixed = fixed_len(t);
+	if (fixed > 0)
+		return fits(v, off, fixed) ? off + fixed : 0;
+
+	switch (t) {
+		case TAG_String: {
+			if (!fits(v, off, 2))
+				return 0;
+			size_t len = be16(v->data + off);
+			off += 2;
+			return fits(v, off, len) ? off + len : 0;
+		}
+		case TAG_Byte_Array:
+		case TAG_Int_Array:
+		case TAG_Long_Array: {
+			if (!fits(v, off, 4))
+				return 0;
+			int32_t len = be32(v->data + off);
+			off += 4;
+			if (len < 0 || !fits(v, off, (size_t) len * array_elem_len(t)))
+				return 0;
+			return off + (size_t) len * array_elem_len(t);
+		}
+		case TAG_List: {
+			if (!fits(v, off, 5))
+				return 0;
+			enum tag type = v->data[off];
+			int32_t len = be32(v->data + off + 1);
+			off += 5;
+			if (type > TAG_Long_Array || len < 0)
+				return 0;
+			if (type == TAG_End)
+				return off;
+			if (fixed_len(type) > 0)
+				return fits(v, off, (size_t) len * fixed_len(type)) ? off + (size_t) len * fixed_len(type) : 0;
+			for (int32_t i = 0; i < len && off != 0; ++i)
+				off = skip_payload(v, off, type, depth + 1);
+			return off;
+		}
+		case TAG_Compound:
+			for (;;) {
+				if (!fits(v, off, 1))
+					return 0;
+				enum tag child = v->data[off++];
+				if (child == TAG_End)
+					return off;
+				if (child > TAG_Long_Array || !fits(v, off, 2))
+					return 0;
+				off += 2 + be16(v->data + off);
+				off = skip_payload(v, off, child, depth + 1);
+				if (off == 0)
+					return 0;
+			}
+		default:
+			return 0;
+	}
+}
+
+static int add_tag(struct nbt_view *v, size_t name, size_t payload, enum tag t) {
+	if (v->tags_len == v->tags_cap) {
+		size_t cap = v->tags_cap > 0 ? v->tags_cap * 2 : TAGS_MIN_CAP;
+		struct nbt_view_tag *tags = realloc(v->tags, sizeof(struct nbt_view_tag) * cap);
+		if (tags == NULL) {
+			perror("realloc");
+			return -1;
+		}
+		v->tags = tags;
+		v->tags_cap = cap;
+	}
+	v->tags[v->tags_len] = (struct nbt_view_tag) {name, payload, 0, t};
+	return v->tags_len++;
+}
+
+/* indexes the payload of tag i at off + everything under it. returns the
+ * offset just past it, or 0 if it isn't valid */
+static size_t index_payload(struct nbt_view *v, int i, size_t off, enum tag t, int depth) {
+	if (depth > MAX_DEPTH)
+		return 0;
+
+	if (t == TAG_Compound) {
+		for (;;) {
+			if (!fits(v, off, 1))
+				return 0;
+			enum tag child = v->data[off++];
+			if (child == TAG_End)
+				break;
+			if (child > TAG_Long_Array || !fits(v, off, 2))
+				return 0;
+			size_t name = off;
+			off += 2 + be16(v->data + off);
+			if (!fits(v, off, 0))
+				return 0;
+			int c = add_tag(v, name, off, child);
+			if (c < 0)
+				return 0;
+			off = index_payload(v, c, off, child, depth + 1);
+			if (off == 0)
+				return 0;
+		}
+	} else if (t == TAG_List && fits(v, off, 5) && v->data[off] <= TAG_Long_Array
+			&& v->data[off] != TAG_End && fixed_len(v->data[off]) == 0) {
+		/* only lists of things that can't be found by their index get
+		 * their items indexed */
+		enum tag type = v->data[off];
+		int32_t len = be32(v->data + off + 1);
+		off += 5;
+		if (len < 0)
+			return 0;
+		for (int32_t j = 0; j < len; ++j) {
+			int c = add_tag(v, 0, off, type);
+			if (c < 0)
+				return 0;
+			off = index_payload(v, c, off, type, depth + 1);
+			if (off == 0)
+				return 0;
+		}
+	} else {
+		off = skip_payload(v, off, t, depth);
+		if (off == 0)
+			return 0;
+	}
+
+	v->tags[i].end = v->tags_len;
+	return off;
+}
+
+int nbt_view_init(struct nbt_view *v, size_t len, const uint8_t *data) {
+	*v = (struct nbt_view) {0};
+	v->len = len;
+	v->data = data;
+	/* offsets are stored in 32 bits */
+	if (len > UINT32_MAX || !fits(v, 0, 3) || data[0] != TAG_Compound)
+		return -1;
+
+	size_t payload = 3 + be16(data + 1);
+	if (!fits(v, payload, 0) || add_tag(v, 1, payload, TAG_Compound) < 0
+			|| index_payload(v, 0, payload, TAG_Compound, 0) == 0) {
+		nbt_view_free(v);
+		return -1;
+	}
+	return 0;
+}
+
+void nbt_view_free(struct nbt_view *v) {
+	free(v->tags);
+	v->tags = NULL;
+	v->tags_len = 0;
+	v->tags_cap = 0;
+}
+
+enum tag nbt_view_tag(const struct nbt_view *v, int t) {
+	return v->tags[t].tag;
+}
+
+const char *nbt_view_name(const struct nbt_view *v, int t, uint16_t *len) {
+	uint32_t name = v->tags[t].name;
+	if (name == 0) {
+		*len = 0;
+		return NULL;
+	}
+	*len = be16(v->data + name);
+	return (const char *) v->data + name + 2;
+}
+
+int32_t nbt_view_len(const struct nbt_view *v, int t) {
+	const uint8_t *p = v->data + v->tags[t].payload;
+	switch (v->tags[t].tag) {
+		case TAG_Compound: {
+			int32_t len = 0;
+			for (int c = nbt_view_first(v, t); c >= 0; c = nbt_view_next(v, t, c))
+				++len;
+			return len;
+		}
+		case TAG_List:
+			return be32(p + 1);
+		case TAG_Byte_Array:
+		case TAG_Int_Array:
+		case TAG_Long_Array:
+			return be32(p);
+		case TAG_String:
+			return be16(p);
+		default:
+			return 0;
+	}
+}
+
+enum tag nbt_view_list_type(const struct nbt_view *v, int t) {
+	return v->data[v->tags[t].payload];
+}
+
+int nbt_view_first(const struct nbt_view *v, int t) {
+	return v->tags[t].end > (uint32_t) t + 1 ? t + 1 : -1;
+}
+
+int nbt_view_next(const struct nbt_view *v, int t, int child) {
+	return v->tags[child].end < v->tags[t].end ? (int) v->tags[child].end : -1;
+}
+
+static bool has_name(const struct nbt_view *v, int t, enum tag tag, const char *name, size_t name_len) {
+	uint16_t len;
+	const char *s = nbt_view_name(v, t, &len);
+	return v->tags[t].tag == tag && s != NULL && len == name_len && memcmp(s, name, len) == 0;
+}
+
+int nbt_view_get(const struct nbt_view *v, int t, enum tag tag, const char *name) {
+	size_t name_len = strlen(name);
+	for (int c = nbt_view_first(v, t); c >= 0; c = nbt_view_next(v, t, c)) {
+		if (has_name(v, c, tag, name, name_len))
+			return c;
+	}
+	return -1;
+}
+
+int nbt_view_find(const struct nbt_view *v, int t, enum tag tag, const char *name) {
+	/* the table is in the same order as a depth first search */
+	size_t name_len = strlen(name);
+	for (uint32_t c = t + 1; c < v->tags[t].end; ++c) {
+		if (has_name(v, c, tag, name, name_len))
+			return c;
+	}
+	return -1;
+}
+
+static int64_t read_integer(const uint8_t *p, enum tag t) {
+	switch (t) {
+		case TAG_Byte:
+		case TAG_Byte_Array:
+			return (int8_t) *p;
+		case TAG_Short:
+			return (int16_t) be16(p);
+		case TAG_Int:
+		case TAG_Int_Array:
+			return (int32_t) be32(p);
+		case TAG_Long:
+		case TAG_Long_Array:
+			return (int64_t) be64(p);
+		default:
+			return 0;
+	}
+}
+
+static double read_real(const uint8_t *p, enum tag t) {
+	if (t == TAG_Float) {
+		uint32_t i = be32(p);
+		float f;
+		memcpy(&f, &i, 4);
+		return f;
+	} else if (t == TAG_Double) {
+		uint64_t l = be64(p);
+		double d;
+		memcpy(&d, &l, 8);
+		return d;
+	}
+	return 0;
+}
+
+int64_t nbt_view_integer(const struct nbt_view *v, int t) {
+	return read_integer(v->data + v->tags[t].payload, v->tags[t].tag);
+}
+
+double nbt_view_real(const struct nbt_view *v, int t) {
+	return read_real(v->data + v->tags[t].payload, v->tags[t].tag);
+}
+
+const char *nbt_view_string(const struct nbt_view *v, int t, uint16_t *len) {
+	const uint8_t *p = v->data + v->tags[t].payload;
+	*len = be16(p);
+	return (const char *) p + 2;
+}
+
+/* where element i of an array or list of numbers starts, + its type */
+static const uint8_t *element_at(const struct nbt_view *v, int t, int32_t i, enum tag *type) {
+	if (i < 0 || i >= nbt_view_len(v, t))
+		return NULL;
+	const uint8_t *p = v->data + v->tags[t].payload;
+	switch (v->tags[t].tag) {
+		case TAG_Byte_Array:
+		case TAG_Int_Array:
+		case TAG_Long_Array:
+			*type = v->tags[t].tag;
+			return p + 4 + i * array_elem_len(*type);
+		case TAG_List:
+			*type = p[0];
+			if (fixed_len(*type) == 0)
+				return NULL;
+			return p + 5 + i * fixed_len(*type);
+		default:
+			return NULL;
+	}
+}
+
+int64_t nbt_view_integer_at(const struct nbt_view *v, int t, int32_t i) {
+	enum tag type;
+	const uint8_t *p = element_at(v, t, i, &type);
+	return p != NULL ? read_integer(p, type) : 0;
+}
+
+double nbt_view_real_at(const struct nbt_view *v, int t, int32_t i) {
+	enum tag type;
+	const uint8_t *p = element_at(v, t, i, &type);
+	return p != NULL ? read_real(p, type) : 0;
+}
+
+const uint8_t *nbt_view_raw(const struct nbt_view *v, int t, size_t *len) {
+	const struct nbt_view_tag *tag = &(v->tags[t]);
+	/* list items are just their payload */
+	size_t start = tag->name != 0 ? tag->name - 1 : tag->payload;
+	*len = skip_payload(v, tag->payload, tag->tag, 0) - start;
+	return v->data + start;
+}
@@ -0,0 +1,77 @@
+/* A read-only view of an NBT blob that leaves it where it is. Indexing the
+ * buffer takes one pass and records where each tag starts in a side table,
+ * and everything after that is looked up through the table: names, strings
+ * + arrays come back as pointers into the buffer, and numbers are only
+ * byte-swapped when they're read.
+ *
+ * Tags are ints indexing the table, with the root compound at 0 and -1 for
+ * "no such tag". Lists of numbers don't get an entry per item, their items
+ * are read with nbt_view_integer_at() + nbt_view_real_at() like arrays.
+ *
+ * Meant for inspecting big blobs that are mostly read, where building a
+ * tree would cost several times the blob itself.
+ */
+#ifndef CHOWDER_NBT_VIEW_H
+#define CHOWDER_NBT_VIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nbt.h"
+
+struct nbt_view_tag {
+	/* offset of the name's length prefix, 0 for list items */
+	uint32_t name;
+	/* offset of the payload */
+	uint32_t payload;
+	/* index of the first tag after this one's subtree */
+	uint32_t end;
+	uint8_t tag;
+};
+
+struct nbt_view {
+	size_t len;
+	const uint8_t *data;
+	size_t tags_len;
+	size_t tags_cap;
+	struct nbt_view_tag *tags;
+};
+
+/* data has to outlive the view. returns -1 if it isn't valid NBT */
+int nbt_view_init(struct nbt_view *, size_t len, const uint8_t *data);
+void nbt_view_free(struct nbt_view *);
+
+enum tag nbt_view_tag(const struct nbt_view *, int t);
+/* not '\0' terminated. NULL for list items */
+const char *nbt_view_name(const struct nbt_view *, int t, uint16_t *len);
+/* # of children of a compound, items of a list, elements of an array or
+ * bytes of a string */
+int32_t nbt_view_len(const struct nbt_view *, int t);
+enum tag nbt_view_list_type(const struct nbt_view *, int t);
+
+/* a compound's or list's children, eg.
+ * for (int c = nbt_view_first(v, t); c >= 0; c = nbt_view_next(v, t, c)) */
+int nbt_view_first(const struct nbt_view *, int t);
+int nbt_view_next(const struct nbt_view *, int t, int child);
+
+/* returns direct children only */
+int nbt_view_get(const struct nbt_view *, int t, enum tag, const char *name);
+/* searches t's whole subtree */
+int nbt_view_find(const struct nbt_view *, int t, enum tag, const char *name);
+
+/* TAG_Byte/Short/Int/Long */
+int64_t nbt_view_integer(const struct nbt_view *, int t);
+/* TAG_Float/Double */
+double nbt_view_real(const struct nbt_view *, int t);
+/* not '\0' terminated */
+const char *nbt_view_string(const struct nbt_view *, int t, uint16_t *len);
+/* element i of an array or of a list of numbers */
+int64_t nbt_view_integer_at(const struct nbt_view *, int t, int32_t i);
+double nbt_view_real_at(const struct nbt_view *, int t, int32_t i);
+
+/* the tag's whole encoding (type, name + payload) as it is in the buffer,
+ * which is valid NBT by itself when t is a compound. list items have no
+ * type or name, so that's just their payload */
+const uint8_t *nbt_view_raw(const struct nbt_view *, int t, size_t *len);
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include "nbt_writer.h"
+
+#define WRITER_MIN_CAP 4096
+/* big arrays get byte-swapped this many elements at a time */
+#define SWAP_BATCH 64
+
+void nbt_writer_init(struct nbt_writer *w) {
+	*w = (struct nbt_writer) {0};
+}
+
+void nbt_writer_init_packet(struct nbt_writer *w, struct packet *p) {
+	*w = (struct nbt_writer) {0};
+	w->packet = p;
+}
+
+void nbt_writer_reset(struct nbt_writer *w) {
+	w->len = 0;
+	w->depth = 0;
+	w->err = 0;
+}
+
+void nbt_writer_free(struct nbt_writer *w) {
+	free(w->data);
+	w->data = NULL;
+	w->len = 0;
+	w->cap = 0;
+}
+
+static void put_bytes(struct nbt_writer *w, const void *b, size_t len) {
+	if (w->err != 0 || len == 0)
+		return;
+
+	if (w->packet != NULL) {
+		int n = packet_write_bytes(w->packet, len, b);
+		if (n < 0)
+			w->err = n;
+		return;
+	}
+
+	if (w->cap - w->len < len) {
+		size_t cap = w->cap > 0 ? w->cap : WRITER_MIN_CAP;
+		while (cap - w->len < len)
+			cap *= 2;
+		uint8_t *data = realloc(w->data, cap);
+		if (data == NULL) {
+			perror("realloc");
+			w->err = -1;
+			return;
+		}
+		w->data = data;
+		w->cap = cap;
+	}
+	memcpy(w->data + w->len, b, len);
+	w->len += len;
+}
+
+static void put_u8(struct nbt_writer *w, uint8_t b) {
+	put_bytes(w, &b, 1);
+}
+
+static void put_u16(struct nbt_writer *w, uint16_t s) {
+	s = htons(s);
+	put_bytes(w, &s, 2);
+}
+
+static void put_u32(struct nbt_writer *w, uint32_t i) {
+	i = htonl(i);
+	put_bytes(w, &i, 4);
+}
+
+static void put_u64(struct nbt_writer *w, uint64_t l) {
+	l = htobe64(l);
+	put_bytes(w, &l, 8);
+}
+
+static void fail(struct nbt_writer *w, const char *msg) {
+	if (w->err == 0) {
+		fprintf(stderr, "nbt_writer: %s\n", msg);
+		w->err = -1;
+	}
+}
+
+/* writes the type + name of a tag in a compound, or counts off an item of
+ * the current list */
+static void put_header(struct nbt_writer *w, enum tag t, const char *name) {
+	if (w->depth == 0) {
+		if (t != TAG_Compound)
+			fail(w, "the root has to be a compound");
+	} else {
+		struct nbt_writer_level *l = &(w->levels[w->depth - 1]);
+		if (l->list) {
+			if (t != l->type)
+				fail(w, "list item has the wrong type");
+			else if (l->remaining-- <= 0)
+				fail(w, "too many list items");
+			return;
+		}
+	}
+
+	size_t len = name != NULL ? strlen(name) : 0;
+	if (len > UINT16_MAX) {
+		fail(w, "name is too long");
+		return;
+	}
+	put_u8(w, t);
+	put_u16(w, len);
+	put_bytes(w, name, len);
+}
+
+static void push(struct nbt_writer *w, bool list, enum tag type, int32_t len) {
+	if (w->depth == NBT_WRITER_MAX_DEPTH) {
+		fail(w, "nested too deep");
+		return;
+	}
+	w->levels[w->depth++] = (struct nbt_writer_level) {list, type, len};
+}
+
+void nbt_begin_compound(struct nbt_writer *w, const char *name) {
+	put_header(w, TAG_Compound, name);
+	push(w, false, TAG_End, 0);
+}
+
+void nbt_begin_list(struct nbt_writer *w, const char *name, enum tag type, int32_t len) {
+	put_header(w, TAG_List, name);
+	/* lists of TAG_End can only be empty */
+	if (len < 0 || (type == TAG_End && len > 0))
+		fail(w, "invalid list length");
+	put_u8(w, type);
+	put_u32(w, len);
+	push(w, true, type, len);
+}
+
+void nbt_end(struct nbt_writer *w) {
+	if (w->depth == 0) {
+		fail(w, "nothing to end");
+		return;
+	}
+	struct nbt_writer_level *l = &(w->levels[--(w->depth)]);
+	if (!l->list)
+		put_u8(w, TAG_End);
+	else if (l->remaining != 0)
+		fail(w, "list ended before all its items were written");
+}
+
+void nbt_put_byte(struct nbt_writer *w, const char *name, int8_t b) {
+	put_header(w, TAG_Byte, name);
+	put_u8(w, b);
+}
+
+void nbt_put_short(struct nbt_writer *w, const char *name, int16_t s) {
+	put_header(w, TAG_Short, name);
+	put_u16(w, s);
+}
+
+void nbt_put_int(struct nbt_writer *w, const char *name, int32_t i) {
+	put_header(w, TAG_Int, name);
+	put_u32(w, i);
+}
+
+void nbt_put_long(struct nbt_writer *w, const char *name, int64_t l) {
+	put_header(w, TAG_Long, name);
+	put_u64(w, l);
+}
+
+void nbt_put_float(struct nbt_writer *w, const char *name, float f) {
+	uint32_t i;
+	memcpy(&i, &f, 4);
+	put_header(w, TAG_Float, name);
+	put_u32(w, i);
+}
+
+void nbt_put_double(struct nbt_writer *w, const char *name, double d) {
+	uint64_t l;
+	memcpy(&l, &d, 8);
+	put_header(w, TAG_Double, name);
+	put_u64(w, l);
+}
+
+void nbt_put_string(struct nbt_writer *w, const char *name, const char *s, size_t len) {
+	put_header(w, TAG_String, name);
+	if (len > UINT16_MAX) {
+		fail(w, "string is too long");
+		return;
+	}
+	put_u16(w, len);
+	put_bytes(w, s, len);
+}
+
+void nbt_put_byte_array(struct nbt_writer *w, const char *name, const int8_t *bytes, int32_t len) {
+	put_header(w, TAG_Byte_Array, name);
+	put_u32(w, len);
+	put_bytes(w, bytes, len);
+}
+
+void nbt_put_int_array(struct nbt_writer *w, const char *name, const int32_t *ints, int32_t len) {
+	put_header(w, TAG_Int_Array, name);
+	put_u32(w, len);
+	uint32_t batch[SWAP_BATCH];
+	for (int32_t i = 0; i < len; i += SWAP_BATCH) {
+		int32_t n = len - i < SWAP_BATCH ? len - i : SWAP_BATCH;
+		for (int32_t j = 0; j < n; ++j)
+			batch[j] = htonl(ints[i + j]);
+		put_bytes(w, batch, sizeof(uint32_t) * n);
+	}
+}
+
+void nbt_put_long_array(struct nbt_writer *w, const char *name, const int64_t *longs, int32_t len) {
+	put_header(w, TAG_Long_Array, name);
+	put_u32(w, len);
+	uint64_t batch[SWAP_BATCH];
+	for (int32_t i = 0; i < len; i += SWAP_BATCH) {
+		int32_t n = len - i < SWAP_BATCH ? len - i : SWAP_BATCH;
+		for (int32_t j = 0; j < n; ++j)
+			batch[j] = htobe64(longs[i + j]);
+		put_bytes(w, batch, sizeof(uint64_t) * n);
+	}
+}
+
+void nbt_put_raw(struct nbt_writer *w, const uint8_t *b, size_t len) {
+	if (w->depth == 0) {
+		fail(w, "raw tags have to go in a compound or list");
+		return;
+	}
+	struct nbt_writer_level *l = &(w->levels[w->depth - 1]);
+	if (l->list && l->remaining-- <= 0)
+		fail(w, "too many list items");
+	put_bytes(w, b, len);
+}
+
+static void put_node(struct nbt_writer *w, struct nbt *n) {
+	const char *name = n->name;
+	switch (n->tag) {
+		case TAG_Byte:
+			nbt_put_byte(w, name, n->data.t_byte);
+			break;
+		case TAG_Short:
+			nbt_put_short(w, name, n->data.t_short);
+			break;
+		case TAG_Int:
+			nbt_put_int(w, name, n->data.t_int);
+			break;
+		case TAG_Long:
+			nbt_put_long(w, name, n->data.t_long);
+			break;
+		case TAG_Float:
+			nbt_put_float(w, name, n->data.t_float);
+			break;
+		case TAG_Double:
+			nbt_put_double(w, name, n->data.t_double);
+			break;
+		case TAG_String: {
+			const char *s = n->data.string != NULL ? n->data.string : "";
+			nbt_put_string(w, name, s, strlen(s));
+			break;
+		}
+		case TAG_Byte_Array:
+			nbt_put_byte_array(w, name, n->data.array->data.bytes, n->data.array->len);
+			break;
+		case TAG_Int_Array:
+			nbt_put_int_array(w, name, n->data.array->data.ints, n->data.array->len);
+			break;
+		case TAG_Long_Array:
+			nbt_put_long_array(w, name, n->data.array->data.longs, n->data.array->len);
+			break;
+		case TAG_List:
+			nbt_begin_list(w, name, n->data.list->type, n->data.list->len);
+			for (int32_t i = 0; i < n->data.list->len; ++i)
+				put_node(w, &(n->data.list->items[i]));
+			nbt_end(w);
+			break;
+		case TAG_Compound:
+			nbt_begin_compound(w, name);
+			for (int32_t i = 0; i < n->data.children->len; ++i)
+				put_node(w, &(n->data.children->items[i]));
+			nbt_end(w);
+			break;
+		default:
+			fail(w, "unknown tag");
+			break;
+	}
+}
+
+void nbt_put_tree(struct nbt_writer *w, struct nbt *root) {
+	/* a root that isn't a compound goes in an unnamed one */
+	bool wrap = w->depth == 0 && root->tag != TAG_Compound;
+	if (wrap)
+		nbt_begin_compound(w, NULL);
+	put_node(w, root);
+	if (wrap)
+		nbt_end(w);
+}
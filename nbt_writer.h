@@ -0,0 +1,76 @@
+/* Writes NBT as it goes, straight into a packet or a growable buffer, without
+ * building a tree first. Eg. a heightmap:
+ *
+ *	nbt_begin_compound(w, "");
+ *	nbt_put_long_array(w, "MOTION_BLOCKING", heightmap, len);
+ *	nbt_end(w);
+ *
+ * Names are ignored for list items, which don't have one. Errors stick: once
+ * a write fails, every write after it does nothing and w->err says why.
+ */
+#ifndef CHOWDER_NBT_WRITER_H
+#define CHOWDER_NBT_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nbt.h"
+#include "packet.h"
+
+/* as deep as nbt_unpack() + the readers go, so anything they read can be
+ * written back */
+#define NBT_WRITER_MAX_DEPTH 512
+
+/* an open compound or list */
+struct nbt_writer_level {
+	bool list;
+	/* a list's item type + how many items it still needs */
+	enum tag type;
+	int32_t remaining;
+};
+
+struct nbt_writer {
+	/* where the NBT goes if it isn't NULL, otherwise data */
+	struct packet *packet;
+	size_t len;
+	size_t cap;
+	uint8_t *data;
+
+	int depth;
+	struct nbt_writer_level levels[NBT_WRITER_MAX_DEPTH];
+	/* 0, -1, or one of PACKET_* */
+	int err;
+};
+
+/* writes into the writer's own buffer */
+void nbt_writer_init(struct nbt_writer *);
+/* writes at the end of p, which has to be in PACKET_MODE_WRITE */
+void nbt_writer_init_packet(struct nbt_writer *, struct packet *);
+/* empties the buffer + clears errors, keeping the buffer's memory */
+void nbt_writer_reset(struct nbt_writer *);
+void nbt_writer_free(struct nbt_writer *);
+
+void nbt_begin_compound(struct nbt_writer *, const char *name);
+/* len is how many items will be written before nbt_end() */
+void nbt_begin_list(struct nbt_writer *, const char *name, enum tag type, int32_t len);
+void nbt_end(struct nbt_writer *);
+
+void nbt_put_byte(struct nbt_writer *, const char *name, int8_t);
+void nbt_put_short(struct nbt_writer *, const char *name, int16_t);
+void nbt_put_int(struct nbt_writer *, const char *name, int32_t);
+void nbt_put_long(struct nbt_writer *, const char *name, int64_t);
+void nbt_put_float(struct nbt_writer *, const char *name, float);
+void nbt_put_double(struct nbt_writer *, const char *name, double);
+void nbt_put_string(struct nbt_writer *, const char *name, const char *s, size_t len);
+void nbt_put_byte_array(struct nbt_writer *, const char *name, const int8_t *, int32_t len);
+/* these take host byte order */
+void nbt_put_int_array(struct nbt_writer *, const char *name, const int32_t *, int32_t len);
+void nbt_put_long_array(struct nbt_writer *, const char *name, const int64_t *, int32_t len);
+/* a tag that's already encoded, like the ones nbt_view_raw() returns. it
+ * has to be a whole named tag in a compound, or a payload in a list */
+void nbt_put_raw(struct nbt_writer *, const uint8_t *, size_t len);
+/* writes out a tree, like nbt_pack() */
+void nbt_put_tree(struct nbt_writer *, struct nbt *);
+
+#endif
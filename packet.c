@@ -9,6 +9,7 @@
 #include <endian.h>
 
 #include "packet.h"
+#include "nbt_writer.h"
 
 #define FINISHED_PACKET_ID 255
 
@@ -149,6 +150,14 @@ bool packet_read_long(struct packet *p, uint64_t *l) {
 	return true;
 }
 
+bool packet_read_double(struct packet *p, double *d) {
+	uint64_t l;
+	if (!packet_read_long(p, &l))
+		return false;
+	memcpy(d, &l, sizeof(double));
+	return true;
+}
+
 /* TODO: test w/ negative values if i ever get around to sending chunks w/
  *       negative coordinates xd */
 bool packet_read_position(struct packet *p, int32_t *x, int16_t *y, int32_t *z) {
@@ -319,9 +328,9 @@ int packet_write_long(struct packet *p, uint64_t l) {
 }
 
 int packet_write_nbt(struct packet *p, struct nbt *nbt) {
-	uint8_t *nbt_data;
-	size_t nbt_len = nbt_pack(nbt, &nbt_data);
-	int n = packet_write_bytes(p, nbt_len, nbt_data);
-	free(nbt_data);
-	return n;
+	int start = p->packet_len;
+	struct nbt_writer w;
+	nbt_writer_init_packet(&w, p);
+	nbt_put_tree(&w, nbt);
+	return w.err < 0 ? w.err : p->packet_len - start;
 }
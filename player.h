@@ -2,10 +2,22 @@
 #define CHOWDER_PLAYER_H
 #include <stdint.h>
 
+#include "chunk_sender.h"
+
 struct player {
 	uint8_t uuid[16];
 	char username[17];
 	char *textures;
+
+	double x;
+	double y;
+	double z;
+	/* in chunks, as sent by the client */
+	int view_distance;
+	/* coords of the chunk the player is in */
+	int chunk_x;
+	int chunk_z;
+	struct chunk_sender sender;
 };
 
 void player_free(struct player *);
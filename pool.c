@@ -0,0 +1,358 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define DEQUE_MIN_CAP 64
+#define NSEC_PER_SEC 1000000000
+
+struct job {
+	job_func run;
+	void *arg;
+	struct job_counter *counter;
+};
+
+/* a ring buffer. the owner pushes + pops at the bottom, thieves take from
+ * the top */
+struct deque {
+	pthread_mutex_t lock;
+	size_t head;
+	size_t len;
+	size_t cap;
+	struct job *jobs;
+};
+
+struct worker {
+	struct pool *pool;
+	int index;
+	pthread_t thread;
+	bool running;
+	struct deque deques[JOB_PRIORITIES];
+
+	/* atomic so any thread can read them */
+	_Atomic uint64_t jobs;
+	_Atomic uint64_t steals;
+	_Atomic int64_t busy_ns;
+	int64_t start;
+};
+
+struct pool {
+	int workers_len;
+	struct worker *workers;
+	/* where the next job from outside the pool goes */
+	atomic_uint next_worker;
+
+	/* queued jobs of each priority */
+	atomic_int pending[JOB_PRIORITIES];
+	/* queued + running jobs */
+	atomic_int outstanding;
+
+	pthread_mutex_t lock;
+	/* signalled when jobs are queued or the pool is stopping */
+	pthread_cond_t work;
+	/* broadcast when a counter or outstanding gets to 0 */
+	pthread_cond_t done;
+	atomic_int sleeping;
+	bool stopping;
+};
+
+/* the worker the calling thread is, if it's one */
+static _Thread_local struct worker *self = NULL;
+
+static int64_t now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void deque_init(struct deque *d) {
+	pthread_mutex_init(&(d->lock), NULL);
+	d->head = 0;
+	d->len = 0;
+	d->cap = DEQUE_MIN_CAP;
+	d->jobs = malloc(sizeof(struct job) * d->cap);
+}
+
+static void deque_finish(struct deque *d) {
+	pthread_mutex_destroy(&(d->lock));
+	free(d->jobs);
+}
+
+static void deque_push(struct deque *d, const struct job *j) {
+	pthread_mutex_lock(&(d->lock));
+	if (d->len == d->cap) {
+		/* unwrap the ring into the bigger buffer */
+		struct job *jobs = malloc(sizeof(struct job) * d->cap * 2);
+		for (size_t i = 0; i < d->len; ++i)
+			jobs[i] = d->jobs[(d->head + i) % d->cap];
+		free(d->jobs);
+		d->jobs = jobs;
+		d->head = 0;
+		d->cap *= 2;
+	}
+	d->jobs[(d->head + d->len) % d->cap] = *j;
+	++(d->len);
+	pthread_mutex_unlock(&(d->lock));
+}
+
+static bool deque_pop(struct deque *d, struct job *j) {
+	pthread_mutex_lock(&(d->lock));
+	bool found = d->len > 0;
+	if (found)
+		*j = d->jobs[(d->head + --(d->len)) % d->cap];
+	pthread_mutex_unlock(&(d->lock));
+	return found;
+}
+
+static bool deque_steal(struct deque *d, struct job *j) {
+	pthread_mutex_lock(&(d->lock));
+	bool found = d->len > 0;
+	if (found) {
+		*j = d->jobs[d->head];
+		d->head = (d->head + 1) % d->cap;
+		--(d->len);
+	}
+	pthread_mutex_unlock(&(d->lock));
+	return found;
+}
+
+static void wake_waiters(struct pool *p) {
+	pthread_mutex_lock(&(p->lock));
+	pthread_cond_broadcast(&(p->done));
+	pthread_mutex_unlock(&(p->lock));
+}
+
+static void run_job(struct pool *p, const struct job *j, bool stolen) {
+	int64_t start = self != NULL ? now() : 0;
+	j->run(j->arg);
+	if (self != NULL) {
+		self->busy_ns += now() - start;
+		++(self->jobs);
+		if (stolen)
+			++(self->steals);
+	}
+
+	if (j->counter != NULL) {
+		/* once count is 0 the counter can be gone, so copy these first */
+		job_func then = j->counter->then;
+		void *then_arg = j->counter->then_arg;
+		enum job_priority then_priority = j->counter->then_priority;
+		if (atomic_fetch_sub(&(j->counter->count), 1) == 1) {
+			if (then != NULL)
+				pool_submit_job(p, then_priority, NULL, then, then_arg);
+			wake_waiters(p);
+		}
+	}
+	if (atomic_fetch_sub(&(p->outstanding), 1) == 1)
+		wake_waiters(p);
+}
+
+/* runs one job of at most max_priority, if one can be found anywhere.
+ * returns whether it did */
+static bool run_one(struct pool *p, enum job_priority max_priority) {
+	bool mine = self != NULL && self->pool == p;
+	for (int prio = JOB_HIGH; prio <= (int) max_priority; ++prio) {
+		if (atomic_load(&(p->pending[prio])) == 0)
+			continue;
+		struct job j;
+		if (mine && deque_pop(&(self->deques[prio]), &j)) {
+			--(p->pending[prio]);
+			run_job(p, &j, false);
+			return true;
+		}
+		int start = mine ? self->index + 1 : 0;
+		for (int i = 0; i < p->workers_len; ++i) {
+			struct worker *victim = &(p->workers[(start + i) % p->workers_len]);
+			if (mine && victim == self)
+				continue;
+			if (deque_steal(&(victim->deques[prio]), &j)) {
+				--(p->pending[prio]);
+				run_job(p, &j, true);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool any_pending(struct pool *p) {
+	for (int prio = 0; prio < JOB_PRIORITIES; ++prio) {
+		if (atomic_load(&(p->pending[prio])) > 0)
+			return true;
+	}
+	return false;
+}
+
+static void *pool_worker(void *arg) {
+	self = arg;
+	struct pool *p = self->pool;
+	while (true) {
+		if (run_one(p, JOB_LOW))
+			continue;
+
+		pthread_mutex_lock(&(p->lock));
+		/* submitters check sleeping after queueing, and we check for
+		 * jobs after bumping it, so one of us sees the other */
+		++(p->sleeping);
+		while (!any_pending(p) && !p->stopping)
+			pthread_cond_wait(&(p->work), &(p->lock));
+		--(p->sleeping);
+		bool stop = p->stopping && !any_pending(p);
+		pthread_mutex_unlock(&(p->lock));
+		if (stop)
+			break;
+	}
+	return NULL;
+}
+
+struct pool *pool_new(int threads) {
+	if (threads <= 0) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+		if (threads < 1)
+			threads = 1;
+	}
+
+	struct pool *p = calloc(1, sizeof(struct pool));
+	if (p == NULL) {
+		perror("calloc");
+		return NULL;
+	}
+	pthread_mutex_init(&(p->lock), NULL);
+	pthread_cond_init(&(p->work), NULL);
+	pthread_cond_init(&(p->done), NULL);
+
+	/* every worker's deques exist before any thread can steal from them */
+	p->workers = calloc(threads, sizeof(struct worker));
+	for (int i = 0; i < threads; ++i) {
+		struct worker *w = &(p->workers[i]);
+		w->pool = p;
+		w->index = i;
+		for (int prio = 0; prio < JOB_PRIORITIES; ++prio)
+			deque_init(&(w->deques[prio]));
+	}
+	p->workers_len = threads;
+
+	/* if some threads don't start, jobs dealt out to them still get
+	 * stolen by the ones that did */
+	bool any = false;
+	for (int i = 0; i < threads; ++i) {
+		struct worker *w = &(p->workers[i]);
+		w->start = now();
+		if (pthread_create(&(w->thread), NULL, pool_worker, w) != 0) {
+			perror("pthread_create");
+			break;
+		}
+		w->running = true;
+		any = true;
+	}
+	if (!any) {
+		pool_free(p);
+		return NULL;
+	}
+	return p;
+}
+
+void pool_free(struct pool *p) {
+	if (p == NULL)
+		return;
+	pool_wait(p);
+
+	pthread_mutex_lock(&(p->lock));
+	p->stopping = true;
+	pthread_cond_broadcast(&(p->work));
+	pthread_mutex_unlock(&(p->lock));
+	for (int i = 0; i < p->workers_len; ++i) {
+		if (p->workers[i].running)
+			pthread_join(p->workers[i].thread, NULL);
+		for (int prio = 0; prio < JOB_PRIORITIES; ++prio)
+			deque_finish(&(p->workers[i].deques[prio]));
+	}
+
+	pthread_cond_destroy(&(p->done));
+	pthread_cond_destroy(&(p->work));
+	pthread_mutex_destroy(&(p->lock));
+	free(p->workers);
+	free(p);
+}
+
+void job_counter_init(struct job_counter *c, int count, job_func then, void *arg, enum job_priority priority) {
+	atomic_init(&(c->count), count);
+	c->then = then;
+	c->then_arg = arg;
+	c->then_priority = priority;
+}
+
+void pool_submit(struct pool *p, job_func run, void *arg) {
+	pool_submit_job(p, JOB_LOW, NULL, run, arg);
+}
+
+void pool_submit_job(struct pool *p, enum job_priority priority, struct job_counter *counter, job_func run, void *arg) {
+	struct job j = {run, arg, counter};
+	++(p->outstanding);
+
+	struct worker *w;
+	if (self != NULL && self->pool == p)
+		w = self;
+	else
+		w = &(p->workers[atomic_fetch_add(&(p->next_worker), 1) % p->workers_len]);
+	deque_push(&(w->deques[priority]), &j);
+	++(p->pending[priority]);
+
+	if (atomic_load(&(p->sleeping)) > 0) {
+		pthread_mutex_lock(&(p->lock));
+		pthread_cond_signal(&(p->work));
+		pthread_mutex_unlock(&(p->lock));
+	}
+}
+
+void pool_wait_counter(struct pool *p, struct job_counter *c) {
+	while (atomic_load(&(c->count)) > 0) {
+		if (run_one(p, JOB_HIGH))
+			continue;
+		pthread_mutex_lock(&(p->lock));
+		if (atomic_load(&(c->count)) > 0)
+			pthread_cond_wait(&(p->done), &(p->lock));
+		pthread_mutex_unlock(&(p->lock));
+	}
+}
+
+void pool_wait(struct pool *p) {
+	if (p == NULL)
+		return;
+	while (atomic_load(&(p->outstanding)) > 0) {
+		if (run_one(p, JOB_LOW))
+			continue;
+		pthread_mutex_lock(&(p->lock));
+		if (atomic_load(&(p->outstanding)) > 0)
+			pthread_cond_wait(&(p->done), &(p->lock));
+		pthread_mutex_unlock(&(p->lock));
+	}
+}
+
+int pool_threads(const struct pool *p) {
+	return p->workers_len;
+}
+
+void pool_worker_stats(const struct pool *p, int worker, struct pool_worker_stats *stats) {
+	struct worker *w = &(p->workers[worker]);
+	stats->jobs = w->jobs;
+	stats->steals = w->steals;
+	stats->busy_ns = w->busy_ns;
+	stats->up_ns = now() - w->start;
+}
+
+void pool_report(const struct pool *p, FILE *f) {
+	if (p == NULL)
+		return;
+	for (int i = 0; i < p->workers_len; ++i) {
+		struct pool_worker_stats stats;
+		pool_worker_stats(p, i, &stats);
+		double busy = stats.up_ns > 0 ? 100.0 * stats.busy_ns / stats.up_ns : 0;
+		fprintf(f, "worker %d: %5.1f%% busy, %lu jobs, %lu stolen\n", i, busy,
+				(unsigned long) stats.jobs, (unsigned long) stats.steals);
+	}
+}
@@ -0,0 +1,82 @@
+/* A work-stealing pool of worker threads, shared by everything that wants
+ * work done off the tick thread.
+ *
+ * Every worker has a deque of jobs per priority. A job submitted from a
+ * worker goes on that worker's own deque, where it takes the newest job
+ * first, and jobs from other threads are dealt out round robin. Workers
+ * that run out steal the oldest job off someone else's deque. A low
+ * priority job only starts when there are no high priority ones queued, so
+ * player-visible work never waits behind saving.
+ *
+ * Jobs can be counted down on a job_counter as they finish, which can kick
+ * off another job when it gets to 0 (fan-in), and pool_wait_counter() waits
+ * for one while helping out with the pool's high priority jobs instead of
+ * just sleeping.
+ */
+#ifndef CHOWDER_POOL_H
+#define CHOWDER_POOL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef void (*job_func)(void *arg);
+
+enum job_priority {
+	/* things players are waiting on */
+	JOB_HIGH,
+	/* background work, like saving */
+	JOB_LOW,
+	JOB_PRIORITIES
+};
+
+struct job_counter {
+	/* jobs left to finish */
+	atomic_int count;
+	/* submitted once count gets back to 0, if it isn't NULL */
+	job_func then;
+	void *then_arg;
+	enum job_priority then_priority;
+};
+
+struct pool_worker_stats {
+	uint64_t jobs;
+	/* how many of jobs were taken from other workers */
+	uint64_t steals;
+	/* time spent running jobs, out of the time the worker's been up */
+	int64_t busy_ns;
+	int64_t up_ns;
+};
+
+struct pool;
+
+/* threads <= 0 picks one less than the number of online CPUs (at least 1),
+ * leaving a core for the tick thread. returns NULL if no threads could be
+ * started. users of the pool run their jobs on the calling thread instead
+ * when it's NULL, and pool_free(), pool_wait() + pool_report() do nothing */
+struct pool *pool_new(int threads);
+/* waits for every queued job to finish, then stops + frees the pool */
+void pool_free(struct pool *);
+
+/* count is how many jobs are going to be submitted against the counter, so
+ * it can't reach 0 while they're still being submitted. then can be NULL.
+ * a counter can be initialized again once it's back to 0 */
+void job_counter_init(struct job_counter *, int count, job_func then, void *arg, enum job_priority);
+
+/* a low priority job */
+void pool_submit(struct pool *, job_func, void *arg);
+/* counter can be NULL, otherwise the job counts it down when it's done */
+void pool_submit_job(struct pool *, enum job_priority, struct job_counter *, job_func, void *arg);
+/* blocks until every job submitted against the counter has finished,
+ * running high priority jobs in the meantime */
+void pool_wait_counter(struct pool *, struct job_counter *);
+/* blocks until every job submitted so far has finished, running jobs of
+ * any priority in the meantime */
+void pool_wait(struct pool *);
+
+int pool_threads(const struct pool *);
+void pool_worker_stats(const struct pool *, int worker, struct pool_worker_stats *);
+/* prints a line per worker with its utilization */
+void pool_report(const struct pool *, FILE *);
+
+#endif
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "profiler.h"
+
+#define NSEC_PER_SEC 1000000000
+
+static const char *phase_names[PHASE_COUNT + 1] = {
+	[PHASE_OTHER] = "other",
+	[PHASE_ACCEPT] = "accept",
+	[PHASE_NET_READ] = "net read",
+	[PHASE_PACKETS] = "packets",
+	[PHASE_CHUNKS] = "chunks",
+	[PHASE_NET_WRITE] = "net write",
+	[PHASE_WORLD] = "world",
+	[PHASE_COUNT] = "tick",
+};
+
+static int64_t now() {
+	struct timespec ts;
+	/* only fails for clocks that don't exist */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+struct profiler *profiler_new() {
+	struct profiler *p = calloc(1, sizeof(struct profiler));
+	if (p == NULL) {
+		perror("calloc");
+		return NULL;
+	}
+	p->start = now();
+	p->mark = p->start;
+	p->tick_start = p->start;
+	/* nothing has happened in second or slot 0 yet either */
+	for (int i = 0; i < PROFILER_SLOTS; ++i)
+		p->slot_periods[i] = -1;
+	for (int i = 0; i < PROFILER_HISTORY_SEC; ++i)
+		p->seconds[i].sec = -1;
+	return p;
+}
+
+void profiler_free(struct profiler *p) {
+	free(p);
+}
+
+const char *profiler_phase_name(enum tick_phase phase) {
+	return phase_names[phase];
+}
+
+void profiler_tick_start(struct profiler *p) {
+	p->tick_start = now();
+	p->mark = p->tick_start;
+	p->phase = PHASE_OTHER;
+	for (int i = 0; i < PHASE_COUNT; ++i)
+		p->phase_ns[i] = 0;
+}
+
+void profiler_phase(struct profiler *p, enum tick_phase phase) {
+	int64_t t = now();
+	p->phase_ns[p->phase] += t - p->mark;
+	p->mark = t;
+	p->phase = phase;
+}
+
+void profiler_split(struct profiler *p, const int64_t *weights) {
+	int64_t t = now();
+	int64_t elapsed = t - p->mark;
+	p->mark = t;
+
+	int64_t total = 0;
+	for (int i = 0; i < PHASE_COUNT; ++i)
+		total += weights[i];
+	if (total <= 0) {
+		p->phase_ns[p->phase] += elapsed;
+		return;
+	}
+	/* whatever rounding leaves over goes to the current phase, so the
+	 * phases still add up to the tick */
+	int64_t charged = 0;
+	for (int i = 0; i < PHASE_COUNT; ++i) {
+		int64_t ns = (int64_t) ((double) elapsed * weights[i] / total);
+		p->phase_ns[i] += ns;
+		charged += ns;
+	}
+	p->phase_ns[p->phase] += elapsed - charged;
+}
+
+void phase_timer_start(struct phase_timer *t, enum tick_phase phase) {
+	t->mark = now();
+	t->phase = phase;
+	for (int i = 0; i < PHASE_COUNT; ++i)
+		t->phase_ns[i] = 0;
+}
+
+void phase_timer_phase(struct phase_timer *t, enum tick_phase phase) {
+	int64_t n = now();
+	t->phase_ns[t->phase] += n - t->mark;
+	t->mark = n;
+	t->phase = phase;
+}
+
+void phase_timer_stop(struct phase_timer *t) {
+	phase_timer_phase(t, t->phase);
+}
+
+static uint32_t to_usec(int64_t ns) {
+	int64_t us = ns / 1000;
+	return us < UINT32_MAX ? us : UINT32_MAX;
+}
+
+static void record(struct profiler *p, struct histogram *slot, int i, int64_t ns) {
+	uint32_t us = to_usec(ns);
+	histogram_record(&(slot[i]), us);
+	histogram_record(&(p->total[i]), us);
+}
+
+void profiler_tick_end(struct profiler *p) {
+	profiler_phase(p, PHASE_OTHER);
+	int64_t busy = p->mark - p->tick_start;
+	int64_t sec = (p->mark - p->start) / NSEC_PER_SEC;
+
+	int64_t period = sec / PROFILER_SLOT_SEC;
+	int s = period % PROFILER_SLOTS;
+	if (p->slot_periods[s] != period) {
+		p->slot_periods[s] = period;
+		for (int i = 0; i <= PHASE_COUNT; ++i)
+			histogram_clear(&(p->slots[s][i]));
+	}
+	for (int i = 0; i < PHASE_COUNT; ++i)
+		record(p, p->slots[s], i, p->phase_ns[i]);
+	record(p, p->slots[s], PHASE_COUNT, busy);
+
+	struct profiler_second *second = &(p->seconds[sec % PROFILER_HISTORY_SEC]);
+	if (second->sec != sec)
+		*second = (struct profiler_second) {sec, 0, 0};
+	++(second->ticks);
+	second->busy_ns += busy;
+}
+
+/* adds up the last window_sec full seconds. returns how many seconds that
+ * covers */
+static int64_t sum_seconds(const struct profiler *p, int window_sec, uint64_t *ticks, int64_t *busy_ns) {
+	int64_t cur = (now() - p->start) / NSEC_PER_SEC;
+	if (window_sec > PROFILER_HISTORY_SEC)
+		window_sec = PROFILER_HISTORY_SEC;
+	int64_t from = cur - window_sec > 0 ? cur - window_sec : 0;
+	*ticks = 0;
+	*busy_ns = 0;
+	for (int64_t sec = from; sec < cur; ++sec) {
+		const struct profiler_second *second = &(p->seconds[sec % PROFILER_HISTORY_SEC]);
+		if (second->sec == sec) {
+			*ticks += second->ticks;
+			*busy_ns += second->busy_ns;
+		}
+	}
+	return cur - from;
+}
+
+double profiler_tps(const struct profiler *p, int window_sec) {
+	uint64_t ticks;
+	int64_t busy_ns;
+	int64_t secs = sum_seconds(p, window_sec, &ticks, &busy_ns);
+	return secs > 0 ? (double) ticks / secs : 0;
+}
+
+double profiler_mspt(const struct profiler *p, int window_sec) {
+	uint64_t ticks;
+	int64_t busy_ns;
+	sum_seconds(p, window_sec, &ticks, &busy_ns);
+	return ticks > 0 ? (double) busy_ns / ticks / 1000000 : 0;
+}
+
+void profiler_recent(const struct profiler *p, enum tick_phase phase, struct histogram *h) {
+	int64_t period = (now() - p->start) / NSEC_PER_SEC / PROFILER_SLOT_SEC;
+	histogram_clear(h);
+	for (int s = 0; s < PROFILER_SLOTS; ++s) {
+		/* slots that haven't been written to since the window moved on
+		 * hold a period that's too old */
+		if (p->slot_periods[s] > period - PROFILER_SLOTS)
+			histogram_merge(h, &(p->slots[s][phase]));
+	}
+}
+
+static void report_line(FILE *f, const char *name, const struct histogram *h) {
+	fprintf(f, "  %-10s %8.3f %8.3f %8.3f %8.3f %8.3f\n", name,
+			histogram_mean(h) / 1000,
+			histogram_percentile(h, 50) / 1000.0,
+			histogram_percentile(h, 99) / 1000.0,
+			histogram_percentile(h, 99.9) / 1000.0,
+			h->max / 1000.0);
+}
+
+void profiler_report(const struct profiler *p, FILE *f, bool totals) {
+	fprintf(f, "TPS 5s/1m/5m:  %.2f %.2f %.2f\n",
+			profiler_tps(p, 5), profiler_tps(p, 60), profiler_tps(p, 300));
+	fprintf(f, "MSPT 5s/1m/5m: %.3f %.3f %.3f\n",
+			profiler_mspt(p, 5), profiler_mspt(p, 60), profiler_mspt(p, 300));
+	fprintf(f, "ms per tick, %s:\n", totals ? "since startup" : "last minute");
+	fprintf(f, "  %-10s %8s %8s %8s %8s %8s\n", "phase", "mean", "p50", "p99", "p99.9", "max");
+	struct histogram h;
+	for (int i = 0; i <= PHASE_COUNT; ++i) {
+		if (totals) {
+			report_line(f, phase_names[i], &(p->total[i]));
+		} else {
+			profiler_recent(p, i, &h);
+			report_line(f, phase_names[i], &h);
+		}
+	}
+}
@@ -0,0 +1,110 @@
+/* Times where each tick goes. A tick is split into phases, and the tick
+ * thread says which one it's in with profiler_phase() as it moves between
+ * them, so every nanosecond of a tick is charged to exactly one phase. Work
+ * that runs on several threads at once is timed per thread with a
+ * phase_timer instead, and profiler_split() charges the tick thread's wait
+ * for it to each phase in proportion to the time the threads spent there.
+ *
+ * Per phase (and for whole ticks) it keeps a histogram of the last minute
+ * and one since startup, in microseconds per tick. Tick counts + busy time
+ * are kept per second for the last 5 minutes, for TPS + MSPT averages.
+ *
+ * Only the tick thread may use a profiler, and each phase_timer only one
+ * thread at a time.
+ */
+#ifndef CHOWDER_PROFILER_H
+#define CHOWDER_PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "include/histogram.h"
+
+enum tick_phase {
+	/* time that isn't in any of the others */
+	PHASE_OTHER,
+	/* accepting + logging in new connections */
+	PHASE_ACCEPT,
+	/* polling sockets + reading packets off them */
+	PHASE_NET_READ,
+	/* acting on the packets that were read, + applying the changes to the
+	 * world they queued up */
+	PHASE_PACKETS,
+	/* picking, building + writing chunk packets */
+	PHASE_CHUNKS,
+	/* everything else written to the network, like keep alives */
+	PHASE_NET_WRITE,
+	/* saving, unloading + freeing chunks */
+	PHASE_WORLD,
+	PHASE_COUNT
+};
+
+/* the histograms of the last minute are made of 12 5 second slots */
+#define PROFILER_SLOT_SEC 5
+#define PROFILER_SLOTS 12
+#define PROFILER_HISTORY_SEC 300
+
+struct profiler_second {
+	/* seconds since the profiler was made */
+	int64_t sec;
+	uint32_t ticks;
+	int64_t busy_ns;
+};
+
+struct phase_timer {
+	int64_t mark;
+	enum tick_phase phase;
+	int64_t phase_ns[PHASE_COUNT];
+};
+
+struct profiler {
+	int64_t start;
+	/* when the current phase was entered */
+	int64_t mark;
+	int64_t tick_start;
+	enum tick_phase phase;
+	/* how long each phase has taken in the current tick */
+	int64_t phase_ns[PHASE_COUNT];
+
+	/* index PHASE_COUNT holds whole ticks */
+	int64_t slot_periods[PROFILER_SLOTS];
+	struct histogram slots[PROFILER_SLOTS][PHASE_COUNT + 1];
+	struct histogram total[PHASE_COUNT + 1];
+	struct profiler_second seconds[PROFILER_HISTORY_SEC];
+};
+
+/* returns NULL if it can't be made */
+struct profiler *profiler_new();
+void profiler_free(struct profiler *);
+
+const char *profiler_phase_name(enum tick_phase);
+
+void profiler_tick_start(struct profiler *);
+/* charges the time since the last call to the phase it was in */
+void profiler_phase(struct profiler *, enum tick_phase);
+void profiler_tick_end(struct profiler *);
+/* charges the time since the last call to every phase, in proportion to
+ * weights[PHASE_COUNT] (eg. a phase_timer's phase_ns summed over threads),
+ * or to the current phase if they're all 0. the current phase stays the
+ * same */
+void profiler_split(struct profiler *, const int64_t *weights);
+
+/* zeroes the timer's phase times + starts timing phase */
+void phase_timer_start(struct phase_timer *, enum tick_phase);
+/* charges the time since the last call to the phase it was in */
+void phase_timer_phase(struct phase_timer *, enum tick_phase);
+void phase_timer_stop(struct phase_timer *);
+
+/* averages over the last window_sec full seconds, or since the start if
+ * that's shorter. window_sec can be up to PROFILER_HISTORY_SEC */
+double profiler_tps(const struct profiler *, int window_sec);
+double profiler_mspt(const struct profiler *, int window_sec);
+/* the last minute of a phase, or of whole ticks for PHASE_COUNT */
+void profiler_recent(const struct profiler *, enum tick_phase, struct histogram *);
+
+/* prints TPS, MSPT + a line per phase of the last minute. with totals the
+ * phases are since startup instead */
+void profiler_report(const struct profiler *, FILE *, bool totals);
+
+#endif
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include <openssl/evp.h>
@@ -9,9 +10,10 @@
 #include <zlib.h>
 
 #include "protocol.h"
+#include "blocks.h"
 #include "region.h"
 #include "world.h"
-#include "nbt.h"
+#include "nbt_writer.h"
 
 #define RET_ON_FAIL(packet_write_call) \
 	do { \
@@ -280,6 +282,11 @@ int client_settings(struct conn *c) {
 	if (!packet_read_byte(p, &view_distance))
 		return -1;
 	printf("view distance: %d\n", view_distance);
+	c->player->view_distance = view_distance;
+	if (view_distance < MIN_VIEW_DISTANCE)
+		c->player->view_distance = MIN_VIEW_DISTANCE;
+	else if (view_distance > MAX_VIEW_DISTANCE)
+		c->player->view_distance = MAX_VIEW_DISTANCE;
 
 	int chat_mode;
 	if (packet_read_varint(p, &chat_mode) < 0)
@@ -346,21 +353,81 @@ int spawn_position(struct conn *c, uint16_t x, uint16_t y, uint16_t z) {
 	return conn_write_packet(c);
 }
 
-bool is_air(int blockstate) {
-	/* TODO: don't hardcode these */
-	return blockstate == 0 || blockstate == 9129 || blockstate == 9130;
+/* sections that are all air are left out of chunk data, the client fills
+ * them in itself */
+static bool section_sent(const struct section *s) {
+	if (section_uniform(s))
+		return !block_is_air(s->palette[0]);
+	return s->bits_per_block > 0;
+}
+
+/* the smallest blockstates array the client takes, all palette index 0 */
+static const uint8_t uniform_blockstates[BLOCKSTATES_LEN(MIN_BITS_PER_BLOCK) * sizeof(uint64_t)];
+
+static int write_uniform_section_to_packet(const struct section *s, struct packet *p) {
+	int n = packet_write_short(p, block_is_air(s->palette[0]) ? 0 : TOTAL_BLOCKSTATES);
+	if (n < 0)
+		return n;
+	n = packet_write_byte(p, MIN_BITS_PER_BLOCK);
+	if (n < 0)
+		return n;
+	n = packet_write_varint(p, 1);
+	if (n < 0)
+		return n;
+	n = packet_write_varint(p, s->palette[0]);
+	if (n < 0)
+		return n;
+	n = packet_write_varint(p, BLOCKSTATES_LEN(MIN_BITS_PER_BLOCK));
+	if (n < 0)
+		return n;
+	return packet_write_bytes(p, sizeof(uniform_blockstates), uniform_blockstates);
+}
+
+/* sections whose palette is too big for the client get sent with global ids
+ * instead, + no palette */
+static int write_global_section_to_packet(const struct section *s, struct packet *p) {
+	uint64_t blockstates[BLOCKSTATES_LEN(GLOBAL_BITS_PER_BLOCK)] = {0};
+	for (int i = 0; i < TOTAL_BLOCKSTATES; ++i) {
+		int palette_idx = read_blockstate_at(s, i % 16, i / (16*16), (i / 16) % 16);
+		uint64_t id = palette_idx < s->palette_len ? s->palette[palette_idx] : 0;
+		int bit = i * GLOBAL_BITS_PER_BLOCK;
+		blockstates[bit / 64] |= id << (bit % 64);
+		if (bit % 64 + GLOBAL_BITS_PER_BLOCK > 64)
+			blockstates[bit / 64 + 1] |= id >> (64 - bit % 64);
+	}
+
+	int n = packet_write_byte(p, GLOBAL_BITS_PER_BLOCK);
+	if (n < 0)
+		return n;
+	n = packet_write_varint(p, BLOCKSTATES_LEN(GLOBAL_BITS_PER_BLOCK));
+	if (n < 0)
+		return n;
+	for (size_t i = 0; i < BLOCKSTATES_LEN(GLOBAL_BITS_PER_BLOCK); ++i) {
+		n = packet_write_long(p, blockstates[i]);
+		if (n < 0)
+			return n;
+	}
+	return 0;
 }
 
 int write_section_to_packet(const struct section *s, struct packet *p) {
 	if (s->bits_per_block == -1) {
 		return 0;
 	}
+	if (section_uniform(s)) {
+		int n = write_uniform_section_to_packet(s, p);
+		return n < 0 ? n : 0;
+	}
 
-	/* count non-air blocks */
-	uint16_t block_count = 0;
-	for (int i = 0; i < TOTAL_BLOCKSTATES; ++i) {
+	/* count non-air blocks, which only needs the palette if there's no air
+	 * in it */
+	bool has_air = false;
+	for (int i = 0; i < s->palette_len && !has_air; ++i)
+		has_air = block_is_air(s->palette[i]);
+	uint16_t block_count = has_air ? 0 : TOTAL_BLOCKSTATES;
+	for (int i = 0; has_air && i < TOTAL_BLOCKSTATES; ++i) {
 		int palette_idx = read_blockstate_at(s, i % 16, (i / 16) % 16, i / (16*16));
-		if (!is_air(s->palette[palette_idx])) {
+		if (!block_is_air(s->palette[palette_idx])) {
 			++block_count;
 		}
 	}
@@ -369,6 +436,11 @@ int write_section_to_packet(const struct section *s, struct packet *p) {
 		return n;
 	}
 
+	if (s->bits_per_block > MAX_PALETTE_BITS_PER_BLOCK) {
+		n = write_global_section_to_packet(s, p);
+		return n < 0 ? n : 0;
+	}
+
 	/* palette */
 	const uint8_t bits_per_block = s->bits_per_block;
 	n = packet_write_byte(p, bits_per_block);
@@ -403,6 +475,90 @@ int write_section_to_packet(const struct section *s, struct packet *p) {
 	return 0;
 }
 
+/* interned sections never change, so they're encoded once + the encoding is
+ * reused by every chunk that shares them */
+static int write_interned_section_to_packet(struct section *s, struct packet *p) {
+	struct section_encoding *encoded = atomic_load_explicit(&(s->encoded), memory_order_acquire);
+	if (encoded == NULL) {
+		struct packet buf;
+		packet_init(&buf);
+		buf.packet_mode = PACKET_MODE_WRITE;
+		int n = write_section_to_packet(s, &buf);
+		if (n < 0) {
+			free(buf.data);
+			return n;
+		}
+		encoded = malloc(sizeof(struct section_encoding) + buf.packet_len);
+		encoded->len = buf.packet_len;
+		memcpy(encoded->data, buf.data, buf.packet_len);
+		free(buf.data);
+
+		/* another thread can get there first, in which case its
+		 * encoding is the one everyone uses */
+		struct section_encoding *expected = NULL;
+		if (!atomic_compare_exchange_strong_explicit(&(s->encoded), &expected, encoded,
+				memory_order_acq_rel, memory_order_acquire)) {
+			free(encoded);
+			encoded = expected;
+		}
+	}
+	return packet_write_bytes(p, encoded->len, encoded->data);
+}
+
+#define HEIGHTMAP_BITS 9
+#define HEIGHTMAP_LEN (16*16 * HEIGHTMAP_BITS / 64)
+
+/* one past the highest motion blocking block in each column, 16x16 9 bit
+ * entries (z major) that can run over into the next long */
+static void motion_blocking_heightmap(const struct chunk *chunk, int64_t *heightmap) {
+	uint16_t heights[16*16] = {0};
+	int found = 0;
+	for (int i = chunk->sections_len - 1; i >= 0 && found < 16*16; --i) {
+		const struct section *s = chunk->sections[i];
+		if (s->bits_per_block == -1 || s->y < 0)
+			continue;
+		if (section_uniform(s)) {
+			if (!block_motion_blocking(s->palette[0]))
+				continue;
+			for (int col = 0; col < 16*16; ++col) {
+				if (heights[col] == 0) {
+					heights[col] = s->y*16 + 16;
+					++found;
+				}
+			}
+			continue;
+		}
+
+		/* a palette can't be bigger than the section */
+		bool blocking[TOTAL_BLOCKSTATES];
+		bool any = false;
+		for (int j = 0; j < s->palette_len; ++j) {
+			blocking[j] = block_motion_blocking(s->palette[j]);
+			any |= blocking[j];
+		}
+		if (!any)
+			continue;
+		for (int col = 0; col < 16*16; ++col) {
+			for (int by = 15; heights[col] == 0 && by >= 0; --by) {
+				if (blocking[read_blockstate_at(s, col % 16, by, col / 16)]) {
+					heights[col] = s->y*16 + by + 1;
+					++found;
+				}
+			}
+		}
+	}
+
+	memset(heightmap, 0, sizeof(int64_t) * HEIGHTMAP_LEN);
+	for (int col = 0; col < 16*16; ++col) {
+		uint64_t h = heights[col];
+		int bit = col * HEIGHTMAP_BITS;
+		int offset = bit % 64;
+		((uint64_t *) heightmap)[bit / 64] |= h << offset;
+		if (offset + HEIGHTMAP_BITS > 64)
+			((uint64_t *) heightmap)[bit / 64 + 1] |= h >> (64 - offset);
+	}
+}
+
 int chunk_data(struct conn *c, const struct chunk *chunk, int x, int y, bool full) {
 	struct packet *p = c->packet;
 	make_packet(p, 0x22);
@@ -423,7 +579,7 @@ int chunk_data(struct conn *c, const struct chunk *chunk, int x, int y, bool ful
 	/* primary bit mask */
 	int section_bit_mask = 0;
 	for (int i = 1; i < chunk->sections_len; ++i) {
-		int has_blocks = chunk->sections[i]->bits_per_block > 0;
+		int has_blocks = section_sent(chunk->sections[i]);
 		section_bit_mask |= (has_blocks << (i - 1));
 	}
 	n = packet_write_varint(p, section_bit_mask);
@@ -431,23 +587,21 @@ int chunk_data(struct conn *c, const struct chunk *chunk, int x, int y, bool ful
 		return n;
 	}
 
-	/* TODO: actually calculate heightmaps */
-	struct nbt *nbt = nbt_new(TAG_Long_Array, "MOTION_BLOCKING");
-	struct nbt_array *arr = malloc(sizeof(struct nbt_array));
-	int64_t heightmaps[36] = {0};
-	arr->len = 36;
-	arr->data.longs = heightmaps;
-	nbt->data.array = arr;
-	n = packet_write_nbt(p, nbt);
-	arr->data.longs = NULL;
-	nbt_free(nbt);
-	if (n < 0) {
-		return n;
+	/* the client only needs MOTION_BLOCKING, for rain + snow */
+	int64_t heightmap[HEIGHTMAP_LEN];
+	motion_blocking_heightmap(chunk, heightmap);
+	struct nbt_writer w;
+	nbt_writer_init_packet(&w, p);
+	nbt_begin_compound(&w, "");
+	nbt_put_long_array(&w, "MOTION_BLOCKING", heightmap, HEIGHTMAP_LEN);
+	nbt_end(&w);
+	if (w.err < 0) {
+		return w.err;
 	}
 
-	if (full && chunk->biomes != NULL) {
+	if (full && chunk->biomes.palette_len > 0) {
 		for (int i = 0; i < BIOMES_LEN; ++i) {
-			n = packet_write_int(p, chunk->biomes[i]);
+			n = packet_write_int(p, biome_at(&(chunk->biomes), i));
 			if (n < 0) {
 				return n;
 			}
@@ -466,7 +620,13 @@ int chunk_data(struct conn *c, const struct chunk *chunk, int x, int y, bool ful
 	packet_init(&sections);
 	sections.packet_mode = PACKET_MODE_WRITE;
 	for (int i = 1; i < chunk->sections_len; ++i) {
-		n = write_section_to_packet(chunk->sections[i], &sections);
+		struct section *s = chunk->sections[i];
+		if (!section_sent(s))
+			continue;
+		if (s->interned)
+			n = write_interned_section_to_packet(s, &sections);
+		else
+			n = write_section_to_packet(s, &sections);
 		if (n < 0) {
 			free(sections.data);
 			return n;
@@ -494,6 +654,22 @@ int chunk_data(struct conn *c, const struct chunk *chunk, int x, int y, bool ful
 	return conn_write_packet(c);
 }
 
+int unload_chunk(struct conn *c, int x, int z) {
+	make_packet(c->packet, 0x1E);
+
+	RET_ON_FAIL(packet_write_int(c->packet, x));
+	RET_ON_FAIL(packet_write_int(c->packet, z));
+	return conn_write_packet(c);
+}
+
+int update_view_position(struct conn *c, int x, int z) {
+	make_packet(c->packet, 0x41);
+
+	RET_ON_FAIL(packet_write_varint(c->packet, x));
+	RET_ON_FAIL(packet_write_varint(c->packet, z));
+	return conn_write_packet(c);
+}
+
 static int write_new_player_info(struct packet *p, struct player_info *info) {
 	RET_ON_FAIL(packet_write_string(p, strlen(info->add.username), info->add.username));
 	RET_ON_FAIL(packet_write_varint(p, info->add.properties_len));
@@ -630,7 +806,7 @@ int keep_alive_serverbound(struct packet *p, uint64_t id) {
 	return 0;
 }
 
-int player_block_placement(struct packet *p, struct world *w) {
+int player_block_placement(struct packet *p, int32_t *block_x, int16_t *block_y, int32_t *block_z) {
 	int hand;
 	if (packet_read_varint(p, &hand) < 0)
 		return -1;
@@ -677,14 +853,18 @@ int player_block_placement(struct packet *p, struct world *w) {
 	if (!packet_read_byte(p, &head_in_block))
 		return -1;
 
-	struct chunk *c = world_chunk_at(w, x, z);
-	int i = (y / 16) + 1;
-	if (i < c->sections_len && c->sections[i]->bits_per_block > 0) {
-		printf("INFO: writing blockstate to (%d,%d,%d)\n", x, y, z);
-		/* TODO: track what the player is holding and write that block
-		 *       instead of some random block from the palette */
-		write_blockstate_at(c->sections[i], x, y, z, c->sections[i]->palette_len - 1);
-	}
+	*block_x = x;
+	*block_y = y;
+	*block_z = z;
+	return 0;
+}
 
+int player_position(struct packet *p, double *x, double *y, double *z) {
+	if (!packet_read_double(p, x))
+		return -1;
+	if (!packet_read_double(p, y))
+		return -1;
+	if (!packet_read_double(p, z))
+		return -1;
 	return 0;
 }
@@ -23,6 +23,8 @@ int window_items(struct conn *);
 int held_item_change_clientbound(struct conn *, uint8_t slot);
 int spawn_position(struct conn *, uint16_t, uint16_t, uint16_t);
 int chunk_data(struct conn *, const struct chunk *, int x, int y, bool full);
+int unload_chunk(struct conn *, int x, int z);
+int update_view_position(struct conn *, int x, int z);
 
 enum player_info_action {
 	PLAYER_INFO_ADD_PLAYER,
@@ -61,4 +63,9 @@ int player_position_look(struct conn *, int *teleport_id);
 int teleport_confirm(struct packet *, int server_teleport_id);
 int keep_alive_clientbound(struct conn *c);
 int keep_alive_serverbound(struct packet *p, uint64_t id);
-int player_block_placement(struct packet *, struct world *);
+/* reads where the block is being placed, which is next to the block that
+ * was clicked on */
+int player_block_placement(struct packet *, int32_t *x, int16_t *y, int32_t *z);
+/* reads the x, y, z fields shared by Player Position + Player Position And
+ * Rotation */
+int player_position(struct packet *, double *x, double *y, double *z);
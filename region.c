@@ -1,243 +1,905 @@
 #include <endian.h>
+#include <errno.h>
 
 #include <stdlib.h>
-#include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <arpa/inet.h>
 
 #include "region.h"
 #include "blocks.h"
-#include "nbt.h"
+#include "nbt_reader.h"
+#include "include/intern.h"
 
+#define COMPRESSION_TYPE_GZIP 1
 #define COMPRESSION_TYPE_ZLIB 2
-#define GLOBAL_BITS_PER_BLOCK 14
+#define COMPRESSION_TYPE_NONE 3
+
+#define SECTOR_LEN 4096
+/* smallest size chunk buffers start at, they double from here when needed */
+#define CHUNK_BUF_MIN_LEN (64 * 1024)
+
+/* compressed chunk data gets read into a buffer that belongs to the calling
+ * thread and only ever grows, so loading a whole region doesn't need a
+ * malloc() + free() for every chunk */
+static _Thread_local size_t compressed_buf_len = 0;
+static _Thread_local Bytef *compressed_buf = NULL;
+
+void read_chunk_buffers_free() {
+	free(compressed_buf);
+	compressed_buf = NULL;
+	compressed_buf_len = 0;
+}
+
+/* grows *buf geometrically until it can hold at least `needed` bytes */
+static int grow_buf(Bytef **buf, size_t *buf_len, size_t needed) {
+	if (needed <= *buf_len)
+		return 0;
+
+	size_t new_len = *buf_len < CHUNK_BUF_MIN_LEN ? CHUNK_BUF_MIN_LEN : *buf_len;
+	while (new_len < needed)
+		new_len *= 2;
+
+	Bytef *new_buf = realloc(*buf, new_len);
+	if (new_buf == NULL) {
+		perror("realloc");
+		return -1;
+	}
+	*buf = new_buf;
+	*buf_len = new_len;
+	return 0;
+}
+
+/* inflates zlib or gzip data into *chunk, growing it as the stream needs more
+ * space. returns the exact uncompressed length */
+static ssize_t inflate_chunk(int compression, size_t compressed_len, size_t *chunk_buf_len, Bytef **chunk) {
+	z_stream strm = {0};
+	int window_bits = MAX_WBITS;
+	if (compression == COMPRESSION_TYPE_GZIP)
+		window_bits += 16;
+	if (inflateInit2(&strm, window_bits) != Z_OK) {
+		fprintf(stderr, "inflateInit2: %s\n", strm.msg != NULL ? strm.msg : "unknown error");
+		return -1;
+	}
+
+	strm.next_in = compressed_buf;
+	strm.avail_in = compressed_len;
+	int result = Z_OK;
+	while (result != Z_STREAM_END) {
+		if (strm.total_out == *chunk_buf_len
+				&& grow_buf(chunk, chunk_buf_len, *chunk_buf_len + 1) < 0) {
+			inflateEnd(&strm);
+			return -1;
+		}
+		strm.next_out = *chunk + strm.total_out;
+		strm.avail_out = *chunk_buf_len - strm.total_out;
+
+		result = inflate(&strm, Z_NO_FLUSH);
+		if (result != Z_OK && result != Z_STREAM_END) {
+			fprintf(stderr, "error uncompressing data: %d\n", result);
+			inflateEnd(&strm);
+			return -1;
+		} else if (result == Z_OK && strm.avail_in == 0 && strm.avail_out > 0) {
+			fprintf(stderr, "error uncompressing data: truncated stream\n");
+			inflateEnd(&strm);
+			return -1;
+		}
+	}
+
+	ssize_t uncompressed_len = strm.total_out;
+	inflateEnd(&strm);
+	return uncompressed_len;
+}
 
 ssize_t read_chunk(FILE *f, int x, int z, size_t *chunk_buf_len, Bytef **chunk) {
-	/* read the first chunk offset in the region file */
-	fseek(f, 4 * ((x % 32) + (z % 32) * 32), SEEK_SET);
-	int offset = 0;
-	for (int i = 2; i >= 0; --i)
-		offset += fgetc(f) << (8 * i);
-	offset *= 4096;
-
-	/* read sectors len */
-	uLongf chunk_len = fgetc(f) * 4096;
-	if (chunk_len == 0 && offset == 0)
+	/* read the chunk's location in the region file */
+	uint8_t location[4];
+	fseek(f, 4 * ((x & 31) + (z & 31) * 32), SEEK_SET);
+	if (fread(location, 1, 4, f) != 4) {
+		fprintf(stderr, "error reading chunk location\n");
+		return -1;
+	}
+	long offset = ((location[0] << 16) | (location[1] << 8) | location[2]) * SECTOR_LEN;
+	size_t sectors_len = location[3] * SECTOR_LEN;
+	if (sectors_len == 0 && offset == 0)
 		return 0;
 
-	/* read the first chunk's header */
+	/* read the chunk's header */
+	uint8_t header[5];
 	fseek(f, offset, SEEK_SET);
-	uLongf compressed_len = 0;
-	for (int i = 3; i >= 0; --i)
-		compressed_len += fgetc(f) << (8 * i);
-
-	/* check that compression type matches */
-	assert(fgetc(f) == COMPRESSION_TYPE_ZLIB);
-	
-	/* read the first chunk's compressed data into a buffer */
-	Bytef *compressed_chunk = malloc(sizeof(Bytef) * chunk_len);
-	int n = fread(compressed_chunk, (size_t) sizeof(Bytef), compressed_len, f);
-	if (n == 0) {
+	if (fread(header, 1, 5, f) != 5) {
+		fprintf(stderr, "error reading chunk header\n");
+		return -1;
+	}
+	size_t len = ((uint32_t) header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+	int compression = header[4];
+	if (len == 0 || len > sectors_len) {
+		fprintf(stderr, "invalid chunk length %zu\n", len);
+		return -1;
+	}
+	/* the length includes the compression type byte */
+	size_t compressed_len = len - 1;
+
+	if (compression == COMPRESSION_TYPE_NONE) {
+		if (grow_buf(chunk, chunk_buf_len, compressed_len) < 0)
+			return -1;
+		if (fread(*chunk, 1, compressed_len, f) != compressed_len) {
+			perror("fread");
+			return -1;
+		}
+		return compressed_len;
+	} else if (compression != COMPRESSION_TYPE_GZIP && compression != COMPRESSION_TYPE_ZLIB) {
+		fprintf(stderr, "unknown compression type %d\n", compression);
+		return -1;
+	}
+
+	if (grow_buf(&compressed_buf, &compressed_buf_len, compressed_len) < 0)
+		return -1;
+	if (fread(compressed_buf, 1, compressed_len, f) != compressed_len) {
 		perror("fread");
 		return -1;
 	}
 
-	/* uncompress the chunk data */
-	/* FIXME: this 100 here is just a random number
-	 *        that happened to be big enough to hold the uncompressed data */
-	uLong uncompressed_len = sizeof(Bytef) * chunk_len * 100;
-	if (uncompressed_len > *chunk_buf_len) {
-		*chunk_buf_len = uncompressed_len;
-		*chunk = realloc(*chunk, *chunk_buf_len);
+	return inflate_chunk(compression, compressed_len, chunk_buf_len, chunk);
+}
+
+/* every region file that's currently open */
+static pthread_mutex_t open_files_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct region_file *open_files = NULL;
+
+/* marks sectors [start, start + len) as used or free, growing the map if the
+ * sectors are past the end of the file */
+static void mark_sectors(struct region_file *rf, size_t start, size_t len, bool used) {
+	if (start + len > rf->sectors_len) {
+		rf->sectors = realloc(rf->sectors, sizeof(bool) * (start + len));
+		memset(rf->sectors + rf->sectors_len, 0, sizeof(bool) * (start + len - rf->sectors_len));
+		rf->sectors_len = start + len;
 	}
-	int result = uncompress(*chunk, &uncompressed_len, compressed_chunk, compressed_len);
-	if (result != Z_OK) {
-		fprintf(stderr, "error uncompressing data: %d\n", result);
+	memset(rf->sectors + start, used, sizeof(bool) * len);
+}
+
+/* builds the map of used sectors from the file's chunk locations */
+static int read_sectors(struct region_file *rf) {
+	fseek(rf->f, 0, SEEK_END);
+	long file_len = ftell(rf->f);
+	rf->sectors_len = 0;
+	mark_sectors(rf, 0, (file_len + SECTOR_LEN - 1) / SECTOR_LEN, false);
+	/* the chunk location + timestamp tables */
+	mark_sectors(rf, 0, 2, true);
+
+	uint8_t locations[SECTOR_LEN];
+	fseek(rf->f, 0, SEEK_SET);
+	if (fread(locations, 1, SECTOR_LEN, rf->f) != SECTOR_LEN) {
+		fprintf(stderr, "error reading chunk locations from '%s'\n", rf->path);
 		return -1;
 	}
-	free(compressed_chunk);
+	for (int i = 0; i < SECTOR_LEN; i += 4) {
+		size_t offset = (locations[i] << 16) | (locations[i + 1] << 8) | locations[i + 2];
+		size_t len = locations[i + 3];
+		if (offset >= 2 && len > 0)
+			mark_sectors(rf, offset, len, true);
+	}
+	return 0;
+}
 
-	return uncompressed_len;
+struct region_file *region_file_open(const char *path) {
+	pthread_mutex_lock(&open_files_lock);
+	struct region_file *rf = open_files;
+	while (rf != NULL && strcmp(rf->path, path) != 0)
+		rf = rf->next;
+	if (rf != NULL) {
+		++(rf->refs);
+		pthread_mutex_unlock(&open_files_lock);
+		return rf;
+	}
+
+	bool read_only = false;
+	FILE *f = fopen(path, "r+");
+	if (f == NULL && (errno == EACCES || errno == EROFS || errno == EPERM)) {
+		read_only = true;
+		f = fopen(path, "r");
+	}
+	if (f == NULL) {
+		pthread_mutex_unlock(&open_files_lock);
+		return NULL;
+	}
+	rf = calloc(1, sizeof(struct region_file));
+	rf->read_only = read_only;
+	rf->path = strdup(path);
+	rf->refs = 1;
+	rf->f = f;
+	pthread_mutex_init(&(rf->lock), NULL);
+	if (read_sectors(rf) < 0) {
+		pthread_mutex_destroy(&(rf->lock));
+		fclose(rf->f);
+		free(rf->sectors);
+		free(rf->path);
+		free(rf);
+		pthread_mutex_unlock(&open_files_lock);
+		return NULL;
+	}
+
+	rf->next = open_files;
+	open_files = rf;
+	pthread_mutex_unlock(&open_files_lock);
+	return rf;
+}
+
+void region_file_ref(struct region_file *rf) {
+	pthread_mutex_lock(&open_files_lock);
+	++(rf->refs);
+	pthread_mutex_unlock(&open_files_lock);
 }
 
+void region_file_close(struct region_file *rf) {
+	pthread_mutex_lock(&open_files_lock);
+	if (--(rf->refs) > 0) {
+		pthread_mutex_unlock(&open_files_lock);
+		return;
+	}
+	struct region_file **prev = &open_files;
+	while (*prev != rf)
+		prev = &((*prev)->next);
+	*prev = rf->next;
+	pthread_mutex_unlock(&open_files_lock);
+
+	pthread_mutex_destroy(&(rf->lock));
+	fclose(rf->f);
+	free(rf->sectors);
+	free(rf->path);
+	free(rf);
+}
+
+ssize_t region_file_read_chunk(struct region_file *rf, int x, int z, size_t *chunk_buf_len, Bytef **chunk) {
+	pthread_mutex_lock(&(rf->lock));
+	ssize_t n = read_chunk(rf->f, x, z, chunk_buf_len, chunk);
+	pthread_mutex_unlock(&(rf->lock));
+	return n;
+}
+
+/* finds the first run of `len` free sectors, which might be past the end of
+ * the file */
+static size_t find_free_sectors(struct region_file *rf, size_t len) {
+	size_t run = 0;
+	for (size_t i = 2; i < rf->sectors_len; ++i) {
+		run = rf->sectors[i] ? 0 : run + 1;
+		if (run == len)
+			return i - len + 1;
+	}
+	return rf->sectors_len - run;
+}
+
+static void write_be32(uint8_t *b, uint32_t v) {
+	b[0] = v >> 24;
+	b[1] = v >> 16;
+	b[2] = v >> 8;
+	b[3] = v;
+}
+
+int region_file_write_chunk(struct region_file *rf, int x, int z, const uint8_t *data, size_t len) {
+	/* the chunk header is 4 bytes of length + 1 byte of compression type */
+	size_t sectors_len = (len + 5 + SECTOR_LEN - 1) / SECTOR_LEN;
+	if (sectors_len > 255) {
+		fprintf(stderr, "chunk (%d, %d) is too big to save: %zu bytes\n", x, z, len);
+		return -1;
+	}
+
+	if (rf->read_only) {
+		fprintf(stderr, "can't write chunk (%d, %d), '%s' is read-only\n", x, z, rf->path);
+		return -1;
+	}
+
+	pthread_mutex_lock(&(rf->lock));
+	int i = (x & 31) + (z & 31) * 32;
+	uint8_t location[4];
+	fseek(rf->f, 4 * i, SEEK_SET);
+	if (fread(location, 1, 4, rf->f) != 4) {
+		fprintf(stderr, "error reading chunk location\n");
+		pthread_mutex_unlock(&(rf->lock));
+		return -1;
+	}
+	size_t old_offset = (location[0] << 16) | (location[1] << 8) | location[2];
+	size_t old_len = location[3];
+
+	/* write the new data somewhere else first, so a crash partway through
+	 * leaves the old copy of the chunk intact. its sectors stay marked as
+	 * used until the header points at the new copy */
+	size_t offset = find_free_sectors(rf, sectors_len);
+
+	uint8_t header[5];
+	write_be32(header, len + 1);
+	header[4] = COMPRESSION_TYPE_ZLIB;
+	size_t padding = sectors_len * SECTOR_LEN - len - 5;
+	static const uint8_t zeroes[SECTOR_LEN] = {0};
+
+	int err = fseek(rf->f, offset * SECTOR_LEN, SEEK_SET) < 0
+		|| fwrite(header, 1, 5, rf->f) != 5
+		|| fwrite(data, 1, len, rf->f) != len
+		|| fwrite(zeroes, 1, padding, rf->f) != padding
+		|| fflush(rf->f) != 0;
+	if (!err) {
+		write_be32(location, (offset << 8) | sectors_len);
+		uint8_t timestamp[4];
+		write_be32(timestamp, time(NULL));
+		err = fseek(rf->f, 4 * i, SEEK_SET) < 0
+			|| fwrite(location, 1, 4, rf->f) != 4
+			|| fseek(rf->f, SECTOR_LEN + 4 * i, SEEK_SET) < 0
+			|| fwrite(timestamp, 1, 4, rf->f) != 4
+			|| fflush(rf->f) != 0;
+	}
+
+	if (err) {
+		perror("error writing chunk");
+	} else {
+		if (old_offset >= 2)
+			mark_sectors(rf, old_offset, old_len, false);
+		mark_sectors(rf, offset, sectors_len, true);
+	}
+	pthread_mutex_unlock(&(rf->lock));
+	return err ? -1 : 0;
+}
+
+#define MAX_PALETTE_PROPERTIES 16
+
+/* a palette entry as it's being read, pointing into the chunk's NBT */
+struct palette_property {
+	const char *key;
+	uint16_t key_len;
+	const char *value;
+	uint16_t value_len;
+};
+
+struct palette_entry {
+	const char *name;
+	uint16_t name_len;
+	int properties_len;
+	struct palette_property properties[MAX_PALETTE_PROPERTIES];
+};
+
 /* returns the length of a string w/ a block's name + all of it's properties
  * and values, like "minecraft:water;level=5"
  */
-size_t block_name_and_properties_length(struct nbt *block) {
-	struct nbt *name = nbt_get(block, TAG_String, "Name");
-	/* FIXME: relying on asserts here is kinda lame */
-	assert(name != NULL);
-	size_t name_len = strlen(name->data.string);
-
-	struct nbt *properties = nbt_get(block, TAG_Compound, "Properties");
-	if (properties != NULL) {
-		struct node *l = properties->data.children;
-		while (!list_empty(l)) {
-			struct nbt *property = list_item(l);
-			name_len += strlen(property->name);
-			name_len += strlen(property->data.string);
-			name_len += 2;
-			l = list_next(l);
-		}
+static size_t palette_entry_len(const struct palette_entry *e) {
+	size_t len = e->name_len;
+	for (int i = 0; i < e->properties_len; ++i)
+		len += e->properties[i].key_len + e->properties[i].value_len + 2;
+	return len;
+}
+
+/* the entry's name + properties in the order they're in, '\0' terminated */
+static char *palette_entry_key(const struct palette_entry *e) {
+	char *key = malloc(palette_entry_len(e) + 1);
+	memcpy(key, e->name, e->name_len);
+	char *k = key + e->name_len;
+	for (int i = 0; i < e->properties_len; ++i) {
+		const struct palette_property *p = &(e->properties[i]);
+		*k++ = ';';
+		memcpy(k, p->key, p->key_len);
+		k += p->key_len;
+		*k++ = '=';
+		memcpy(k, p->value, p->value_len);
+		k += p->value_len;
 	}
+	*k = '\0';
+	return key;
+}
 
-	return name_len;
+static int palette_property_cmp(const void *p1, const void *p2) {
+	const struct palette_property *prop1 = p1;
+	const struct palette_property *prop2 = p2;
+	size_t len = prop1->key_len < prop2->key_len ? prop1->key_len : prop2->key_len;
+	int cmp = memcmp(prop1->key, prop2->key, len);
+	return cmp != 0 ? cmp : prop1->key_len - prop2->key_len;
 }
 
-int block_property_cmp(const void *p1, const void *p2) {
-	const struct nbt *prop1 = *(struct nbt **) p1;
-	const struct nbt *prop2 = *(struct nbt **) p2;
+static int palette_entry_to_block_id(const struct palette_entry *e) {
+	/* block IDs are keyed on the properties in alphabetical order */
+	struct palette_entry sorted = *e;
+	if (sorted.properties_len > 1)
+		qsort(sorted.properties, sorted.properties_len, sizeof(struct palette_property), palette_property_cmp);
+	char *name = palette_entry_key(&sorted);
 
-	return strcoll(prop1->name, prop2->name);
+	int id = block_id(name, strlen(name));
+	if (id < 0)
+		fprintf(stderr, "no block id for block '%s'\n", name);
+	free(name);
+	return id < 0 ? 0 : id;
 }
 
-size_t sorted_properties(struct nbt *properties_nbt, struct nbt ***properties) {
-	size_t properties_len = list_len(properties_nbt->data.children);
-	*properties = malloc(sizeof(struct nbt *) * properties_len);
+#define PALETTE_CACHE_MIN_CAP 256
+#define FNV_OFFSET 14695981039346656037u
+#define FNV_PRIME 1099511628211u
 
-	struct node *l = properties_nbt->data.children;
-	size_t i = 0;
-	while (!list_empty(l)) {
-		(*properties)[i] = list_item(l);
-		++i;
-		l = list_next(l);
-	}
+static uint64_t fnv_bytes(uint64_t h, const char *s, size_t len) {
+	for (size_t i = 0; i < len; ++i)
+		h = (h ^ (uint8_t) s[i]) * FNV_PRIME;
+	return h;
+}
+
+static uint64_t fnv_byte(uint64_t h, char c) {
+	return (h ^ (uint8_t) c) * FNV_PRIME;
+}
 
-	if (properties_len > 1) {
-		qsort(*properties, properties_len, sizeof(struct nbt *), block_property_cmp);
+/* hashes a palette entry's name + properties as they are, without building
+ * a string or sorting anything */
+static uint64_t palette_entry_hash(const struct palette_entry *e) {
+	uint64_t h = fnv_bytes(FNV_OFFSET, e->name, e->name_len);
+	for (int i = 0; i < e->properties_len; ++i) {
+		const struct palette_property *p = &(e->properties[i]);
+		h = fnv_byte(h, ';');
+		h = fnv_bytes(h, p->key, p->key_len);
+		h = fnv_byte(h, '=');
+		h = fnv_bytes(h, p->value, p->value_len);
 	}
-	return properties_len;
+	return h;
 }
 
-int palette_entry_to_block_id(struct hashmap *block_table, struct nbt *block) {
-	size_t name_len = block_name_and_properties_length(block);
-	char *name = malloc(sizeof(char) * (name_len + 1));
+/* returns key past prefix, or NULL if key doesn't start with it */
+static const char *skip_prefix(const char *key, const char *prefix, size_t len) {
+	if (key == NULL)
+		return NULL;
+	return strncmp(key, prefix, len) == 0 ? key + len : NULL;
+}
 
-	size_t properties_len = 0;
-	struct nbt **properties = NULL;
-	struct nbt *properties_nbt = nbt_get(block, TAG_Compound, "Properties");
-	if (properties_nbt != NULL) {
-		properties_len = sorted_properties(properties_nbt, &properties);
+static bool palette_entry_matches(const char *key, const struct palette_entry *e) {
+	key = skip_prefix(key, e->name, e->name_len);
+	for (int i = 0; i < e->properties_len; ++i) {
+		const struct palette_property *p = &(e->properties[i]);
+		key = skip_prefix(key, ";", 1);
+		key = skip_prefix(key, p->key, p->key_len);
+		key = skip_prefix(key, "=", 1);
+		key = skip_prefix(key, p->value, p->value_len);
 	}
+	return key != NULL && *key == '\0';
+}
 
-	struct nbt *block_name = nbt_get(block, TAG_String, "Name");
-	assert(block_name != NULL);
-	name[0] = '\0';
-	strcat(name, block_name->data.string);
-	for (size_t i = 0; i < properties_len; ++i) {
-		/* FIXME: name is """guaranteed""" to be big enough,
-		 *        but this is still icky
-		 */
-		strcat(name, ";");
-		strcat(name, properties[i]->name);
-		strcat(name, "=");
-		strcat(name, properties[i]->data.string);
+static void palette_cache_put(struct palette_cache *cache, uint64_t hash, const char *key, uint16_t id) {
+	if ((cache->len + 1) * 2 > cache->cap) {
+		size_t old_cap = cache->cap;
+		struct palette_cache_entry *old = cache->entries;
+		cache->cap = old_cap > 0 ? old_cap * 2 : PALETTE_CACHE_MIN_CAP;
+		cache->entries = calloc(cache->cap, sizeof(struct palette_cache_entry));
+		cache->len = 0;
+		for (size_t i = 0; i < old_cap; ++i) {
+			if (old[i].key != NULL)
+				palette_cache_put(cache, old[i].hash, old[i].key, old[i].id);
+		}
+		free(old);
 	}
 
-	int *id = hashmap_get(block_table, name);
-	free(name);
-	free(properties);
-	if (id == NULL) {
-		fprintf(stderr, "no block id for block '%s'\n", name);
-		return 0;
-	} else {
-		return *id;
+	size_t mask = cache->cap - 1;
+	size_t i = hash & mask;
+	while (cache->entries[i].key != NULL)
+		i = (i + 1) & mask;
+	cache->entries[i] = (struct palette_cache_entry) {hash, key, id};
+	++(cache->len);
+}
+
+static int palette_cache_resolve(struct palette_cache *cache, const struct palette_entry *entry) {
+	uint64_t hash = palette_entry_hash(entry);
+
+	if (cache->cap > 0) {
+		size_t mask = cache->cap - 1;
+		for (size_t i = hash & mask; cache->entries[i].key != NULL; i = (i + 1) & mask) {
+			const struct palette_cache_entry *e = &(cache->entries[i]);
+			if (e->hash == hash && palette_entry_matches(e->key, entry)) {
+				++(cache->hits);
+				return e->id;
+			}
+		}
 	}
+
+	++(cache->misses);
+	int id = palette_entry_to_block_id(entry);
+	/* every thread's cache sees the same few hundred keys */
+	char *key = palette_entry_key(entry);
+	palette_cache_put(cache, hash, intern(key, strlen(key)), id);
+	free(key);
+	return id;
+}
+
+void palette_cache_free(struct palette_cache *cache) {
+	free(cache->entries);
+	*cache = (struct palette_cache) {0};
 }
 
-void build_palette(struct hashmap *block_table, struct section *s, struct nbt_list *palette) {
-	s->palette_len = list_len(palette->head);
+static void palette_init(struct section *s, int32_t len) {
+	if (len <= 0)
+		return;
+	s->palette_len = len;
+	/* saved sections always use their palette, however big it is. the
+	 * global palette is only for sending them (see protocol.c) */
 	s->bits_per_block = (int) ceil(log2(s->palette_len));
-	if (s->bits_per_block < 4)
-		s->bits_per_block = 4;
-	else if (s->bits_per_block > 8)
-		s->bits_per_block = GLOBAL_BITS_PER_BLOCK;
+	if (s->bits_per_block < MIN_BITS_PER_BLOCK)
+		s->bits_per_block = MIN_BITS_PER_BLOCK;
+	s->palette = calloc(s->palette_len, sizeof(uint16_t));
+}
+
+/* the only parts of a chunk's NBT parse_chunk() reads. everything else
+ * (entities, heightmaps, light, ...) is skipped over without looking at it */
+enum chunk_path {
+	PATH_SECTIONS,
+	PATH_SECTION,
+	PATH_SECTION_Y,
+	PATH_PALETTE,
+	PATH_PALETTE_ENTRY,
+	PATH_PALETTE_NAME,
+	PATH_PALETTE_PROPERTY,
+	PATH_BLOCKSTATES,
+	PATH_BIOMES,
+};
+
+static const char *const chunk_paths[] = {
+	[PATH_SECTIONS] = "Level.Sections",
+	[PATH_SECTION] = "Level.Sections[]",
+	[PATH_SECTION_Y] = "Level.Sections[].Y",
+	[PATH_PALETTE] = "Level.Sections[].Palette",
+	[PATH_PALETTE_ENTRY] = "Level.Sections[].Palette[]",
+	[PATH_PALETTE_NAME] = "Level.Sections[].Palette[].Name",
+	[PATH_PALETTE_PROPERTY] = "Level.Sections[].Palette[].Properties.*",
+	[PATH_BLOCKSTATES] = "Level.Sections[].BlockStates",
+	[PATH_BIOMES] = "Level.Biomes",
+};
+
+struct chunk_reader {
+	struct chunk *c;
+	struct palette_cache *palettes;
+	bool has_sections;
+	/* the section being read, NULL between sections + past the 16th */
+	struct section *s;
+	int32_t blockstates_len;
+	struct palette_entry entry;
+};
+
+static int read_palette_entry(struct chunk_reader *r, const struct nbt_event *e) {
+	switch (e->type) {
+		case NBT_EVENT_BEGIN:
+			r->entry.name = NULL;
+			r->entry.properties_len = 0;
+			return 0;
+		case NBT_EVENT_END:
+			break;
+		default:
+			return 0;
+	}
 
-	s->palette = malloc(sizeof(int) * s->palette_len);
-	struct node *l = palette->head;
-	int i = 0;
-	while (!list_empty(l)) {
-		s->palette[i] = palette_entry_to_block_id(block_table, list_item(l));
-		++i;
-		l = list_next(l);
+	if (r->s == NULL || e->index >= r->s->palette_len)
+		return 0;
+	if (r->entry.name == NULL) {
+		fprintf(stderr, "palette entry %d has no name\n", e->index);
+		return -1;
 	}
+	if (r->palettes != NULL)
+		r->s->palette[e->index] = palette_cache_resolve(r->palettes, &(r->entry));
+	else
+		r->s->palette[e->index] = palette_entry_to_block_id(&(r->entry));
+	return 0;
 }
 
-struct chunk *parse_chunk(struct hashmap *block_table, size_t chunk_data_len, uint8_t *chunk_data) {
-	struct chunk *c = malloc(sizeof(struct chunk));
+static int read_chunk_event(void *ctx, int path, const struct nbt_event *e) {
+	struct chunk_reader *r = ctx;
+	struct chunk *c = r->c;
+	struct section *s = r->s;
+
+	switch (path) {
+		case PATH_SECTIONS:
+			r->has_sections |= e->tag == TAG_List;
+			break;
+		case PATH_SECTION:
+			if (e->tag != TAG_Compound)
+				break;
+			if (e->type == NBT_EVENT_BEGIN && c->sections_len < 16) {
+				r->s = section_new();
+				r->s->bits_per_block = -1;
+				r->s->palette_len = -1;
+				r->blockstates_len = 0;
+			} else if (e->type == NBT_EVENT_END && s != NULL) {
+				/* everything past here trusts the array to fit the palette */
+				if (s->blockstates != NULL && (s->bits_per_block <= 0
+							|| r->blockstates_len != BLOCKSTATES_LEN(s->bits_per_block))) {
+					fprintf(stderr, "section %d has %d longs of block states for %d bits per block\n",
+							s->y, r->blockstates_len, s->bits_per_block);
+					return -1;
+				}
+				section_compact(s);
+				c->sections[c->sections_len++] = section_intern(s);
+				r->s = NULL;
+			}
+			break;
+		case PATH_SECTION_Y:
+			if (s != NULL && e->tag == TAG_Byte)
+				s->y = e->value.integer;
+			break;
+		case PATH_PALETTE:
+			if (s != NULL && e->tag == TAG_List && e->type == NBT_EVENT_BEGIN && s->palette == NULL)
+				palette_init(s, e->value.array.len);
+			break;
+		case PATH_PALETTE_ENTRY:
+			if (e->tag == TAG_Compound)
+				return read_palette_entry(r, e);
+			break;
+		case PATH_PALETTE_NAME:
+			if (e->tag == TAG_String) {
+				r->entry.name = e->value.string.s;
+				r->entry.name_len = e->value.string.len;
+			}
+			break;
+		case PATH_PALETTE_PROPERTY:
+			if (e->tag == TAG_String && r->entry.properties_len < MAX_PALETTE_PROPERTIES) {
+				struct palette_property *p = &(r->entry.properties[r->entry.properties_len++]);
+				p->key = e->name;
+				p->key_len = e->name_len;
+				p->value = e->value.string.s;
+				p->value_len = e->value.string.len;
+			}
+			break;
+		case PATH_BLOCKSTATES:
+			if (s != NULL && e->tag == TAG_Long_Array && s->blockstates == NULL) {
+				r->blockstates_len = e->value.array.len;
+				s->blockstates = malloc(sizeof(uint64_t) * e->value.array.len);
+				nbt_event_longs(e, (int64_t *) s->blockstates);
+			}
+			break;
+		case PATH_BIOMES:
+			if (e->tag == TAG_Int_Array && c->biomes.palette == NULL) {
+				if (e->value.array.len != BIOMES_LEN) {
+					fprintf(stderr, "chunk has %d biomes instead of %d\n", e->value.array.len, BIOMES_LEN);
+					return -1;
+				}
+				int32_t ids[BIOMES_LEN];
+				nbt_event_ints(e, ids);
+				biomes_pack(&(c->biomes), ids);
+			}
+			break;
+	}
+	return 0;
+}
 
-	struct nbt *n = nbt_unpack(chunk_data_len, chunk_data);
-	if (n == NULL) {
-		fprintf(stderr, "fuck\n");
+struct chunk *parse_chunk(size_t chunk_data_len, uint8_t *chunk_data, struct palette_cache *palettes) {
+	struct chunk_reader r = {0};
+	r.c = calloc(1, sizeof(struct chunk));
+	r.palettes = palettes;
+
+	int paths_len = sizeof(chunk_paths) / sizeof(chunk_paths[0]);
+	if (nbt_read_paths(chunk_data_len, chunk_data, chunk_paths, paths_len, read_chunk_event, &r) < 0) {
+		fprintf(stderr, "error reading chunk NBT\n");
+		/* a section that was cut off partway through */
+		if (r.s != NULL)
+			section_unref(r.s);
+		free_chunk(r.c);
 		return NULL;
 	}
-	struct nbt *level = nbt_get(n, TAG_Compound, "Level");
-	assert(level != NULL);
-	struct nbt *sections = nbt_get(level, TAG_List, "Sections");
-	if (sections == NULL) {
+	if (!r.has_sections) {
 		fprintf(stderr, "couldn't find sections, aborting\n");
+		free_chunk(r.c);
 		return NULL;
 	}
+	return r.c;
+}
 
-	struct node *l = sections->data.list->head;
-	c->sections_len = 0;
-	while (!list_empty(l)) {
-		struct nbt *s_nbt = list_item(l);
-		struct section *s = calloc(1, sizeof(struct section));
-
-		struct nbt *y_index = nbt_get(s_nbt, TAG_Byte, "Y");
-		if (y_index != NULL) {
-			s->y = y_index->data.t_byte;
-		}
+void biomes_pack(struct biomes *b, const int32_t *ids) {
+	uint16_t palette[BIOMES_LEN];
+	uint16_t index[BIOMES_LEN];
+	int palette_len = 0;
+	/* there are usually only a handful of biomes, so a linear search of the
+	 * palette beats anything cleverer */
+	for (int i = 0; i < BIOMES_LEN; ++i) {
+		int j = 0;
+		while (j < palette_len && palette[j] != ids[i])
+			++j;
+		if (j == palette_len)
+			palette[palette_len++] = ids[i];
+		index[i] = j;
+	}
 
-		struct nbt *palette = nbt_get(s_nbt, TAG_List, "Palette");
-		s->bits_per_block = -1;
-		s->palette_len = -1;
-		if (palette != NULL) {
-			build_palette(block_table, s, palette->data.list);
-		}
+	b->palette_len = palette_len;
+	b->palette = malloc(sizeof(uint16_t) * palette_len);
+	memcpy(b->palette, palette, sizeof(uint16_t) * palette_len);
+	b->bits_per_biome = 0;
+	b->indices = NULL;
+	if (palette_len == 1)
+		return;
+
+	b->bits_per_biome = 1;
+	while ((1 << b->bits_per_biome) < palette_len)
+		b->bits_per_biome *= 2;
+	b->indices = calloc(BIOME_INDICES_LEN(b->bits_per_biome), sizeof(uint64_t));
+	int per_long = 64 / b->bits_per_biome;
+	for (int i = 0; i < BIOMES_LEN; ++i)
+		b->indices[i / per_long] |= (uint64_t) index[i] << ((i % per_long) * b->bits_per_biome);
+}
 
-		struct nbt *blockstates = nbt_get(s_nbt, TAG_Long_Array, "BlockStates");
-		if (blockstates != NULL) {
-			s->blockstates = (uint64_t *) blockstates->data.array->data.longs;
-			blockstates->data.array->data.longs = NULL;
-		}
+int biome_at(const struct biomes *b, int i) {
+	if (b->palette_len == 0)
+		return -1;
+	if (b->indices == NULL)
+		return b->palette[0];
+	int per_long = 64 / b->bits_per_biome;
+	uint64_t mask = (1ULL << b->bits_per_biome) - 1;
+	return b->palette[(b->indices[i / per_long] >> ((i % per_long) * b->bits_per_biome)) & mask];
+}
 
-		c->sections[c->sections_len] = s;
-		++(c->sections_len);
-		l = list_next(l);
-	}
+void free_biomes(struct biomes *b) {
+	free(b->palette);
+	free(b->indices);
+	b->palette = NULL;
+	b->indices = NULL;
+	b->palette_len = 0;
+}
 
-	c->biomes = NULL;
-	struct nbt *biomes = nbt_get(level, TAG_Int_Array, "Biomes");
-	if (biomes != NULL) {
-		assert(biomes->data.array->len == BIOMES_LEN);
-		c->biomes = biomes->data.array->data.ints;
-		biomes->data.array->data.ints = NULL;
-	}
+static size_t section_mem(const struct section *s) {
+	size_t mem = sizeof(struct section);
+	if (s->palette_len > 0)
+		mem += s->palette_len * sizeof(uint16_t);
+	if (s->blockstates != NULL && s->bits_per_block > 0)
+		mem += BLOCKSTATES_LEN(s->bits_per_block) * sizeof(uint64_t);
+	struct section_encoding *encoded = atomic_load_explicit(&(s->encoded), memory_order_acquire);
+	if (encoded != NULL)
+		mem += encoded->len;
+	/* shared sections are split between everyone sharing them */
+	int refs = atomic_load_explicit(&(s->refs), memory_order_relaxed);
+	return refs > 1 ? mem / refs : mem;
+}
 
-	nbt_free(n);
-	return c;
+size_t chunk_mem(struct chunk *c) {
+	c->mem = sizeof(struct chunk);
+	for (int i = 0; i < c->sections_len; ++i)
+		c->mem += section_mem(c->sections[i]);
+	c->mem += c->biomes.palette_len * sizeof(uint16_t);
+	c->mem += BIOME_INDICES_LEN(c->biomes.bits_per_biome) * sizeof(uint64_t);
+	return c->mem;
 }
 
-void free_section(struct section *s) {
-	free(s->palette);
-	free(s->blockstates);
-	free(s);
+struct section *chunk_section_mut(struct chunk *c, int i) {
+	struct section *s = c->sections[i];
+	/* only the tick thread hands out new references, so if it holds the
+	 * only one nobody else can start reading the section */
+	if (s->interned || atomic_load_explicit(&(s->refs), memory_order_acquire) > 1) {
+		c->sections[i] = section_clone(s);
+		section_unref(s);
+	}
+	return c->sections[i];
 }
 
 void free_chunk(struct chunk *c) {
 	for (int i = 0; i < c->sections_len; ++i)
-		free_section(c->sections[i]);
-	free(c->biomes);
+		section_unref(c->sections[i]);
+	free_biomes(&(c->biomes));
 	free(c);
 }
 
+/* flat, native-endian layout of a frozen chunk. sizes are worked out first so
+ * the whole thing is written into one buffer */
+static size_t frozen_chunk_len(const struct chunk *c) {
+	size_t len = sizeof(int) * 3;
+	len += c->biomes.palette_len * sizeof(uint16_t);
+	len += BIOME_INDICES_LEN(c->biomes.bits_per_biome) * sizeof(uint64_t);
+	for (int i = 0; i < c->sections_len; ++i) {
+		const struct section *s = c->sections[i];
+		len += sizeof(int8_t) + sizeof(int) * 2 + sizeof(uint8_t);
+		if (s->palette_len > 0)
+			len += s->palette_len * sizeof(uint16_t);
+		if (s->blockstates != NULL)
+			len += BLOCKSTATES_LEN(s->bits_per_block) * sizeof(uint64_t);
+	}
+	return len;
+}
+
+static uint8_t *put(uint8_t *b, const void *data, size_t len) {
+	if (len > 0)
+		memcpy(b, data, len);
+	return b + len;
+}
+
+static const uint8_t *get(const uint8_t *b, void *data, size_t len) {
+	memcpy(data, b, len);
+	return b + len;
+}
+
+struct cold_chunk *chunk_freeze(const struct chunk *c) {
+	size_t raw_len = frozen_chunk_len(c);
+	uint8_t *raw = malloc(raw_len);
+	uint8_t *b = raw;
+	b = put(b, &(c->sections_len), sizeof(int));
+	b = put(b, &(c->biomes.palette_len), sizeof(int));
+	b = put(b, &(c->biomes.bits_per_biome), sizeof(int));
+	b = put(b, c->biomes.palette, c->biomes.palette_len * sizeof(uint16_t));
+	b = put(b, c->biomes.indices, BIOME_INDICES_LEN(c->biomes.bits_per_biome) * sizeof(uint64_t));
+	for (int i = 0; i < c->sections_len; ++i) {
+		const struct section *s = c->sections[i];
+		b = put(b, &(s->y), sizeof(int8_t));
+		b = put(b, &(s->palette_len), sizeof(int));
+		b = put(b, &(s->bits_per_block), sizeof(int));
+		uint8_t has_blockstates = s->blockstates != NULL;
+		b = put(b, &has_blockstates, sizeof(uint8_t));
+		if (s->palette_len > 0)
+			b = put(b, s->palette, s->palette_len * sizeof(uint16_t));
+		if (s->blockstates != NULL)
+			b = put(b, s->blockstates, BLOCKSTATES_LEN(s->bits_per_block) * sizeof(uint64_t));
+	}
+
+	uLongf len = compressBound(raw_len);
+	uint8_t *data = malloc(len);
+	int err = compress2(data, &len, raw, raw_len, Z_BEST_SPEED);
+	free(raw);
+	if (err != Z_OK) {
+		fprintf(stderr, "error freezing chunk (%d, %d): %d\n", c->x, c->z, err);
+		free(data);
+		return NULL;
+	}
+
+	struct cold_chunk *cc = calloc(1, sizeof(struct cold_chunk));
+	cc->x = c->x;
+	cc->z = c->z;
+	cc->len = len;
+	cc->raw_len = raw_len;
+	cc->data = realloc(data, len);
+	return cc;
+}
+
+struct chunk *chunk_thaw(const struct cold_chunk *cc) {
+	uint8_t *raw = malloc(cc->raw_len);
+	uLongf raw_len = cc->raw_len;
+	int err = uncompress(raw, &raw_len, cc->data, cc->len);
+	if (err != Z_OK || raw_len != cc->raw_len) {
+		fprintf(stderr, "error thawing chunk (%d, %d): %d\n", cc->x, cc->z, err);
+		free(raw);
+		return NULL;
+	}
+
+	struct chunk *c = calloc(1, sizeof(struct chunk));
+	const uint8_t *b = raw;
+	b = get(b, &(c->sections_len), sizeof(int));
+	b = get(b, &(c->biomes.palette_len), sizeof(int));
+	b = get(b, &(c->biomes.bits_per_biome), sizeof(int));
+	if (c->biomes.palette_len > 0) {
+		c->biomes.palette = malloc(c->biomes.palette_len * sizeof(uint16_t));
+		b = get(b, c->biomes.palette, c->biomes.palette_len * sizeof(uint16_t));
+	}
+	if (c->biomes.bits_per_biome > 0) {
+		size_t len = BIOME_INDICES_LEN(c->biomes.bits_per_biome) * sizeof(uint64_t);
+		c->biomes.indices = malloc(len);
+		b = get(b, c->biomes.indices, len);
+	}
+	for (int i = 0; i < c->sections_len; ++i) {
+		struct section *s = section_new();
+		b = get(b, &(s->y), sizeof(int8_t));
+		b = get(b, &(s->palette_len), sizeof(int));
+		b = get(b, &(s->bits_per_block), sizeof(int));
+		uint8_t has_blockstates;
+		b = get(b, &has_blockstates, sizeof(uint8_t));
+		if (s->palette_len > 0) {
+			s->palette = malloc(s->palette_len * sizeof(uint16_t));
+			b = get(b, s->palette, s->palette_len * sizeof(uint16_t));
+		}
+		if (has_blockstates) {
+			size_t len = BLOCKSTATES_LEN(s->bits_per_block) * sizeof(uint64_t);
+			s->blockstates = malloc(len);
+			b = get(b, s->blockstates, len);
+		}
+		c->sections[i] = section_intern(s);
+	}
+
+	free(raw);
+	return c;
+}
+
+void free_cold_chunk(struct cold_chunk *cc) {
+	free(cc->data);
+	free(cc);
+}
+
 /* FIXME: misleading name, frees region data but not the struct itself. idk */
 void free_region(struct region *r) {
-	for (int z = 0; z < 32; ++z)
-		for (int x = 0; x < 32; ++x)
+	for (int z = 0; z < 32; ++z) {
+		for (int x = 0; x < 32; ++x) {
 			if (r->chunks[z][x] != NULL)
 				free_chunk(r->chunks[z][x]);
+			if (r->cold[z][x] != NULL)
+				free_cold_chunk(r->cold[z][x]);
+		}
+	}
+	if (r->file != NULL)
+		region_file_close(r->file);
 }
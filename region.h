@@ -2,28 +2,166 @@
 #define CHOWDER_REGION_H
 
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include <zlib.h>
 
 #include "section.h"
-#include "include/hashmap.h"
 
 #define BIOMES_LEN 1024
+#define BIOME_INDICES_LEN(bits_per_biome) (BIOMES_LEN * (bits_per_biome) / 64)
+
+/* A chunk's biomes, one for every 4x4x4 cell, stored as a palette of the
+ * biome IDs that show up + packed indices into it. Chunks with only one
+ * biome have no indices, and chunks without biomes have an empty palette.
+ * bits_per_biome is always a power of 2, so no index straddles two longs. */
+struct biomes {
+	int palette_len;
+	uint16_t *palette;
+	int bits_per_biome;
+	uint64_t *indices;
+};
 
 struct chunk {
+	/* chunk coords */
+	int x;
+	int z;
 	int sections_len;
 	struct section *sections[16];
-	int *biomes;
+	struct biomes biomes;
+
+	/* used by the world to decide when the chunk can be unloaded */
+	/* # of players that can see the chunk */
+	int tickets;
+	/* bit i is set when sections[i] has changed since it was last saved */
+	uint16_t dirty_sections;
+	/* index in the world's list of dirty chunks, if dirty_sections != 0 */
+	size_t dirty_index;
+	/* approximate # of bytes the chunk takes up, see chunk_mem() */
+	size_t mem;
+	/* links in the world's LRU list of unpinned chunks */
+	struct chunk *lru_prev;
+	struct chunk *lru_next;
+};
+
+/* An open .mca file. There's only ever one per path (see region_file_open()),
+ * so reads + writes from different threads all go through the same lock. */
+struct region_file {
+	char *path;
+	/* protected by the lock on the list of open files */
+	int refs;
+	struct region_file *next;
+
+	pthread_mutex_t lock;
+	FILE *f;
+	/* opened for reading only, eg. because it's on read-only storage, so
+	 * chunks can't be saved to it */
+	bool read_only;
+	/* whether each 4 KiB sector of the file is in use */
+	size_t sectors_len;
+	bool *sectors;
+
+	/* chunks waiting to be written, see save.c. protected by lock */
+	struct chunk_save *saves;
+	struct chunk_save *saves_tail;
+	bool saving;
+};
+
+/* A chunk that's been unloaded but kept in memory, as a flat copy of its
+ * sections + biomes compressed with zlib's fastest level. Restoring one is
+ * a lot cheaper than reading + parsing its NBT from the region file again. */
+struct cold_chunk {
+	int x;
+	int z;
+	/* compressed + uncompressed lengths of data */
+	size_t len;
+	size_t raw_len;
+	uint8_t *data;
+	/* links in the world's LRU list of cold chunks */
+	struct cold_chunk *lru_prev;
+	struct cold_chunk *lru_next;
 };
 
 struct region {
 	int x;
 	int z;
-	struct chunk *chunks[32][32];
+	/* the region's .mca file, or NULL if it hasn't been opened */
+	struct region_file *file;
+	/* # of chunks currently loaded */
+	int chunks_len;
+	/* atomic so other threads can read chunks while the tick thread swaps them */
+	_Atomic(struct chunk *) chunks[32][32];
+	/* unloaded chunks still in memory. only used by the tick thread */
+	int cold_len;
+	struct cold_chunk *cold[32][32];
+};
+
+/* reads + decompresses the chunk at x,z into *chunk, growing it if needed.
+ * returns the uncompressed length, 0 if there's no chunk there, or -1 */
+ssize_t read_chunk(FILE *f, int x, int z, size_t *chunk_buf_len, Bytef **chunk);
+/* frees the calling thread's scratch buffer used by read_chunk() */
+void read_chunk_buffers_free();
+
+struct palette_cache_entry {
+	uint64_t hash;
+	/* "name;property=value;..." with properties in the order they were
+	 * stored in, interned. NULL if the slot is free */
+	const char *key;
+	uint16_t id;
 };
 
-ssize_t read_chunk(FILE *f, int x, int y, size_t *chunk_buf_len, Bytef **chunk);
-struct chunk *parse_chunk(struct hashmap *block_table, size_t len, uint8_t *chunk_data);
+/* Block state IDs for the palette entries parse_chunk() has seen before,
+ * keyed on a hash of the entry's NBT. A region only uses a few hundred
+ * distinct blocks, so almost every entry after the first few chunks is one
+ * hash + compare instead of building, sorting + looking up its key. Meant
+ * to be shared by every chunk one thread loads */
+struct palette_cache {
+	size_t cap;
+	size_t len;
+	struct palette_cache_entry *entries;
+	/* metrics */
+	size_t hits;
+	size_t misses;
+};
+
+void palette_cache_free(struct palette_cache *);
+/* palettes can be NULL, which resolves every palette entry from scratch */
+struct chunk *parse_chunk(size_t len, uint8_t *chunk_data, struct palette_cache *palettes);
+/* opens the region file at path for reading + writing (or just reading, if
+ * it can't be written to), or returns the one that's already open. returns
+ * NULL if it doesn't exist */
+struct region_file *region_file_open(const char *path);
+void region_file_ref(struct region_file *);
+/* drops a reference, closing the file when it was the last one */
+void region_file_close(struct region_file *);
+/* read_chunk(), but safe to call while other threads use the file */
+ssize_t region_file_read_chunk(struct region_file *, int x, int z, size_t *chunk_buf_len, Bytef **chunk);
+/* writes zlib compressed chunk data into free sectors and points the header
+ * at it, so the old data stays intact until the new data is on disk */
+int region_file_write_chunk(struct region_file *, int x, int z, const uint8_t *data, size_t len);
+
+/* returns c->sections[i], first cloning it if anything else (like a queued
+ * save) holds a reference to it. call it before every write to a section's
+ * blocks */
+struct section *chunk_section_mut(struct chunk *c, int i);
+
+/* packs BIOMES_LEN biome IDs into b */
+void biomes_pack(struct biomes *b, const int32_t *ids);
+/* the biome ID of cell i, or -1 if there are no biomes */
+int biome_at(const struct biomes *b, int i);
+void free_biomes(struct biomes *b);
+
+/* compresses c's blocks + biomes into a new cold chunk, or returns NULL */
+struct cold_chunk *chunk_freeze(const struct chunk *c);
+/* rebuilds the chunk from a cold chunk, or returns NULL */
+struct chunk *chunk_thaw(const struct cold_chunk *cc);
+void free_cold_chunk(struct cold_chunk *);
+
+/* recalculates + returns c->mem */
+size_t chunk_mem(struct chunk *c);
 void free_chunk(struct chunk *);
 void free_region(struct region *);
 
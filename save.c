@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "save.h"
+#include "blocks.h"
+
+/* a uniform section's blockstates, which the game still wants */
+static const int64_t uniform_blockstates[BLOCKSTATES_LEN(MIN_BITS_PER_BLOCK)];
+
+/* writes a palette entry built from a block's name, like
+ * "minecraft:water;level=5" */
+static void put_palette_entry(struct nbt_writer *w, int id) {
+	if (id < 0 || (size_t) id >= block_names_len || block_names[id] == NULL) {
+		fprintf(stderr, "no block name for block id %d\n", id);
+		id = 0;
+	}
+	char *name = strdup(block_names[id]);
+
+	char *properties = strchr(name, ';');
+	if (properties != NULL)
+		*(properties++) = '\0';
+	nbt_begin_compound(w, NULL);
+	nbt_put_string(w, "Name", name, strlen(name));
+
+	if (properties != NULL) {
+		nbt_begin_compound(w, "Properties");
+		char *saveptr;
+		char *property = strtok_r(properties, ";", &saveptr);
+		while (property != NULL) {
+			char *value = strchr(property, '=');
+			if (value != NULL) {
+				*(value++) = '\0';
+				nbt_put_string(w, property, value, strlen(value));
+			}
+			property = strtok_r(NULL, ";", &saveptr);
+		}
+		nbt_end(w);
+	}
+
+	nbt_end(w);
+	free(name);
+}
+
+static void put_section_blocks(struct nbt_writer *w, const struct section *s) {
+	nbt_begin_list(w, "Palette", TAG_Compound, s->palette_len);
+	for (int i = 0; i < s->palette_len; ++i)
+		put_palette_entry(w, s->palette[i]);
+	nbt_end(w);
+
+	if (section_uniform(s))
+		nbt_put_long_array(w, "BlockStates", uniform_blockstates, BLOCKSTATES_LEN(MIN_BITS_PER_BLOCK));
+	else
+		nbt_put_long_array(w, "BlockStates", (const int64_t *) s->blockstates, BLOCKSTATES_LEN(s->bits_per_block));
+}
+
+static void copy_tag(struct nbt_writer *w, const struct nbt_view *v, int t) {
+	size_t len;
+	const uint8_t *raw = nbt_view_raw(v, t, &len);
+	nbt_put_raw(w, raw, len);
+}
+
+/* the changed section with the same Y as section tag t, or NULL */
+static const struct section *changed_section(const struct nbt_view *v, int t, int sections_len, struct section **sections) {
+	int y = nbt_view_get(v, t, TAG_Byte, "Y");
+	if (y < 0)
+		return NULL;
+	for (int i = 0; i < sections_len; ++i) {
+		if (sections[i]->bits_per_block >= 0 && sections[i]->y == nbt_view_integer(v, y))
+			return sections[i];
+	}
+	return NULL;
+}
+
+static void put_sections(struct nbt_writer *w, const struct nbt_view *v, int t, int sections_len, struct section **sections) {
+	nbt_begin_list(w, "Sections", nbt_view_list_type(v, t), nbt_view_len(v, t));
+	for (int item = nbt_view_first(v, t); item >= 0; item = nbt_view_next(v, t, item)) {
+		const struct section *s = NULL;
+		if (nbt_view_tag(v, item) == TAG_Compound)
+			s = changed_section(v, item, sections_len, sections);
+		if (s == NULL) {
+			copy_tag(w, v, item);
+			continue;
+		}
+
+		nbt_begin_compound(w, NULL);
+		for (int c = nbt_view_first(v, item); c >= 0; c = nbt_view_next(v, item, c)) {
+			uint16_t len;
+			const char *name = nbt_view_name(v, c, &len);
+			bool replaced = (nbt_view_tag(v, c) == TAG_List && len == 7 && memcmp(name, "Palette", len) == 0)
+				|| (nbt_view_tag(v, c) == TAG_Long_Array && len == 11 && memcmp(name, "BlockStates", len) == 0);
+			if (!replaced)
+				copy_tag(w, v, c);
+		}
+		put_section_blocks(w, s);
+		nbt_end(w);
+	}
+	nbt_end(w);
+}
+
+int chunk_nbt_write(struct nbt_writer *w, const struct nbt_view *v, int sections_len, struct section **sections) {
+	int level = nbt_view_get(v, 0, TAG_Compound, "Level");
+	if (level < 0) {
+		fprintf(stderr, "chunk has no level data\n");
+		return -1;
+	}
+	int sections_nbt = nbt_view_get(v, level, TAG_List, "Sections");
+	if (sections_nbt < 0) {
+		fprintf(stderr, "chunk has no sections\n");
+		return -1;
+	}
+	int light_on = nbt_view_get(v, level, TAG_Byte, "isLightOn");
+
+	uint16_t name_len;
+	const char *name = nbt_view_name(v, 0, &name_len);
+	char *root_name = strndup(name, name_len);
+	nbt_begin_compound(w, root_name);
+	free(root_name);
+
+	for (int t = nbt_view_first(v, 0); t >= 0; t = nbt_view_next(v, 0, t)) {
+		if (t != level) {
+			copy_tag(w, v, t);
+			continue;
+		}
+
+		nbt_begin_compound(w, "Level");
+		for (int l = nbt_view_first(v, level); l >= 0; l = nbt_view_next(v, level, l)) {
+			if (l == sections_nbt) {
+				put_sections(w, v, l, sections_len, sections);
+			} else if (l == light_on) {
+				/* the saved light is stale now, so make the game recalculate it */
+				nbt_put_byte(w, "isLightOn", 0);
+			} else {
+				copy_tag(w, v, l);
+			}
+		}
+		nbt_end(w);
+	}
+
+	nbt_end(w);
+	return w->err;
+}
+
+/* Rewrites one chunk in its region file: reads the chunk's NBT back from
+ * disk and writes it out again as it goes, swapping in the changed sections'
+ * palettes + blockstates. Everything the tick thread doesn't track
+ * (entities, heightmaps, ...) is copied over as it was on disk. */
+static int write_chunk_save(struct chunk_save *s, struct nbt_writer *w, size_t *buf_len, Bytef **buf) {
+	ssize_t len = region_file_read_chunk(s->file, s->x, s->z, buf_len, buf);
+	if (len <= 0) {
+		fprintf(stderr, "can't save chunk (%d, %d), it isn't in '%s'\n", s->x, s->z, s->file->path);
+		return -1;
+	}
+
+	struct nbt_view v;
+	if (nbt_view_init(&v, len, *buf) < 0) {
+		fprintf(stderr, "error parsing chunk (%d, %d) for saving\n", s->x, s->z);
+		return -1;
+	}
+	nbt_writer_reset(w);
+	int err = chunk_nbt_write(w, &v, s->sections_len, s->sections);
+	nbt_view_free(&v);
+	if (err < 0)
+		return -1;
+
+	uLongf compressed_len = compressBound(w->len);
+	Bytef *compressed = malloc(compressed_len);
+	err = compress2(compressed, &compressed_len, w->data, w->len, Z_DEFAULT_COMPRESSION);
+	if (err != Z_OK) {
+		fprintf(stderr, "error compressing chunk (%d, %d): %d\n", s->x, s->z, err);
+		free(compressed);
+		return -1;
+	}
+
+	err = region_file_write_chunk(s->file, s->x, s->z, compressed, compressed_len);
+	free(compressed);
+	return err;
+}
+
+static void free_chunk_save(struct chunk_save *s) {
+	for (int i = 0; i < s->sections_len; ++i)
+		section_unref(s->sections[i]);
+	free(s);
+}
+
+/* saves that couldn't be written, waiting for save_take_failed() */
+static pthread_mutex_t failed_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct chunk_save *failed = NULL;
+
+/* hands a save that couldn't be written back to the tick thread. if a later
+ * save of the same chunk is still queued, the sections it doesn't have go
+ * along with it instead, since retrying this one after it would write older
+ * blocks over newer ones */
+static void save_failed(struct region_file *rf, struct chunk_save *s) {
+	pthread_mutex_lock(&(rf->lock));
+	struct chunk_save *later = rf->saves;
+	while (later != NULL && (later->x != s->x || later->z != s->z))
+		later = later->next;
+	if (later != NULL) {
+		for (int i = 0; i < s->sections_len; ++i) {
+			int j = 0;
+			while (j < later->sections_len && later->sections[j]->y != s->sections[i]->y)
+				++j;
+			if (j == later->sections_len) {
+				later->sections[later->sections_len++] = s->sections[i];
+				s->sections[i] = NULL;
+			}
+		}
+	}
+	pthread_mutex_unlock(&(rf->lock));
+
+	if (later != NULL) {
+		int len = 0;
+		for (int i = 0; i < s->sections_len; ++i) {
+			if (s->sections[i] != NULL)
+				s->sections[len++] = s->sections[i];
+		}
+		s->sections_len = len;
+		free_chunk_save(s);
+		return;
+	}
+	/* the file has to stay open for as long as the save might be retried */
+	region_file_ref(rf);
+	pthread_mutex_lock(&failed_lock);
+	s->next = failed;
+	failed = s;
+	pthread_mutex_unlock(&failed_lock);
+}
+
+/* takes the next save off rf's queue, or returns NULL + stops draining */
+static struct chunk_save *next_save(struct region_file *rf) {
+	pthread_mutex_lock(&(rf->lock));
+	struct chunk_save *s = rf->saves;
+	if (s != NULL) {
+		rf->saves = s->next;
+		if (rf->saves == NULL)
+			rf->saves_tail = NULL;
+	} else {
+		rf->saving = false;
+	}
+	pthread_mutex_unlock(&(rf->lock));
+	return s;
+}
+
+/* only one of these runs per region file at a time, which keeps its saves
+ * in the order they were queued */
+static void drain_saves(void *arg) {
+	struct region_file *rf = arg;
+	size_t buf_len = 0;
+	Bytef *buf = NULL;
+	struct nbt_writer w;
+	nbt_writer_init(&w);
+
+	struct chunk_save *s;
+	while ((s = next_save(rf)) != NULL) {
+		if (write_chunk_save(s, &w, &buf_len, &buf) < 0) {
+			fprintf(stderr, "saving chunk (%d, %d) to '%s' failed, it'll be retried\n", s->x, s->z, rf->path);
+			save_failed(rf, s);
+		} else {
+			free_chunk_save(s);
+		}
+	}
+
+	nbt_writer_free(&w);
+	free(buf);
+	read_chunk_buffers_free();
+	region_file_close(rf);
+}
+
+/* puts s at the end of its file's queue, starting a drain job if there
+ * isn't one */
+static void queue_save(struct pool *pool, struct chunk_save *s) {
+	struct region_file *rf = s->file;
+	s->next = NULL;
+	pthread_mutex_lock(&(rf->lock));
+	if (rf->saves_tail != NULL)
+		rf->saves_tail->next = s;
+	else
+		rf->saves = s;
+	rf->saves_tail = s;
+	bool start = !rf->saving;
+	rf->saving = true;
+	pthread_mutex_unlock(&(rf->lock));
+
+	if (start) {
+		/* the drain job keeps the file open until it's done with it */
+		region_file_ref(rf);
+		if (pool != NULL)
+			pool_submit(pool, drain_saves, rf);
+		else
+			drain_saves(rf);
+	}
+}
+
+int save_chunk(struct pool *pool, struct region_file *rf, struct chunk *c) {
+	if (rf->read_only) {
+		fprintf(stderr, "can't save chunk (%d, %d), '%s' is read-only\n", c->x, c->z, rf->path);
+		return -1;
+	}
+
+	struct chunk_save *s = calloc(1, sizeof(struct chunk_save));
+	s->file = rf;
+	s->x = c->x;
+	s->z = c->z;
+	for (int i = 0; i < c->sections_len; ++i) {
+		if (c->dirty_sections & (1 << i))
+			s->sections[s->sections_len++] = section_ref(c->sections[i]);
+	}
+	c->dirty_sections = 0;
+	queue_save(pool, s);
+	return 0;
+}
+
+struct chunk_save *save_take_failed() {
+	pthread_mutex_lock(&failed_lock);
+	struct chunk_save *s = failed;
+	failed = NULL;
+	pthread_mutex_unlock(&failed_lock);
+	return s;
+}
+
+void save_retry(struct pool *pool, struct chunk_save *s) {
+	struct region_file *rf = s->file;
+	queue_save(pool, s);
+	region_file_close(rf);
+}
+
+void save_discard(struct chunk_save *s) {
+	struct region_file *rf = s->file;
+	free_chunk_save(s);
+	region_file_close(rf);
+}
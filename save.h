@@ -0,0 +1,43 @@
+/* Writes changed chunks back to their region files on a worker pool, so the
+ * tick thread never waits on zlib or the disk.
+ */
+#ifndef CHOWDER_SAVE_H
+#define CHOWDER_SAVE_H
+
+#include "nbt_view.h"
+#include "nbt_writer.h"
+#include "pool.h"
+#include "region.h"
+
+/* references to a chunk's changed sections as they were when the save was
+ * queued. taking them only bumps their refcounts, the chunk clones a section
+ * before it's next written to (see chunk_section_mut()) */
+struct chunk_save {
+	struct region_file *file;
+	int x, z;
+	int sections_len;
+	struct section *sections[16];
+	struct chunk_save *next;
+};
+
+/* writes out the chunk NBT in v, with the Palette + BlockStates of the
+ * sections that have the same Y as the given sections replaced by theirs */
+int chunk_nbt_write(struct nbt_writer *, const struct nbt_view *, int sections_len, struct section **sections);
+
+/* Snapshots c's dirty sections and queues them to be written to rf, then clears
+ * c->dirty_sections. Saves are queued per region file and written in order,
+ * so a later save of a chunk never lands before an earlier one. Runs the save
+ * right away if pool is NULL. Returns -1, leaving c dirty, if rf is
+ * read-only. */
+int save_chunk(struct pool *, struct region_file *rf, struct chunk *c);
+
+/* Saves that couldn't be written (and had no later save of their chunk
+ * queued to go along with) are kept for the tick thread, which takes them
+ * with save_take_failed(), linked through next. Each one is then either
+ * queued again with save_retry() or dropped with save_discard(), eg. once
+ * its sections have been marked dirty again. */
+struct chunk_save *save_take_failed();
+void save_retry(struct pool *, struct chunk_save *);
+void save_discard(struct chunk_save *);
+
+#endif
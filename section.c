@@ -1,13 +1,13 @@
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "section.h"
 
-uint8_t bitmask(int size) {
-	/* probably not necessary xd */
-	if (size > 8)
-		return 0xff;
-
-	return (1 << size) - 1;
+/* saved palettes go up to 12 bits per block */
+uint64_t bitmask(int size) {
+	return ((uint64_t) 1 << size) - 1;
 }
 
 struct block_pos {
@@ -40,6 +40,8 @@ struct block_pos block_pos(const struct section *s, int x, int y, int z) {
  * https://wiki.vg/Chunk_Format#Deserializing
  */
 int read_blockstate_at(const struct section *s, int x, int y, int z) {
+	if (s->blockstates == NULL)
+		return 0;
 	struct block_pos p = block_pos(s, x, y, z);
 	int palette_index = s->blockstates[p.start_long] >> p.offset;
 	if (p.start_long != p.end_long) {
@@ -50,11 +52,205 @@ int read_blockstate_at(const struct section *s, int x, int y, int z) {
 }
 
 void write_blockstate_at(struct section *s, int x, int y, int z, int value) {
+	if (section_uniform(s)) {
+		if (value == 0)
+			return;
+		s->bits_per_block = MIN_BITS_PER_BLOCK;
+		s->blockstates = calloc(BLOCKSTATES_LEN(s->bits_per_block), sizeof(uint64_t));
+	}
 	struct block_pos p = block_pos(s, x, y, z);
 	uint64_t v = value & p.mask;
+	s->blockstates[p.start_long] &= ~(p.mask << p.offset);
 	s->blockstates[p.start_long] |= (v << p.offset);
 	if (p.start_long != p.end_long) {
 		int end_offset = 64 - p.offset;
+		s->blockstates[p.end_long] &= ~(p.mask >> end_offset);
 		s->blockstates[p.end_long] |= v >> end_offset;
 	}
 }
+
+void section_compact(struct section *s) {
+	if (s->bits_per_block <= 0 || s->blockstates == NULL)
+		return;
+
+	int index = 0;
+	if (s->palette_len > 1) {
+		/* only packings where no block straddles two longs are checked, so
+		 * every long of a uniform section is the same repeated pattern */
+		if (s->bits_per_block > 8 || 64 % s->bits_per_block != 0)
+			return;
+		uint64_t first = s->blockstates[0];
+		uint64_t mask = bitmask(s->bits_per_block);
+		index = first & mask;
+		uint64_t pattern = 0;
+		for (int offset = 0; offset < 64; offset += s->bits_per_block)
+			pattern |= (uint64_t) index << offset;
+		if (first != pattern || index >= s->palette_len)
+			return;
+		for (int i = 1; i < BLOCKSTATES_LEN(s->bits_per_block); ++i)
+			if (s->blockstates[i] != first)
+				return;
+	}
+
+	s->palette[0] = s->palette[index];
+	s->palette_len = 1;
+	s->bits_per_block = 0;
+	free(s->blockstates);
+	s->blockstates = NULL;
+}
+
+struct section *section_new() {
+	struct section *s = calloc(1, sizeof(struct section));
+	atomic_init(&(s->refs), 1);
+	return s;
+}
+
+struct section *section_ref(struct section *s) {
+	atomic_fetch_add_explicit(&(s->refs), 1, memory_order_relaxed);
+	return s;
+}
+
+#define STORE_MIN_CAP 1024
+
+/* every interned section, chained on their hash. dropping the last reference
+ * to an interned section happens under the lock, so a lookup can never
+ * hand out a section that's being freed */
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct section **store = NULL;
+static size_t store_cap = 0;
+static size_t store_len = 0;
+
+static void free_section(struct section *s) {
+	free(s->palette);
+	free(s->blockstates);
+	free(atomic_load(&(s->encoded)));
+	free(s);
+}
+
+static uint64_t hash_words(uint64_t h, const void *data, size_t len) {
+	const uint8_t *b = data;
+	/* FNV-1a */
+	for (size_t i = 0; i < len; ++i)
+		h = (h ^ b[i]) * 0x100000001b3;
+	return h;
+}
+
+static uint64_t section_hash(const struct section *s) {
+	uint64_t h = 0xcbf29ce484222325;
+	h = hash_words(h, &(s->y), sizeof(s->y));
+	h = hash_words(h, &(s->bits_per_block), sizeof(s->bits_per_block));
+	if (s->palette_len > 0)
+		h = hash_words(h, s->palette, sizeof(uint16_t) * s->palette_len);
+	if (s->blockstates != NULL)
+		h = hash_words(h, s->blockstates, sizeof(uint64_t) * BLOCKSTATES_LEN(s->bits_per_block));
+	return h;
+}
+
+static bool section_equal(const struct section *a, const struct section *b) {
+	if (a->hash != b->hash || a->y != b->y || a->bits_per_block != b->bits_per_block
+			|| a->palette_len != b->palette_len)
+		return false;
+	if (a->palette_len > 0 && memcmp(a->palette, b->palette, sizeof(uint16_t) * a->palette_len) != 0)
+		return false;
+	if ((a->blockstates == NULL) != (b->blockstates == NULL))
+		return false;
+	return a->blockstates == NULL
+		|| memcmp(a->blockstates, b->blockstates, sizeof(uint64_t) * BLOCKSTATES_LEN(a->bits_per_block)) == 0;
+}
+
+static void store_grow() {
+	size_t cap = store_cap == 0 ? STORE_MIN_CAP : store_cap * 2;
+	struct section **buckets = calloc(cap, sizeof(struct section *));
+	for (size_t i = 0; i < store_cap; ++i) {
+		struct section *s = store[i];
+		while (s != NULL) {
+			struct section *next = s->store_next;
+			s->store_next = buckets[s->hash & (cap - 1)];
+			buckets[s->hash & (cap - 1)] = s;
+			s = next;
+		}
+	}
+	free(store);
+	store = buckets;
+	store_cap = cap;
+}
+
+struct section *section_intern(struct section *s) {
+	if (s->interned)
+		return s;
+	s->hash = section_hash(s);
+
+	pthread_mutex_lock(&store_lock);
+	if (store_cap > 0) {
+		struct section *found = store[s->hash & (store_cap - 1)];
+		while (found != NULL && !section_equal(found, s))
+			found = found->store_next;
+		if (found != NULL) {
+			section_ref(found);
+			pthread_mutex_unlock(&store_lock);
+			section_unref(s);
+			return found;
+		}
+	}
+
+	if (store_len >= store_cap)
+		store_grow();
+	s->interned = true;
+	s->store_next = store[s->hash & (store_cap - 1)];
+	store[s->hash & (store_cap - 1)] = s;
+	++store_len;
+	pthread_mutex_unlock(&store_lock);
+	return s;
+}
+
+size_t section_store_len() {
+	pthread_mutex_lock(&store_lock);
+	size_t len = store_len;
+	pthread_mutex_unlock(&store_lock);
+	return len;
+}
+
+void section_unref(struct section *s) {
+	if (!s->interned) {
+		if (atomic_fetch_sub_explicit(&(s->refs), 1, memory_order_acq_rel) == 1)
+			free_section(s);
+		return;
+	}
+
+	pthread_mutex_lock(&store_lock);
+	if (atomic_fetch_sub_explicit(&(s->refs), 1, memory_order_acq_rel) != 1) {
+		pthread_mutex_unlock(&store_lock);
+		return;
+	}
+	struct section **prev = &(store[s->hash & (store_cap - 1)]);
+	while (*prev != s)
+		prev = &((*prev)->store_next);
+	*prev = s->store_next;
+	--store_len;
+	if (store_len == 0) {
+		free(store);
+		store = NULL;
+		store_cap = 0;
+	}
+	pthread_mutex_unlock(&store_lock);
+	free_section(s);
+}
+
+struct section *section_clone(const struct section *s) {
+	struct section *clone = malloc(sizeof(struct section));
+	*clone = *s;
+	atomic_init(&(clone->refs), 1);
+	clone->interned = false;
+	clone->store_next = NULL;
+	atomic_init(&(clone->encoded), NULL);
+	if (s->palette != NULL) {
+		clone->palette = malloc(sizeof(uint16_t) * s->palette_len);
+		memcpy(clone->palette, s->palette, sizeof(uint16_t) * s->palette_len);
+	}
+	if (s->blockstates != NULL) {
+		size_t len = sizeof(uint64_t) * BLOCKSTATES_LEN(s->bits_per_block);
+		clone->blockstates = malloc(len);
+		memcpy(clone->blockstates, s->blockstates, len);
+	}
+	return clone;
+}
@@ -1,22 +1,83 @@
 /* Defines a struct for storing chunk section information,
  * and functions for manipulating each section's blockstates array.
  */
+#ifndef CHOWDER_SECTION_H
+#define CHOWDER_SECTION_H
+
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
 #define TOTAL_BLOCKSTATES 4096
 #define BLOCKSTATES_LEN(bits_per_block) (TOTAL_BLOCKSTATES * bits_per_block / 64)
+/* the fewest bits per block the game will accept in a blockstates array */
+#define MIN_BITS_PER_BLOCK 4
+/* the most the client takes with a palette, past that it wants global ids */
+#define MAX_PALETTE_BITS_PER_BLOCK 8
+#define GLOBAL_BITS_PER_BLOCK 14
+
+struct section_encoding {
+	size_t len;
+	uint8_t data[];
+};
 
+/* bits_per_block is -1 for sections without blocks, and 0 for uniform
+ * sections: palette[0] everywhere, with palette_len 1 and no blockstates
+ * until something different is written to them.
+ *
+ * Sections are shared between a chunk and any saves of it still queued, and
+ * are copy-on-write: whoever wants to change a section with refs > 1 has to
+ * clone it first (see chunk_section_mut()).
+ *
+ * Loaded sections are also interned (see section_intern()), so chunks with
+ * identical sections share one copy. Interned sections are never written
+ * to, which lets them keep their network encoding around. */
 struct section {
+	atomic_int refs;
+	bool interned;
+	/* content hash + link in the store's bucket, if interned */
+	uint64_t hash;
+	struct section *store_next;
+	/* chunk data encoding, built + used by protocol.c. only interned
+	 * sections keep it, since they can't change. chunks are sent from
+	 * several threads at once, so it's published with a compare and swap
+	 * and never changes after that */
+	_Atomic(struct section_encoding *) encoded;
+
 	int8_t y;
 	int palette_len;
 	/* TODO: make this an array of palette_entry structs,
 	 *       holding the ID + a reference count
 	 *       so entries can be removed when their ref count hits 0.
 	 *       maybe just set the ID to -1 when their ref count hits 0 idk */
-	int *palette;
+	uint16_t *palette;
 	int bits_per_block;
 	uint64_t *blockstates;
 };
 
+static inline bool section_uniform(const struct section *s) {
+	return s->bits_per_block == 0;
+}
+
+/* both take + return palette indices. writing anything but 0 to a uniform
+ * section gives it a blockstates array first */
 int read_blockstate_at(const struct section *s, int x, int y, int z);
 void write_blockstate_at(struct section *s, int x, int y, int z, int value);
+/* turns s into a uniform section if every block in it is the same */
+void section_compact(struct section *s);
+/* calloc()s a section with one reference */
+struct section *section_new();
+struct section *section_ref(struct section *);
+/* frees the section once its last reference is dropped */
+void section_unref(struct section *);
+/* deep copy with one reference, never interned */
+struct section *section_clone(const struct section *s);
+/* Takes over the caller's reference to s and returns an interned section
+ * with the same contents: either s itself, or an existing one (freeing s).
+ * Call it once s won't be written to again; chunk_section_mut() clones
+ * interned sections before they're changed. */
+struct section *section_intern(struct section *s);
+/* # of distinct interned sections */
+size_t section_store_len();
+
+#endif
@@ -1,16 +1,22 @@
 #include "server.h"
+#include <math.h>
 #include <poll.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "chunk_sender.h"
 #include "login.h"
 #include "protocol.h"
+#include "shard.h"
+#include "world.h"
 
-/* TODO: make a config.h file or smth for these settings */
-#define LEVEL_PATH "levels/default"
+/* roughly how many bytes of chunk data each player gets sent per tick */
+#define CHUNK_SEND_BYTES_PER_TICK (256 * 1024)
 
-static struct conn *server_handshake(int sfd, struct packet *p) {
-	struct conn *conn = calloc(1, sizeof(struct conn));
+/* returns 0 if the client wants to log in, -1 otherwise */
+static int server_handshake(int sfd, struct packet *p, struct conn *conn) {
+	*conn = (struct conn) {0};
 	conn->sfd = sfd;
 	conn->packet = p;
 
@@ -18,12 +24,12 @@ static struct conn *server_handshake(int sfd, struct packet *p) {
 	if (next_state == 1) {
 		handle_server_list_ping(conn);
 		conn_finish(conn);
-		return NULL;
+		return -1;
 	} else if (next_state == 2) {
-		return conn;
+		return 0;
 	} else {
 		fprintf(stderr, "invalid state %d\n", next_state);
-		return NULL;
+		return -1;
 	}
 }
 
@@ -43,44 +49,16 @@ static int server_initialize_play_state(struct conn *conn, struct world *w) {
 		return -1;
 	}
 
-	struct region *r = world_region_at(w, 0, 0);
-	if (r == NULL) {
-		r = calloc(1, sizeof(struct region));
-		world_add_region(w, r);
-	}
-	FILE *f = fopen(LEVEL_PATH "/region/r.0.0.mca", "r");
-	if (f == NULL) {
-		fprintf(stderr, "error opening region file\n");
+	struct player *player = conn->player;
+	chunk_sender_init(&(player->sender), player->chunk_x, player->chunk_z, player->view_distance);
+	if (update_view_position(conn, player->chunk_x, player->chunk_z) < 0) {
+		fprintf(stderr, "error sending view position\n");
 		return -1;
 	}
-	/* TODO: don't load chunks here or like this pls thanks */
-	size_t chunk_buf_len = 0;
-	Bytef *chunk_buf = NULL;
-	for (int z = 0; z < 16; ++z) {
-		for (int x = 0; x < 16; ++x) {
-			struct chunk *chunk = r->chunks[z][x];
-			if (chunk == NULL) {
-				int uncompressed_len = read_chunk(f, x, z, &chunk_buf_len, &chunk_buf);
-				if (uncompressed_len > 0) {
-					chunk = parse_chunk(w->block_table, uncompressed_len, chunk_buf);
-					if (chunk == NULL) {
-						fprintf(stderr, "also panic\n");
-						return -1;
-					}
-				} else if (uncompressed_len < 0) {
-					fprintf(stderr, "fuckin panic");
-					return -1;
-				}
-			}
-
-			if (chunk != NULL) {
-				chunk_data(conn, chunk, x, z, true);
-				r->chunks[z][x] = chunk;
-			}
-		}
-	}
-	fclose(f);
-	free(chunk_buf);
+	/* send whatever's right around the player, the rest gets streamed in
+	 * by server_update() + server_read() */
+	if (chunk_sender_tick(conn, w, CHUNK_SEND_BYTES_PER_TICK) < 0)
+		return -1;
 
 	if (spawn_position(conn, 0, 0, 0) < 0) {
 		fprintf(stderr, "error sending spawn position\n");
@@ -111,28 +89,34 @@ static int server_initialize_play_state(struct conn *conn, struct world *w) {
 	return 0;
 }
 
-struct conn *server_accept_connection(int sfd, struct packet *p, struct world *w, struct login_ctx *l_ctx) {
-	struct conn *c = server_handshake(sfd, p);
-	if (c == NULL) {
+int server_accept_connection(int sfd, struct packet *p, struct world *w, struct login_ctx *l_ctx, struct conn *c) {
+	if (server_handshake(sfd, p, c) < 0) {
 		close(sfd);
-		return NULL;
+		return -1;
 	}
 	int err = login(c, l_ctx);
 	if (err < 0) {
 		// TODO: return meaningful errors instead of -1 everywhere
 		fprintf(stderr, "error logging in: %d\n", err);
 		conn_finish(c);
-		return NULL;
+		return -1;
 	}
 	err = server_initialize_play_state(c, w);
 	if (err < 0) {
 		fprintf(stderr, "error switching to play state: %d\n", err);
-		return NULL;
+		server_close_connection(c, w);
+		return -1;
 	}
-	return c;
+	return 0;
 }
 
-int server_play(struct conn *conn, struct world *w) {
+void server_close_connection(struct conn *c, struct world *w) {
+	if (c->player != NULL)
+		chunk_sender_finish(&(c->player->sender), w);
+	conn_finish(c);
+}
+
+int server_read(struct conn *conn, struct shard *shard) {
 	struct pollfd pfd = { .fd = conn->sfd, .events = POLLIN };
 	int polled;
 	while ((polled = poll(&pfd, 1, 0)) > 0 && (pfd.revents & POLLIN)) {
@@ -144,6 +128,7 @@ int server_play(struct conn *conn, struct world *w) {
 			fprintf(stderr, "error parsing packet\n");
 			return -1;
 		}
+		phase_timer_phase(&(shard->timer), PHASE_PACKETS);
 		switch (conn->packet->packet_id) {
 			case 0x00:
 				printf("teleport confirm: %d\n", teleport_confirm(conn->packet, 123));
@@ -153,19 +138,39 @@ int server_play(struct conn *conn, struct world *w) {
 					break;
 				conn->last_pong = time(NULL);
 				break;
-			case 0x2C:
-				player_block_placement(conn->packet, w);
+			case 0x11:
+			case 0x12:
+				player_position(conn->packet, &(conn->player->x), &(conn->player->y), &(conn->player->z));
+				break;
+			case 0x2C: {
+				struct shard_msg msg = { .type = SHARD_MSG_PLACE_BLOCK };
+				int32_t x, z;
+				int16_t y;
+				if (player_block_placement(conn->packet, &x, &y, &z) < 0)
+					break;
+				msg.x = x;
+				msg.y = y;
+				msg.z = z;
+				shard_send(shard, &msg);
 				break;
+			}
 			default:
 				//printf("unimplemented packet 0x%02x\n", p.packet_id);
 				break;
 		}
+		phase_timer_phase(&(shard->timer), PHASE_NET_READ);
 	}
 	if (polled < 0) {
 		perror("poll");
 		return -1;
 	}
 
+	phase_timer_phase(&(shard->timer), PHASE_CHUNKS);
+	int err = chunk_sender_send(conn);
+	phase_timer_phase(&(shard->timer), PHASE_NET_WRITE);
+	if (err < 0)
+		return -1;
+
 	if (time(NULL) - conn->last_pong >= 30) {
 		puts("client hasn't sent a keep alive in a while, disconnecting");
 		return 0;
@@ -179,3 +184,19 @@ int server_play(struct conn *conn, struct world *w) {
 	}
 	return 1;
 }
+
+int server_update(struct conn *conn, struct world *w) {
+	struct player *player = conn->player;
+	int chunk_x = floor_div((int) floor(player->x), 16);
+	int chunk_z = floor_div((int) floor(player->z), 16);
+	if (chunk_x != player->chunk_x || chunk_z != player->chunk_z) {
+		player->chunk_x = chunk_x;
+		player->chunk_z = chunk_z;
+		if (chunk_sender_move(conn, w, chunk_x, chunk_z) < 0) {
+			fprintf(stderr, "error moving view position\n");
+			return -1;
+		}
+	}
+	chunk_sender_plan(conn, w, CHUNK_SEND_BYTES_PER_TICK);
+	return 0;
+}
@@ -10,7 +10,21 @@
 #include "world.h"
 #include "include/hashmap.h"
 
-struct conn *server_accept_connection(int sfd, struct packet *, struct world *, struct login_ctx *);
-int server_play(struct conn *, struct world *);
+/* takes the client through login into the play state, filling in c.
+ * returns -1 if it didn't make it, with everything already cleaned up */
+int server_accept_connection(int sfd, struct packet *, struct world *, struct login_ctx *, struct conn *c);
+struct shard;
+
+/* reads + handles the connection's packets and sends it the chunks planned
+ * for it. it doesn't touch the world, so it can run on any thread: changes
+ * to the world are sent to shard instead. returns 1 if the connection is
+ * still going, 0 if it was closed and -1 on errors */
+int server_read(struct conn *, struct shard *shard);
+/* tick thread only. moves the player's view if it changed chunks + plans
+ * the chunks to send next. returns -1 on errors */
+int server_update(struct conn *, struct world *);
+/* releases everything the connection holds in the world + closes it, but
+ * doesn't free c itself */
+void server_close_connection(struct conn *, struct world *);
 
 #endif
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "server.h"
+#include "shard.h"
+
+#define SHARD_MIN_CAP 16
+
+static void *grow(void *p, size_t *cap, size_t want, size_t size) {
+	if (want <= *cap)
+		return p;
+	size_t cap_ = *cap > 0 ? *cap : SHARD_MIN_CAP;
+	while (cap_ < want)
+		cap_ *= 2;
+	*cap = cap_;
+	return realloc(p, cap_ * size);
+}
+
+void shards_init(struct shards *s) {
+	memset(s, 0, sizeof(struct shards));
+}
+
+void shards_free(struct shards *s) {
+	for (size_t i = 0; i < s->cap; ++i) {
+		free(s->shards[i].conns);
+		free(s->shards[i].msgs);
+		free(s->shards[i].packet.data);
+	}
+	free(s->shards);
+	free(s->results);
+	free(s->entries);
+}
+
+static int compare_entries(const void *a, const void *b) {
+	uint64_t x = ((const struct shard_entry *) a)->region;
+	uint64_t y = ((const struct shard_entry *) b)->region;
+	return (x > y) - (x < y);
+}
+
+static struct shard *add_shard(struct shards *s, int x, int z) {
+	if (s->len == s->cap) {
+		size_t old_cap = s->cap;
+		s->shards = grow(s->shards, &(s->cap), s->len + 1, sizeof(struct shard));
+		for (size_t i = old_cap; i < s->cap; ++i) {
+			memset(&(s->shards[i]), 0, sizeof(struct shard));
+			packet_init(&(s->shards[i].packet));
+		}
+	}
+	struct shard *shard = &(s->shards[s->len++]);
+	shard->x = x;
+	shard->z = z;
+	shard->set = s;
+	shard->conns_len = 0;
+	shard->msgs_len = 0;
+	return shard;
+}
+
+void shards_build(struct shards *s, struct conn_table *conns) {
+	s->conns = conns;
+	s->len = 0;
+	s->results = grow(s->results, &(s->results_cap), conns->len, sizeof(int));
+	s->entries = grow(s->entries, &(s->entries_cap), conns->len, sizeof(struct shard_entry));
+
+	for (size_t i = 0; i < conns->len; ++i) {
+		struct player *p = conns->conns[i].player;
+		uint32_t x = floor_div(p->chunk_x, 32);
+		uint32_t z = floor_div(p->chunk_z, 32);
+		s->entries[i].region = (uint64_t) x << 32 | z;
+		s->entries[i].conn = i;
+	}
+	qsort(s->entries, conns->len, sizeof(struct shard_entry), compare_entries);
+
+	struct shard *shard = NULL;
+	for (size_t i = 0; i < conns->len; ++i) {
+		uint64_t region = s->entries[i].region;
+		if (shard == NULL || region != s->entries[i - 1].region)
+			shard = add_shard(s, (int32_t) (region >> 32), (int32_t) region);
+		shard->conns = grow(shard->conns, &(shard->conns_cap), shard->conns_len + 1, sizeof(size_t));
+		shard->conns[shard->conns_len++] = s->entries[i].conn;
+	}
+}
+
+static void tick_shard(struct shard *shard) {
+	struct shards *s = shard->set;
+	phase_timer_start(&(shard->timer), PHASE_NET_READ);
+	for (size_t i = 0; i < shard->conns_len; ++i) {
+		struct conn *c = &(s->conns->conns[shard->conns[i]]);
+		struct packet *packet = c->packet;
+		c->packet = &(shard->packet);
+		s->results[shard->conns[i]] = server_read(c, shard);
+		c->packet = packet;
+	}
+	phase_timer_stop(&(shard->timer));
+}
+
+static void tick_shard_job(void *arg) {
+	tick_shard(arg);
+}
+
+void shards_run(struct shards *s, struct pool *pool) {
+	if (pool == NULL || s->len <= 1) {
+		for (size_t i = 0; i < s->len; ++i)
+			tick_shard(&(s->shards[i]));
+	} else {
+		job_counter_init(&(s->running), s->len, NULL, NULL, JOB_HIGH);
+		for (size_t i = 0; i < s->len; ++i)
+			pool_submit_job(pool, JOB_HIGH, &(s->running), tick_shard_job, &(s->shards[i]));
+		/* the tick thread runs shards too while it waits, instead of
+		 * idling */
+		pool_wait_counter(pool, &(s->running));
+	}
+
+	for (int i = 0; i < PHASE_COUNT; ++i)
+		s->phase_ns[i] = 0;
+	for (size_t i = 0; i < s->len; ++i) {
+		for (int j = 0; j < PHASE_COUNT; ++j)
+			s->phase_ns[j] += s->shards[i].timer.phase_ns[j];
+	}
+}
+
+void shards_apply(struct shards *s, struct world *w) {
+	for (size_t i = 0; i < s->len; ++i) {
+		struct shard *shard = &(s->shards[i]);
+		for (size_t j = 0; j < shard->msgs_len; ++j) {
+			struct shard_msg *msg = &(shard->msgs[j]);
+			switch (msg->type) {
+				case SHARD_MSG_PLACE_BLOCK:
+					world_place_block(w, msg->x, msg->y, msg->z);
+					break;
+			}
+		}
+		shard->msgs_len = 0;
+	}
+}
+
+void shard_send(struct shard *shard, const struct shard_msg *msg) {
+	shard->msgs = grow(shard->msgs, &(shard->msgs_cap), shard->msgs_len + 1, sizeof(struct shard_msg));
+	shard->msgs[shard->msgs_len++] = *msg;
+}
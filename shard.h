@@ -0,0 +1,101 @@
+/* Splits the connection half of a tick into shards, one per region (32x32
+ * chunks) that has players in it, and ticks the shards in parallel.
+ *
+ * While shards_run() is going the world is frozen: the tick thread only
+ * runs shards + waits, so shards can read chunks without locks. Anything a
+ * connection wants to change in the world goes on its shard's message
+ * queue instead, and shards_apply() plays every queue back on the tick
+ * thread afterwards, so shards never touch each other's regions. Shards are
+ * rebuilt from where the players are every tick, which is how a player who
+ * walks over a region boundary gets handed to the next shard.
+ *
+ * Only connections are sharded: reading packets, sending chunks + keep
+ * alives. Shards don't own or tick their regions, the world is still
+ * changed, saved + unloaded as a whole on the tick thread.
+ */
+#ifndef CHOWDER_SHARD_H
+#define CHOWDER_SHARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "conn_table.h"
+#include "packet.h"
+#include "pool.h"
+#include "profiler.h"
+#include "world.h"
+
+enum shard_msg_type {
+	SHARD_MSG_PLACE_BLOCK,
+};
+
+struct shard_msg {
+	enum shard_msg_type type;
+	/* world coords */
+	int x;
+	int y;
+	int z;
+};
+
+struct shards;
+
+struct shard {
+	/* region coords */
+	int x;
+	int z;
+	struct shards *set;
+	/* indices of its connections in the conn table */
+	size_t conns_len;
+	size_t conns_cap;
+	size_t *conns;
+	/* applied in the order they were sent */
+	size_t msgs_len;
+	size_t msgs_cap;
+	struct shard_msg *msgs;
+	/* scratch for its connections' packets, so shards don't share one */
+	struct packet packet;
+	/* where its connections' time went, see server_read() */
+	struct phase_timer timer;
+};
+
+struct shard_entry {
+	uint64_t region;
+	size_t conn;
+};
+
+struct shards {
+	/* shards[len] to shards[cap - 1] are kept around for reuse */
+	size_t len;
+	size_t cap;
+	struct shard *shards;
+	/* the table being run, + what server_read() returned for each of its
+	 * connections */
+	struct conn_table *conns;
+	size_t results_cap;
+	int *results;
+	/* scratch for grouping connections */
+	size_t entries_cap;
+	struct shard_entry *entries;
+	/* counts down the shards running on the pool */
+	struct job_counter running;
+	/* every shard's phase times from the last shards_run(), added up, for
+	 * profiler_split() */
+	int64_t phase_ns[PHASE_COUNT];
+};
+
+void shards_init(struct shards *);
+void shards_free(struct shards *);
+
+/* groups the table's connections by the region their player is in */
+void shards_build(struct shards *, struct conn_table *);
+/* runs server_read() for every connection, with the shards spread over
+ * pool (if it isn't NULL). afterwards s->results[i] is what it returned for
+ * conns->conns[i]. the world must not change until it returns */
+void shards_run(struct shards *, struct pool *);
+/* tick thread only. applies + empties every shard's messages */
+void shards_apply(struct shards *, struct world *);
+
+/* queues a change to the world, any thread running the shard */
+void shard_send(struct shard *, const struct shard_msg *);
+
+#endif
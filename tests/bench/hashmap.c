@@ -0,0 +1,127 @@
+/* hashmap times include/hashmap against the linked list hashmap it replaced
+ * (list_hashmap.c), using every block state name as keys: adding them all,
+ * looking them all up, looking up as many keys that aren't there, then
+ * removing them all. The flat hashmap also gets timed with as many integer
+ * keys, like packed chunk coordinates, which the list one can't do.
+ *
+ * Ex. "./hashmap 20" does all of that 20 times and prints the average time
+ * per operation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../blocks.h"
+#include "../../include/hashmap.h"
+#include "list_hashmap.h"
+
+#define DEFAULT_RUNS 10
+
+struct timings {
+	double add;
+	double get;
+	double miss;
+	double remove;
+};
+
+static double elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static char **keys;
+static char **missing;
+static size_t keys_len;
+/* keeps the compiler from throwing away lookups */
+static volatile size_t found;
+
+#define TIME(t, code) do { \
+		struct timespec start, end; \
+		clock_gettime(CLOCK_MONOTONIC, &start); \
+		code; \
+		clock_gettime(CLOCK_MONOTONIC, &end); \
+		(t) += elapsed_ns(&start, &end) / keys_len; \
+	} while (0)
+
+static void bench_flat(struct timings *t) {
+	/* sized like the list hashmap, though it'd grow on its own */
+	struct hashmap *hm = hashmap_new(keys_len);
+	TIME(t->add, for (size_t i = 0; i < keys_len; ++i) hashmap_add(hm, keys[i], keys[i]));
+	TIME(t->get, for (size_t i = 0; i < keys_len; ++i) found += hashmap_get(hm, keys[i]) != NULL);
+	TIME(t->miss, for (size_t i = 0; i < keys_len; ++i) found += hashmap_get(hm, missing[i]) != NULL);
+	TIME(t->remove, for (size_t i = 0; i < keys_len; ++i) hashmap_remove(hm, keys[i]));
+	hashmap_free(hm, NULL);
+}
+
+static void bench_flat_int(struct timings *t) {
+	struct hashmap *hm = hashmap_new(keys_len);
+	/* chunk x,z packed like (x << 32) | z, in a square around 0,0 */
+	size_t side = 1;
+	while (side * side < keys_len)
+		++side;
+#define INT_KEY(i) (((uint64_t) ((i) / side - side / 2) << 32) | (uint32_t) ((i) % side - side / 2))
+	TIME(t->add, for (size_t i = 0; i < keys_len; ++i) hashmap_add_int(hm, INT_KEY(i), keys[i]));
+	TIME(t->get, for (size_t i = 0; i < keys_len; ++i) found += hashmap_get_int(hm, INT_KEY(i)) != NULL);
+	TIME(t->miss, for (size_t i = 0; i < keys_len; ++i) found += hashmap_get_int(hm, INT_KEY(i) ^ (1ull << 62)) != NULL);
+	TIME(t->remove, for (size_t i = 0; i < keys_len; ++i) hashmap_remove_int(hm, INT_KEY(i)));
+#undef INT_KEY
+	hashmap_free(hm, NULL);
+}
+
+static void dont_free(void *p) {
+	(void) p;
+}
+
+static void bench_list(struct timings *t) {
+	struct list_hashmap *hm = list_hashmap_new(keys_len);
+	TIME(t->add, for (size_t i = 0; i < keys_len; ++i) list_hashmap_add(hm, keys[i], keys[i]));
+	TIME(t->get, for (size_t i = 0; i < keys_len; ++i) found += list_hashmap_get(hm, keys[i]) != NULL);
+	TIME(t->miss, for (size_t i = 0; i < keys_len; ++i) found += list_hashmap_get(hm, missing[i]) != NULL);
+	TIME(t->remove, for (size_t i = 0; i < keys_len; ++i) list_hashmap_remove(hm, keys[i]));
+	list_hashmap_free(hm, dont_free);
+}
+
+static void print_timings(const char *name, struct timings *t, int runs) {
+	printf("%-16s add %6.1f  get %6.1f  miss %6.1f  remove %6.1f ns/op\n", name,
+			t->add / runs, t->get / runs, t->miss / runs, t->remove / runs);
+}
+
+int main(int argc, char **argv) {
+	int runs = argc > 1 ? atoi(argv[1]) : DEFAULT_RUNS;
+	if (runs <= 0) {
+		fprintf(stderr, "hashmap: invalid number of runs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	keys_len = block_names_len;
+	keys = malloc(sizeof(char *) * keys_len);
+	missing = malloc(sizeof(char *) * keys_len);
+	for (size_t i = 0; i < keys_len; ++i) {
+		keys[i] = strdup(block_names[i]);
+		size_t len = strlen(keys[i]);
+		missing[i] = malloc(len + 2);
+		memcpy(missing[i], keys[i], len);
+		strcpy(missing[i] + len, "!");
+	}
+
+	struct timings flat = {0};
+	struct timings list = {0};
+	struct timings flat_int = {0};
+	for (int run = 0; run < runs; ++run) {
+		bench_flat(&flat);
+		bench_list(&list);
+		bench_flat_int(&flat_int);
+	}
+	printf("%zu keys\n", keys_len);
+	print_timings("flat", &flat, runs);
+	print_timings("list", &list, runs);
+	print_timings("flat (int keys)", &flat_int, runs);
+
+	for (size_t i = 0; i < keys_len; ++i) {
+		free(keys[i]);
+		free(missing[i]);
+	}
+	free(keys);
+	free(missing);
+	exit(EXIT_SUCCESS);
+}
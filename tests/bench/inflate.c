@@ -0,0 +1,66 @@
+/* inflate times read_chunk() decompressing every chunk in a region file.
+ *
+ * Ex. "./inflate ../r.0.0.mca 20" reads the whole region 20 times and prints
+ * how long it took on average.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../region.h"
+
+#define DEFAULT_REGION_PATH "../r.0.0.mca"
+#define DEFAULT_RUNS 10
+
+static double elapsed_ms(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main(int argc, char **argv) {
+	const char *path = argc > 1 ? argv[1] : DEFAULT_REGION_PATH;
+	int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+	if (runs <= 0) {
+		fprintf(stderr, "inflate: invalid number of runs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t chunk_buf_len = 0;
+	Bytef *chunk_buf = NULL;
+	size_t chunks = 0;
+	size_t bytes = 0;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int run = 0; run < runs; ++run) {
+		for (int z = 0; z < 32; ++z) {
+			for (int x = 0; x < 32; ++x) {
+				ssize_t n = read_chunk(f, x, z, &chunk_buf_len, &chunk_buf);
+				if (n < 0) {
+					fprintf(stderr, "inflate: error reading chunk @ (%d, %d)\n", x, z);
+					exit(EXIT_FAILURE);
+				}
+				chunks += n > 0;
+				bytes += n;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double ms = elapsed_ms(&start, &end);
+	printf("%zu chunks, %.1f MiB uncompressed in %.2f ms (%.2f ms/region)\n",
+			chunks, bytes / (1024.0 * 1024.0), ms, ms / runs);
+	printf("%.0f chunks/s, %.1f MiB/s, chunk buffer %zu KiB\n",
+			chunks / (ms / 1000.0), bytes / (1024.0 * 1024.0) / (ms / 1000.0),
+			chunk_buf_len / 1024);
+
+	free(chunk_buf);
+	read_chunk_buffers_free();
+	fclose(f);
+	exit(EXIT_SUCCESS);
+}
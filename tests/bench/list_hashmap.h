@@ -0,0 +1,17 @@
+#ifndef CHOWDER_LIST_HASHMAP_H
+#define CHOWDER_LIST_HASHMAP_H
+
+#include <stddef.h>
+
+typedef void (*list_free_item_func)(void *);
+
+struct list_hashmap;
+
+struct list_hashmap *list_hashmap_new(size_t elems);
+void list_hashmap_free(struct list_hashmap *, list_free_item_func);
+
+void list_hashmap_add(struct list_hashmap *, char *key, void *value);
+void *list_hashmap_get(struct list_hashmap *, char *key);
+void *list_hashmap_remove(struct list_hashmap *, char *key);
+
+#endif
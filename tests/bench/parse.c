@@ -0,0 +1,93 @@
+/* parse times parse_chunk() on every chunk in a region file, once resolving
+ * every palette entry from scratch and once with a shared palette cache.
+ *
+ * Ex. "./parse ../r.0.0.mca 20" parses the whole region 20 times each way and
+ * prints how long it took on average.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../region.h"
+
+#define DEFAULT_REGION_PATH "../r.0.0.mca"
+#define DEFAULT_RUNS 10
+
+struct raw_chunk {
+	size_t len;
+	uint8_t *data;
+};
+
+static double elapsed_ms(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static double time_parse(struct raw_chunk *chunks, size_t chunks_len, int runs, struct palette_cache *palettes) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int run = 0; run < runs; ++run) {
+		for (size_t i = 0; i < chunks_len; ++i) {
+			struct chunk *c = parse_chunk(chunks[i].len, chunks[i].data, palettes);
+			if (c == NULL) {
+				fprintf(stderr, "parse: error parsing chunk %zu\n", i);
+				exit(EXIT_FAILURE);
+			}
+			free_chunk(c);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return elapsed_ms(&start, &end) / runs;
+}
+
+int main(int argc, char **argv) {
+	const char *path = argc > 1 ? argv[1] : DEFAULT_REGION_PATH;
+	int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+	if (runs <= 0) {
+		fprintf(stderr, "parse: invalid number of runs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	/* inflate everything first so only parsing gets timed */
+	size_t chunk_buf_len = 0;
+	Bytef *chunk_buf = NULL;
+	struct raw_chunk *chunks = malloc(sizeof(struct raw_chunk) * 32*32);
+	size_t chunks_len = 0;
+	for (int z = 0; z < 32; ++z) {
+		for (int x = 0; x < 32; ++x) {
+			ssize_t n = read_chunk(f, x, z, &chunk_buf_len, &chunk_buf);
+			if (n < 0) {
+				fprintf(stderr, "parse: error reading chunk @ (%d, %d)\n", x, z);
+				exit(EXIT_FAILURE);
+			} else if (n > 0) {
+				chunks[chunks_len].len = n;
+				chunks[chunks_len].data = malloc(n);
+				memcpy(chunks[chunks_len].data, chunk_buf, n);
+				++chunks_len;
+			}
+		}
+	}
+	free(chunk_buf);
+	fclose(f);
+
+	double uncached = time_parse(chunks, chunks_len, runs, NULL);
+	struct palette_cache palettes = {0};
+	double cached = time_parse(chunks, chunks_len, runs, &palettes);
+	printf("%zu chunks, uncached %.2f ms/region, cached %.2f ms/region (%.1fx)\n",
+			chunks_len, uncached, cached, uncached / cached);
+	printf("palette cache: %zu entries, %zu hits, %zu misses\n",
+			palettes.len, palettes.hits, palettes.misses);
+
+	palette_cache_free(&palettes);
+	read_chunk_buffers_free();
+	for (size_t i = 0; i < chunks_len; ++i)
+		free(chunks[i].data);
+	free(chunks);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,72 @@
+#include <assert.h>
+
+#include "../conn_table.h"
+
+#define CONN_TABLE_TEST_CONNS 20
+
+static struct conn conn_table_test_conn(int sfd) {
+	struct conn c = {0};
+	c.sfd = sfd;
+	return c;
+}
+
+void test_conn_table() {
+	struct conn_table t;
+	conn_table_init(&t);
+	/* a zeroed handle is never live, not even in an empty table */
+	assert(conn_table_get(&t, (struct conn_handle) {0}) == NULL);
+
+	struct conn_handle handles[CONN_TABLE_TEST_CONNS];
+	for (int i = 0; i < CONN_TABLE_TEST_CONNS; ++i) {
+		struct conn c = conn_table_test_conn(i);
+		handles[i] = conn_table_add(&t, &c);
+	}
+	assert(t.len == CONN_TABLE_TEST_CONNS);
+	for (int i = 0; i < CONN_TABLE_TEST_CONNS; ++i) {
+		assert(conn_table_get(&t, handles[i])->sfd == i);
+		struct conn_handle h = conn_table_handle(&t, i);
+		assert(h.slot == handles[i].slot && h.generation == handles[i].generation);
+	}
+
+	/* removing 3 moves the last connection into its index, and the last
+	 * one's handle follows it there */
+	conn_table_remove_at(&t, 3);
+	assert(t.len == CONN_TABLE_TEST_CONNS - 1);
+	assert(conn_table_get(&t, handles[3]) == NULL);
+	struct conn *moved = conn_table_get(&t, handles[CONN_TABLE_TEST_CONNS - 1]);
+	assert(moved == &(t.conns[3]) && moved->sfd == CONN_TABLE_TEST_CONNS - 1);
+	struct conn_handle h = conn_table_handle(&t, 3);
+	assert(h.slot == handles[CONN_TABLE_TEST_CONNS - 1].slot);
+	assert(h.generation == handles[CONN_TABLE_TEST_CONNS - 1].generation);
+
+	/* the next add reuses 3's slot, but the old handle to it stays stale */
+	struct conn c = conn_table_test_conn(100);
+	struct conn_handle reused = conn_table_add(&t, &c);
+	assert(reused.slot == handles[3].slot && reused.generation != handles[3].generation);
+	assert(conn_table_get(&t, handles[3]) == NULL);
+	assert(conn_table_get(&t, reused)->sfd == 100);
+
+	/* removing by a stale handle does nothing */
+	conn_table_remove(&t, handles[3]);
+	assert(t.len == CONN_TABLE_TEST_CONNS);
+	assert(conn_table_get(&t, reused)->sfd == 100);
+
+	/* removing the last connection doesn't move anything */
+	conn_table_remove(&t, reused);
+	assert(conn_table_get(&t, reused) == NULL);
+	assert(t.len == CONN_TABLE_TEST_CONNS - 1);
+
+	/* empty the table, every other handle still finding its connection
+	 * as the others move around */
+	while (t.len > 0) {
+		conn_table_remove_at(&t, 0);
+		for (size_t i = 0; i < t.len; ++i)
+			assert(conn_table_get(&t, conn_table_handle(&t, i)) == &(t.conns[i]));
+	}
+	for (int i = 0; i < CONN_TABLE_TEST_CONNS; ++i)
+		assert(conn_table_get(&t, handles[i]) == NULL);
+
+	/* an out of range slot isn't live either */
+	assert(conn_table_get(&t, (struct conn_handle) {t.slots_len, 1}) == NULL);
+	conn_table_finish(&t);
+}
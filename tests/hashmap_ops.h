@@ -0,0 +1,49 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../include/hashmap.h"
+
+#define TEST_HASHMAP_KEYS 5000
+
+int test_hashmap() {
+	/* starts small so it has to grow a few times */
+	struct hashmap *hm = hashmap_new(0);
+	static int values[TEST_HASHMAP_KEYS];
+	char key[32];
+	for (int i = 0; i < TEST_HASHMAP_KEYS; ++i) {
+		snprintf(key, 32, "key%d", i);
+		assert(hashmap_add(hm, key, &(values[i])) == NULL);
+		assert(hashmap_add_int(hm, (uint64_t) i << 32, &(values[i])) == NULL);
+	}
+	for (int i = 0; i < TEST_HASHMAP_KEYS; ++i) {
+		snprintf(key, 32, "key%d", i);
+		assert(hashmap_get(hm, key) == &(values[i]));
+		assert(hashmap_get_int(hm, (uint64_t) i << 32) == &(values[i]));
+	}
+	assert(hashmap_get(hm, "nope") == NULL);
+	assert(hashmap_get_int(hm, 1) == NULL);
+
+	/* adding an existing key replaces its value */
+	assert(hashmap_add(hm, "key7", &(values[8])) == &(values[7]));
+	assert(hashmap_get(hm, "key7") == &(values[8]));
+	hashmap_add(hm, "key7", &(values[7]));
+
+	/* removing shifts the entries after it back, which can't lose any */
+	for (int i = 0; i < TEST_HASHMAP_KEYS; i += 2) {
+		snprintf(key, 32, "key%d", i);
+		assert(hashmap_remove(hm, key) != NULL);
+		assert(hashmap_remove_int(hm, (uint64_t) i << 32) == &(values[i]));
+	}
+	assert(hashmap_remove(hm, "key0") == NULL);
+	for (int i = 1; i < TEST_HASHMAP_KEYS; i += 2) {
+		snprintf(key, 32, "key%d", i);
+		assert(hashmap_get(hm, key) == &(values[i]));
+		assert(hashmap_get_int(hm, (uint64_t) i << 32) == &(values[i]));
+		snprintf(key, 32, "key%d", i - 1);
+		assert(hashmap_get(hm, key) == NULL);
+	}
+
+	hashmap_free(hm, NULL);
+	return 0;
+}
@@ -0,0 +1,36 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include "../include/histogram.h"
+
+int test_histogram() {
+	struct histogram h = {0};
+	assert(histogram_percentile(&h, 50) == 0);
+
+	/* small values are exact */
+	for (uint32_t v = 1; v <= 10; ++v)
+		histogram_record(&h, v);
+	assert(h.min == 1 && h.max == 10);
+	assert(histogram_percentile(&h, 50) == 5);
+	assert(histogram_percentile(&h, 100) == 10);
+	assert(histogram_mean(&h) == 5.5);
+
+	/* big ones are within a bucket, which is 1/32 of their power of two */
+	struct histogram big = {0};
+	for (uint32_t v = 1000; v < 1000000; v += 1000)
+		histogram_record(&big, v);
+	uint32_t p50 = histogram_percentile(&big, 50);
+	assert(p50 >= 500000 && p50 <= 500000 + 524288 / 32);
+	assert(histogram_percentile(&big, 100) == 999000);
+	histogram_record(&big, UINT32_MAX);
+	assert(histogram_percentile(&big, 100) == UINT32_MAX);
+
+	histogram_merge(&h, &big);
+	assert(h.count == 10 + 999 + 1);
+	assert(h.min == 1 && h.max == UINT32_MAX);
+	assert(histogram_percentile(&h, 0.5) == 5);
+
+	histogram_clear(&h);
+	assert(h.count == 0 && histogram_percentile(&h, 99) == 0);
+	return 0;
+}
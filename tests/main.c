@@ -1,11 +1,27 @@
 #include <search.h>
 
+#include "conn_table.h"
+#include "hashmap_ops.h"
+#include "histogram.h"
+#include "nbt_reader.h"
+#include "nbt_tree.h"
+#include "nbt_view.h"
 #include "read_region.h"
+#include "save_chunk.h"
 #include "parse_blocks.h"
+#include "pool.h"
 #include "write_blockstate.h"
 
 int main() {
+	test_conn_table();
+	test_hashmap();
+	test_histogram();
+	test_nbt_reader();
+	test_nbt_tree();
+	test_nbt_view();
 	test_parse_blocks();
+	test_pool();
 	test_read_region();
+	test_save_chunk();
 	test_write_blockstate_at();
 }
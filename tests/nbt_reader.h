@@ -0,0 +1,193 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../nbt_reader.h"
+#include "../nbt_writer.h"
+
+enum nbt_reader_test_path {
+	READER_SECTIONS,
+	READER_SECTION,
+	READER_SECTION_Y,
+	READER_PROPERTY,
+	READER_BIOMES,
+	READER_MISSING,
+	READER_PATHS,
+};
+
+static const char *const nbt_reader_test_paths[] = {
+	[READER_SECTIONS] = "Level.Sections",
+	[READER_SECTION] = "Level.Sections[]",
+	[READER_SECTION_Y] = "Level.Sections[].Y",
+	[READER_PROPERTY] = "Level.Sections[].Palette[].Properties.*",
+	[READER_BIOMES] = "Level.Biomes",
+	[READER_MISSING] = "Level.Missing",
+};
+
+struct nbt_reader_test {
+	int events[READER_PATHS];
+	int64_t ys;
+	/* property names + values, one after another */
+	char properties[32];
+	int32_t biomes[4];
+	/* what every event returns */
+	int stop;
+};
+
+static int nbt_reader_test_event(void *ctx, int path, const struct nbt_event *e) {
+	struct nbt_reader_test *t = ctx;
+	++(t->events[path]);
+	switch (path) {
+		case READER_SECTIONS:
+			assert(e->type != NBT_EVENT_VALUE && e->index == -1);
+			assert(e->value.array.type == TAG_Compound && e->value.array.len == 2);
+			break;
+		case READER_SECTION:
+			assert(e->type != NBT_EVENT_VALUE && e->tag == TAG_Compound);
+			assert(e->index == (t->events[path] - 1) / 2);
+			break;
+		case READER_SECTION_Y:
+			assert(e->type == NBT_EVENT_VALUE && e->tag == TAG_Byte);
+			t->ys = t->ys * 10 + e->value.integer;
+			break;
+		case READER_PROPERTY:
+			assert(e->type == NBT_EVENT_VALUE && e->tag == TAG_String);
+			strncat(t->properties, e->name, e->name_len);
+			strncat(t->properties, e->value.string.s, e->value.string.len);
+			break;
+		case READER_BIOMES:
+			assert(e->type == NBT_EVENT_VALUE && e->value.array.len == 4);
+			nbt_event_ints(e, t->biomes);
+			break;
+		default:
+			assert(0);
+	}
+	return t->stop;
+}
+
+static int nbt_reader_test_ignore(void *ctx, int path, const struct nbt_event *e) {
+	(void) ctx;
+	(void) path;
+	(void) e;
+	return 0;
+}
+
+/* a chunk-ish blob: two sections, each with a palette entry, plus tags
+ * nothing asks for */
+static void nbt_reader_test_write(struct nbt_writer *w) {
+	const int64_t blockstates[2] = {-1, 2};
+	const int32_t biomes[4] = {1, -2, 3, 4};
+
+	nbt_begin_compound(w, "");
+	nbt_begin_compound(w, "Level");
+	nbt_put_int(w, "xPos", 3);
+	nbt_begin_list(w, "Sections", TAG_Compound, 2);
+	for (int y = 1; y <= 2; ++y) {
+		nbt_begin_compound(w, NULL);
+		nbt_put_byte(w, "Y", y);
+		nbt_begin_list(w, "Palette", TAG_Compound, 1);
+		nbt_begin_compound(w, NULL);
+		nbt_put_string(w, "Name", "minecraft:dirt", 14);
+		nbt_begin_compound(w, "Properties");
+		nbt_put_string(w, "a", y == 1 ? "1" : "2", 1);
+		nbt_put_string(w, "b", "x", 1);
+		nbt_end(w);
+		nbt_end(w);
+		nbt_end(w);
+		nbt_put_long_array(w, "BlockStates", blockstates, 2);
+		nbt_end(w);
+	}
+	nbt_end(w);
+	nbt_put_int_array(w, "Biomes", biomes, 4);
+	nbt_begin_list(w, "Entities", TAG_Compound, 1);
+	nbt_begin_compound(w, NULL);
+	nbt_put_string(w, "id", "pig", 3);
+	nbt_end(w);
+	nbt_end(w);
+	nbt_end(w);
+	nbt_end(w);
+	assert(w->err == 0 && w->depth == 0);
+}
+
+/* depth lists, each holding the next one */
+static uint8_t *nbt_reader_test_nested(int depth, size_t *len) {
+	*len = 7 + depth * 5 + 1;
+	uint8_t *b = calloc(*len, 1);
+	memcpy(b, "\x0a\x00\x00\x09\x00\x01l", 7);
+	for (int i = 0; i < depth - 1; ++i)
+		memcpy(b + 7 + i * 5, "\x09\x00\x00\x00\x01", 5);
+	/* the innermost list is an empty one, + then the root's TAG_End */
+	return b;
+}
+
+/* tags that can't be read whether they're asked for or skipped */
+static void nbt_reader_test_malformed(size_t len, const uint8_t *b) {
+	const char *const all[] = {"*", "l[]"};
+	assert(nbt_read_paths(len, b, NULL, 0, nbt_reader_test_ignore, NULL) == -1);
+	assert(nbt_read_paths(len, b, all, 2, nbt_reader_test_ignore, NULL) == -1);
+}
+
+void test_nbt_reader() {
+	struct nbt_writer w;
+	nbt_writer_init(&w);
+	nbt_reader_test_write(&w);
+
+	struct nbt_reader_test t = {0};
+	assert(nbt_read_paths(w.len, w.data, nbt_reader_test_paths, READER_PATHS, nbt_reader_test_event, &t) == 0);
+	assert(t.events[READER_SECTIONS] == 2);
+	assert(t.events[READER_SECTION] == 4);
+	assert(t.ys == 12);
+	assert(strcmp(t.properties, "a1bxa2bx") == 0);
+	assert(t.biomes[1] == -2 && t.biomes[3] == 4);
+	assert(t.events[READER_MISSING] == 0);
+
+	/* the callback stops it on the first event */
+	t = (struct nbt_reader_test) {0};
+	t.stop = -5;
+	assert(nbt_read_paths(w.len, w.data, nbt_reader_test_paths, READER_PATHS, nbt_reader_test_event, &t) == -5);
+	assert(t.events[READER_SECTIONS] == 1 && t.events[READER_SECTION] == 0);
+
+	/* every tag's cut short somewhere in here */
+	for (size_t len = 0; len < w.len; ++len) {
+		t = (struct nbt_reader_test) {0};
+		assert(nbt_read_paths(len, w.data, nbt_reader_test_paths, READER_PATHS, nbt_reader_test_event, &t) == -1);
+		assert(nbt_read_paths(len, w.data, NULL, 0, nbt_reader_test_event, &t) == -1);
+	}
+	nbt_writer_free(&w);
+
+	/* too many paths, or too long a one */
+	const char *paths[NBT_READER_MAX_PATHS + 1];
+	for (int i = 0; i <= NBT_READER_MAX_PATHS; ++i)
+		paths[i] = "Missing";
+	const uint8_t empty[] = {TAG_Compound, 0, 0, TAG_End};
+	assert(nbt_read_paths(sizeof(empty), empty, paths, NBT_READER_MAX_PATHS, nbt_reader_test_event, &t) == 0);
+	assert(nbt_read_paths(sizeof(empty), empty, paths, NBT_READER_MAX_PATHS + 1, nbt_reader_test_event, &t) == -1);
+	paths[0] = "a.b.c.d.e.f.g.h.i.j.k.l.m.n.o.p.q";
+	assert(nbt_read_paths(sizeof(empty), empty, paths, 1, nbt_reader_test_event, &t) == -1);
+
+	/* the root isn't a compound */
+	const uint8_t not_compound[] = {TAG_Byte, 0, 0, 5};
+	nbt_reader_test_malformed(sizeof(not_compound), not_compound);
+	/* negative list + array lengths */
+	const uint8_t negative_list[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Byte, 0xff, 0xff, 0xff, 0xff, TAG_End};
+	nbt_reader_test_malformed(sizeof(negative_list), negative_list);
+	const uint8_t negative_array[] = {TAG_Compound, 0, 0, TAG_Long_Array, 0, 1, 'l', 0xff, 0xff, 0xff, 0xfe, TAG_End};
+	nbt_reader_test_malformed(sizeof(negative_array), negative_array);
+	/* tag types past TAG_Long_Array, for a child + for a list's items */
+	const uint8_t bad_child[] = {TAG_Compound, 0, 0, TAG_Long_Array + 1, 0, 1, 'l', TAG_End, TAG_End};
+	nbt_reader_test_malformed(sizeof(bad_child), bad_child);
+	const uint8_t bad_list[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Long_Array + 1, 0, 0, 0, 0, TAG_End};
+	nbt_reader_test_malformed(sizeof(bad_list), bad_list);
+	/* a string longer than what's left */
+	const uint8_t long_string[] = {TAG_Compound, 0, 0, TAG_String, 0, 1, 'l', 0xff, 0xff, 'a', TAG_End};
+	nbt_reader_test_malformed(sizeof(long_string), long_string);
+
+	/* nesting is fine up to the limit */
+	size_t len;
+	uint8_t *nested = nbt_reader_test_nested(100, &len);
+	assert(nbt_read_paths(len, nested, NULL, 0, nbt_reader_test_event, &t) == 0);
+	free(nested);
+	nested = nbt_reader_test_nested(600, &len);
+	nbt_reader_test_malformed(len, nested);
+	free(nested);
+}
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../nbt.h"
+#include "../nbt_writer.h"
+#include "../packet.h"
+#include "../region.h"
+
+/* unpacking a chunk + packing it again gives back the same bytes, and so
+ * does writing the tree out with nbt_put_tree() + packet_write_nbt() */
+static void nbt_tree_test_chunk(struct arena *a, struct packet *p, int x, int z, size_t len, const uint8_t *data) {
+	struct nbt *root = nbt_unpack(a, len, data);
+	if (root == NULL) {
+		fprintf(stderr, "error unpacking chunk @ (%d, %d)\n", x, z);
+		exit(EXIT_FAILURE);
+	}
+	struct nbt *level = nbt_get(root, TAG_Compound, "Level");
+	assert(level != NULL);
+	assert(nbt_find(root, TAG_List, "Sections") == nbt_get(level, TAG_List, "Sections"));
+
+	uint8_t *packed = NULL;
+	size_t packed_len = nbt_pack(root, &packed);
+	if (packed_len != len || memcmp(packed, data, len) != 0) {
+		fprintf(stderr, "chunk @ (%d, %d) packed to different bytes\n", x, z);
+		exit(EXIT_FAILURE);
+	}
+
+	struct nbt_writer w;
+	nbt_writer_init(&w);
+	nbt_put_tree(&w, root);
+	assert(w.err == 0 && w.len == len && memcmp(w.data, data, len) == 0);
+	nbt_writer_free(&w);
+
+	if (len < MAX_PACKET_LEN - 1) {
+		make_packet(p, 0);
+		assert(packet_write_nbt(p, root) == (int) len);
+		assert(memcmp(p->data + 1, data, len) == 0);
+	}
+
+	/* cut short, it's not NBT anymore */
+	assert(nbt_unpack(a, len - 1, data) == NULL);
+	assert(nbt_unpack(a, len / 2, data) == NULL);
+	free(packed);
+}
+
+static void nbt_tree_test_edit(struct arena *a) {
+	struct nbt *root = nbt_new(a, TAG_Compound, "");
+	nbt_add(a, root, TAG_Int, "a")->data.t_int = 1;
+	nbt_set_string(a, nbt_add(a, root, TAG_String, "b"), "bee");
+	struct nbt *list = nbt_add(a, root, TAG_List, "list");
+	for (int i = 0; i < 10; ++i) {
+		struct nbt *c = nbt_add(a, list, TAG_Compound, NULL);
+		nbt_add(a, c, TAG_Short, "i")->data.t_short = i;
+	}
+	int64_t *longs = nbt_set_array(a, nbt_add(a, root, TAG_Long_Array, "longs"), 3);
+	longs[2] = -1;
+
+	assert(nbt_get(root, TAG_Int, "a")->data.t_int == 1);
+	assert(nbt_get(root, TAG_Long, "a") == NULL);
+	/* items are searched too, but nbt_get() only looks at direct children */
+	assert(nbt_get(root, TAG_Short, "i") == NULL);
+	assert(nbt_find(root, TAG_Short, "i")->data.t_short == 0);
+
+	nbt_remove(root, nbt_get(root, TAG_Int, "a"));
+	assert(nbt_get(root, TAG_Int, "a") == NULL);
+	assert(strcmp(nbt_get(root, TAG_String, "b")->data.string, "bee") == 0);
+	/* not one of root's children, so nothing happens */
+	nbt_remove(root, root);
+	assert(root->data.children->len == 3);
+
+	uint8_t *packed = NULL;
+	size_t len = nbt_pack(root, &packed);
+	struct nbt *copy = nbt_unpack(a, len, packed);
+	assert(copy != NULL);
+	assert(nbt_get(copy, TAG_List, "list")->data.list->len == 10);
+	assert(nbt_get(copy, TAG_Long_Array, "longs")->data.array->data.longs[2] == -1);
+	uint8_t *repacked = NULL;
+	assert(nbt_pack(copy, &repacked) == len && memcmp(packed, repacked, len) == 0);
+	free(repacked);
+	free(packed);
+
+	/* a root that isn't a compound gets wrapped in one */
+	struct nbt *n = nbt_new(a, TAG_Byte, "byte");
+	n->data.t_byte = 7;
+	len = nbt_pack(n, &packed);
+	copy = nbt_unpack(a, len, packed);
+	assert(copy != NULL && nbt_get(copy, TAG_Byte, "byte")->data.t_byte == 7);
+	free(packed);
+}
+
+void test_nbt_tree() {
+	FILE *f = fopen("r.0.0.mca", "r");
+	struct arena a = {0};
+	struct packet *p = malloc(sizeof(struct packet));
+	packet_init(p);
+
+	size_t chunk_len = 0;
+	Bytef *chunk_data = NULL;
+	for (int z = 0; z < 32; ++z) {
+		for (int x = 0; x < 32; ++x) {
+			ssize_t n = read_chunk(f, x, z, &chunk_len, &chunk_data);
+			if (n < 0) {
+				fprintf(stderr, "error reading chunk @ (%d, %d)\n", x, z);
+				exit(EXIT_FAILURE);
+			} else if (n > 0) {
+				nbt_tree_test_chunk(&a, p, x, z, n, chunk_data);
+				arena_reset(&a);
+			}
+		}
+	}
+
+	nbt_tree_test_edit(&a);
+
+	packet_free(p);
+	arena_free(&a);
+	free(chunk_data);
+	fclose(f);
+}
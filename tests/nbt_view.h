@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../nbt_view.h"
+#include "../nbt_writer.h"
+
+static void nbt_view_test_write(struct nbt_writer *w) {
+	const int64_t blockstates[2] = {-1, 2};
+	const double pos[3] = {0.5, 64, -3.25};
+
+	nbt_begin_compound(w, "");
+	nbt_begin_compound(w, "Level");
+	nbt_begin_list(w, "Sections", TAG_Compound, 2);
+	for (int y = 1; y <= 2; ++y) {
+		nbt_begin_compound(w, NULL);
+		nbt_put_byte(w, "Y", y);
+		nbt_begin_list(w, "Palette", TAG_Compound, 1);
+		nbt_begin_compound(w, NULL);
+		nbt_put_string(w, "Name", "minecraft:dirt", 14);
+		nbt_end(w);
+		nbt_end(w);
+		nbt_put_long_array(w, "BlockStates", blockstates, 2);
+		nbt_end(w);
+	}
+	nbt_end(w);
+	nbt_begin_list(w, "Pos", TAG_Double, 3);
+	for (int i = 0; i < 3; ++i)
+		nbt_put_double(w, NULL, pos[i]);
+	nbt_end(w);
+	nbt_end(w);
+	nbt_begin_list(w, "Tags", TAG_String, 1);
+	nbt_put_string(w, NULL, "Y", 1);
+	nbt_end(w);
+	nbt_end(w);
+	assert(w->err == 0 && w->depth == 0);
+}
+
+static uint8_t *nbt_view_test_nested(int depth, size_t *len) {
+	*len = 7 + depth * 5 + 1;
+	uint8_t *b = calloc(*len, 1);
+	memcpy(b, "\x0a\x00\x00\x09\x00\x01l", 7);
+	for (int i = 0; i < depth - 1; ++i)
+		memcpy(b + 7 + i * 5, "\x09\x00\x00\x00\x01", 5);
+	return b;
+}
+
+static void nbt_view_test_malformed(size_t len, const uint8_t *b) {
+	struct nbt_view v;
+	assert(nbt_view_init(&v, len, b) == -1);
+	assert(v.tags == NULL);
+}
+
+void test_nbt_view() {
+	struct nbt_writer w;
+	nbt_writer_init(&w);
+	nbt_view_test_write(&w);
+
+	struct nbt_view v;
+	assert(nbt_view_init(&v, w.len, w.data) == 0);
+	assert(nbt_view_tag(&v, 0) == TAG_Compound && nbt_view_len(&v, 0) == 2);
+	int level = nbt_view_get(&v, 0, TAG_Compound, "Level");
+	assert(level >= 0);
+	uint16_t len;
+	assert(memcmp(nbt_view_name(&v, level, &len), "Level", 5) == 0 && len == 5);
+
+	/* sections are items, with no name but still found by index */
+	int sections = nbt_view_get(&v, level, TAG_List, "Sections");
+	assert(nbt_view_list_type(&v, sections) == TAG_Compound && nbt_view_len(&v, sections) == 2);
+	int y = 1;
+	for (int s = nbt_view_first(&v, sections); s >= 0; s = nbt_view_next(&v, sections, s), ++y) {
+		assert(nbt_view_name(&v, s, &len) == NULL && len == 0);
+		assert(nbt_view_integer(&v, nbt_view_get(&v, s, TAG_Byte, "Y")) == y);
+		int blockstates = nbt_view_get(&v, s, TAG_Long_Array, "BlockStates");
+		assert(nbt_view_len(&v, blockstates) == 2);
+		assert(nbt_view_integer_at(&v, blockstates, 0) == -1 && nbt_view_integer_at(&v, blockstates, 1) == 2);
+		assert(nbt_view_integer_at(&v, blockstates, 2) == 0);
+	}
+	assert(y == 3);
+
+	/* find searches the whole subtree, get only direct children, and
+	 * both need the tag to match as well as the name */
+	int name = nbt_view_find(&v, 0, TAG_String, "Name");
+	const char *s = nbt_view_string(&v, name, &len);
+	assert(len == 14 && memcmp(s, "minecraft:dirt", len) == 0);
+	assert(nbt_view_get(&v, 0, TAG_String, "Name") == -1);
+	assert(nbt_view_find(&v, 0, TAG_Int, "Name") == -1);
+	/* a list item's string isn't a name */
+	assert(nbt_view_find(&v, nbt_view_get(&v, 0, TAG_List, "Tags"), TAG_String, "Y") == -1);
+
+	/* lists of numbers are read by index, without an entry per item */
+	int pos = nbt_view_find(&v, 0, TAG_List, "Pos");
+	assert(nbt_view_len(&v, pos) == 3 && nbt_view_first(&v, pos) == -1);
+	assert(nbt_view_real_at(&v, pos, 2) == -3.25 && nbt_view_real_at(&v, pos, 3) == 0);
+
+	/* a compound's raw bytes make a blob of their own */
+	size_t raw_len;
+	const uint8_t *raw = nbt_view_raw(&v, 0, &raw_len);
+	assert(raw == w.data && raw_len == w.len);
+	raw = nbt_view_raw(&v, level, &raw_len);
+	struct nbt_view sub;
+	assert(nbt_view_init(&sub, raw_len, raw) == 0);
+	/* everything but the root + Tags, with its item */
+	assert(sub.tags_len == v.tags_len - 3);
+	nbt_view_free(&sub);
+	nbt_view_free(&v);
+
+	for (size_t l = 0; l < w.len; ++l)
+		nbt_view_test_malformed(l, w.data);
+	nbt_writer_free(&w);
+
+	const uint8_t not_compound[] = {TAG_Byte, 0, 0, 5};
+	nbt_view_test_malformed(sizeof(not_compound), not_compound);
+	const uint8_t negative_list[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Compound, 0xff, 0xff, 0xff, 0xff, TAG_End};
+	nbt_view_test_malformed(sizeof(negative_list), negative_list);
+	const uint8_t negative_numbers[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Int, 0xff, 0xff, 0xff, 0xff, TAG_End};
+	nbt_view_test_malformed(sizeof(negative_numbers), negative_numbers);
+	const uint8_t negative_array[] = {TAG_Compound, 0, 0, TAG_Int_Array, 0, 1, 'l', 0xff, 0xff, 0xff, 0xfe, TAG_End};
+	nbt_view_test_malformed(sizeof(negative_array), negative_array);
+	const uint8_t bad_child[] = {TAG_Compound, 0, 0, TAG_Long_Array + 1, 0, 1, 'l', TAG_End, TAG_End};
+	nbt_view_test_malformed(sizeof(bad_child), bad_child);
+	const uint8_t bad_list[] = {TAG_Compound, 0, 0, TAG_List, 0, 1, 'l', TAG_Long_Array + 1, 0, 0, 0, 0, TAG_End};
+	nbt_view_test_malformed(sizeof(bad_list), bad_list);
+	/* a name longer than what's left */
+	const uint8_t long_name[] = {TAG_Compound, 0, 0, TAG_Byte, 0xff, 0xff, 'l', 1, TAG_End};
+	nbt_view_test_malformed(sizeof(long_name), long_name);
+
+	uint8_t *nested = nbt_view_test_nested(100, &raw_len);
+	assert(nbt_view_init(&v, raw_len, nested) == 0);
+	assert(v.tags_len == 101);
+	nbt_view_free(&v);
+	free(nested);
+	nested = nbt_view_test_nested(600, &raw_len);
+	nbt_view_test_malformed(raw_len, nested);
+	free(nested);
+}
@@ -0,0 +1,83 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "../pool.h"
+
+#define POOL_TEST_JOBS 1000
+
+static void pool_test_sleep() {
+	struct timespec ts = {0, 100000};
+	nanosleep(&ts, NULL);
+}
+
+static void pool_test_count(void *arg) {
+	++(*(atomic_int *) arg);
+}
+
+struct pool_test_order {
+	atomic_int *next;
+	int order;
+};
+
+static void pool_test_record(void *arg) {
+	struct pool_test_order *o = arg;
+	o->order = atomic_fetch_add(o->next, 1);
+}
+
+static void pool_test_block(void *arg) {
+	atomic_int *gate = arg;
+	*gate = 1;
+	while (*gate != 2)
+		pool_test_sleep();
+}
+
+int test_pool() {
+	/* nothing to wait for or report without a pool */
+	pool_wait(NULL);
+	pool_report(NULL, stdout);
+	pool_free(NULL);
+
+	struct pool *p = pool_new(4);
+	assert(p != NULL && pool_threads(p) == 4);
+
+	/* every job runs once, + then runs once after all of them */
+	static atomic_int runs[POOL_TEST_JOBS];
+	atomic_int thens = 0;
+	struct job_counter c;
+	job_counter_init(&c, POOL_TEST_JOBS, pool_test_count, &thens, JOB_HIGH);
+	for (int i = 0; i < POOL_TEST_JOBS; ++i)
+		pool_submit_job(p, i % 2 ? JOB_HIGH : JOB_LOW, &c, pool_test_count, &(runs[i]));
+	pool_wait_counter(p, &c);
+	assert(atomic_load(&(c.count)) == 0);
+	for (int i = 0; i < POOL_TEST_JOBS; ++i)
+		assert(runs[i] == 1);
+	pool_wait(p);
+	assert(thens == 1);
+	pool_free(p);
+
+	/* with the only worker busy, queue high priority jobs + then a low
+	 * one, which has to start after all of them */
+	p = pool_new(1);
+	atomic_int gate = 0;
+	pool_submit_job(p, JOB_HIGH, NULL, pool_test_block, &gate);
+	while (gate != 1)
+		pool_test_sleep();
+	atomic_int next = 0;
+	struct pool_test_order high[8];
+	struct pool_test_order low = {&next, -1};
+	for (int i = 0; i < 8; ++i) {
+		high[i] = (struct pool_test_order) {&next, -1};
+		pool_submit_job(p, JOB_HIGH, NULL, pool_test_record, &(high[i]));
+	}
+	pool_submit(p, pool_test_record, &low);
+	gate = 2;
+	/* pool_wait() would run jobs on this thread too, so just watch until
+	 * they've all started */
+	while (next < 9)
+		pool_test_sleep();
+	pool_wait(p);
+	assert(low.order == 8);
+	pool_free(p);
+	return 0;
+}
@@ -43,6 +43,7 @@ void test_read_region() {
 	struct region *region = malloc(sizeof(struct region));
 	size_t chunk_len = 0;
 	Bytef *chunk_data = NULL;
+	struct palette_cache palettes = {0};
 	for (int z = 0; z < 32; ++z) {
 		for (int x = 0; x < 32; ++x) {
 			ssize_t n = read_chunk(f, x, z, &chunk_len, &chunk_data);
@@ -50,7 +51,7 @@ void test_read_region() {
 				fprintf(stderr, "error reading chunk @ (%d, %d)\n", x, z);
 				exit(EXIT_FAILURE);
 			} else if (n > 0) {
-				struct chunk *c = parse_chunk(chunk_data);
+				struct chunk *c = parse_chunk(n, chunk_data, &palettes);
 				if (verify_chunk(c) > 0)
 					exit(EXIT_FAILURE);
 				region->chunks[z][x] = c;
@@ -59,6 +60,7 @@ void test_read_region() {
 	}
 
 
+	palette_cache_free(&palettes);
 	free(chunk_data);
 	fclose(f);
 }
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "save_chunk.h"
+#include "../save.h"
+
+static int block_at(const struct section *s, int x, int y, int z) {
+	return s->palette[read_blockstate_at(s, x, y, z)];
+}
+
+static int compare_chunks(struct chunk *a, struct chunk *b) {
+	if (a->sections_len != b->sections_len) {
+		fprintf(stderr, "%d sections, expected %d\n", b->sections_len, a->sections_len);
+		return 1;
+	}
+	for (int i = 0; i < a->sections_len; ++i) {
+		struct section *s = a->sections[i];
+		struct section *t = b->sections[i];
+		if (s->y != t->y || (s->bits_per_block < 0) != (t->bits_per_block < 0)) {
+			fprintf(stderr, "section %d doesn't match\n", i);
+			return 1;
+		}
+		if (s->bits_per_block < 0)
+			continue;
+		for (int j = 0; j < TOTAL_BLOCKSTATES; ++j) {
+			int x = j % 16, y = j / 256, z = (j / 16) % 16;
+			if (block_at(s, x, y, z) != block_at(t, x, y, z)) {
+				fprintf(stderr, "section %d has block %d at (%d, %d, %d), expected %d\n",
+						s->y, block_at(t, x, y, z), x, y, z, block_at(s, x, y, z));
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/* with nothing changed, everything but isLightOn comes out as it went in */
+static int verify_unchanged(struct nbt_writer *w, struct nbt_view *v, size_t len, const uint8_t *data) {
+	nbt_writer_reset(w);
+	if (chunk_nbt_write(w, v, 0, NULL) < 0 || w->err != 0)
+		return 1;
+	if (w->len != len) {
+		fprintf(stderr, "wrote %zu bytes of %zu\n", w->len, len);
+		return 1;
+	}
+	int light_on = nbt_view_find(v, 0, TAG_Byte, "isLightOn");
+	for (size_t i = 0; i < len; ++i) {
+		if (light_on >= 0 && i == v->tags[light_on].payload) {
+			if (w->data[i] != 0) {
+				fprintf(stderr, "isLightOn wasn't cleared\n");
+				return 1;
+			}
+		} else if (w->data[i] != data[i]) {
+			fprintf(stderr, "byte %zu differs\n", i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* changes a block in the first section that has any, + reads it back */
+static int verify_changed(struct nbt_writer *w, struct nbt_view *v, size_t len, uint8_t *data, struct palette_cache *palettes) {
+	struct chunk *c = parse_chunk(len, data, palettes);
+	int i = 0;
+	while (i < c->sections_len && c->sections[i]->bits_per_block <= 0)
+		++i;
+	if (i == c->sections_len) {
+		free_chunk(c);
+		return 0;
+	}
+	struct section *s = chunk_section_mut(c, i);
+	write_blockstate_at(s, 1, 2, 3, s->palette_len - 1);
+
+	int err = 0;
+	nbt_writer_reset(w);
+	if (chunk_nbt_write(w, v, 1, &s) < 0 || w->err != 0) {
+		err = 1;
+	} else {
+		struct chunk *saved = parse_chunk(w->len, w->data, palettes);
+		err = compare_chunks(c, saved);
+		free_chunk(saved);
+	}
+	free_chunk(c);
+	return err;
+}
+
+void test_save_chunk() {
+	FILE *f = fopen("r.0.0.mca", "r");
+
+	size_t chunk_len = 0;
+	Bytef *chunk_data = NULL;
+	struct palette_cache palettes = {0};
+	struct nbt_writer w;
+	nbt_writer_init(&w);
+	struct nbt_view v = {0};
+	for (int z = 0; z < 32; ++z) {
+		for (int x = 0; x < 32; ++x) {
+			ssize_t n = read_chunk(f, x, z, &chunk_len, &chunk_data);
+			if (n < 0) {
+				fprintf(stderr, "error reading chunk @ (%d, %d)\n", x, z);
+				exit(EXIT_FAILURE);
+			} else if (n == 0) {
+				continue;
+			}
+			if (nbt_view_init(&v, n, chunk_data) < 0
+					|| verify_unchanged(&w, &v, n, chunk_data) > 0
+					|| verify_changed(&w, &v, n, chunk_data, &palettes) > 0) {
+				fprintf(stderr, "saving chunk @ (%d, %d) failed\n", x, z);
+				exit(EXIT_FAILURE);
+			}
+			nbt_view_free(&v);
+		}
+	}
+
+	nbt_writer_free(&w);
+	palette_cache_free(&palettes);
+	free(chunk_data);
+	fclose(f);
+}
@@ -0,0 +1 @@
+void test_save_chunk();
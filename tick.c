@@ -0,0 +1,74 @@
+#include <errno.h>
+#include <stdio.h>
+
+#include "tick.h"
+
+#define NSEC_PER_SEC 1000000000
+
+static int now(int64_t *ns) {
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		perror("clock_gettime");
+		return -1;
+	}
+	*ns = (int64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+	return 0;
+}
+
+int tick_clock_init(struct tick_clock *c, int64_t tick_len_nsec, int max_catch_up) {
+	*c = (struct tick_clock) {0};
+	c->tick_len = tick_len_nsec;
+	c->max_catch_up = max_catch_up;
+	if (now(&(c->next)) < 0)
+		return -1;
+	c->tps_start = c->next;
+	return 0;
+}
+
+static void update_tps(struct tick_clock *c, int64_t t) {
+	++(c->tps_ticks);
+	int64_t elapsed = t - c->tps_start;
+	if (elapsed >= NSEC_PER_SEC) {
+		c->tps = (double) c->tps_ticks * NSEC_PER_SEC / elapsed;
+		c->tps_start = t;
+		c->tps_ticks = 0;
+	}
+}
+
+int tick_clock_wait(struct tick_clock *c) {
+	int64_t t;
+	if (now(&t) < 0)
+		return -1;
+	++(c->ticks);
+	update_tps(c, t);
+	c->next += c->tick_len;
+
+	int64_t debt = t - c->next;
+	if (debt > c->tick_len * c->max_catch_up) {
+		/* the last max_catch_up ticks still get caught up on */
+		int64_t skipped = debt / c->tick_len - c->max_catch_up;
+		fprintf(stderr, "can't keep up, %ld ms behind: skipping %ld ticks\n",
+				debt / 1000000, skipped);
+		c->skipped += skipped;
+		c->next += skipped * c->tick_len;
+		debt -= skipped * c->tick_len;
+	}
+	if (debt >= 0) {
+		c->debt = debt;
+		return 0;
+	}
+	c->debt = 0;
+
+	struct timespec deadline;
+	deadline.tv_sec = c->next / NSEC_PER_SEC;
+	deadline.tv_nsec = c->next % NSEC_PER_SEC;
+	/* the deadline is absolute, so an interrupted sleep just starts over */
+	int err;
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)) == EINTR)
+		;
+	if (err != 0) {
+		errno = err;
+		perror("clock_nanosleep");
+	}
+	return 0;
+}
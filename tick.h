@@ -0,0 +1,39 @@
+/* Schedules ticks on absolute deadlines, so game time follows the wall clock.
+ *
+ * Every tick is due one tick length after the one before it, no matter how
+ * long the ticks themselves took. A tick that runs late puts the clock in
+ * debt, and the ticks after it run back to back until the debt is paid.
+ * Debt beyond max_catch_up ticks is written off instead, so a long stall
+ * (a debugger, a suspended VM) doesn't turn into a burst of hundreds of
+ * ticks.
+ */
+#ifndef CHOWDER_TICK_H
+#define CHOWDER_TICK_H
+
+#include <stdint.h>
+#include <time.h>
+
+struct tick_clock {
+	int64_t tick_len;
+	int max_catch_up;
+	/* CLOCK_MONOTONIC ns the next tick is due at */
+	int64_t next;
+	/* how far behind schedule the current tick started, in ns */
+	int64_t debt;
+
+	/* ticks run + ticks written off */
+	uint64_t ticks;
+	uint64_t skipped;
+	/* ticks run per second over the last full second */
+	double tps;
+	int64_t tps_start;
+	uint64_t tps_ticks;
+};
+
+/* the first tick is due right away */
+int tick_clock_init(struct tick_clock *, int64_t tick_len_nsec, int max_catch_up);
+/* call after every tick. sleeps until the next one is due, or returns
+ * right away if it's overdue. returns -1 if the clock can't be read */
+int tick_clock_wait(struct tick_clock *);
+
+#endif
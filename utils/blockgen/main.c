@@ -0,0 +1,546 @@
+/* blockgen reads the block report the vanilla server generates (blocks.json)
+ * and prints C tables for blocks.c: every block state's name, a minimal
+ * perfect hash from "name;property=value;..." keys to state IDs, and arrays
+ * of per-state attributes from gamedata/block_attributes.txt, which explains
+ * its own format.
+ *
+ * Ex. "blockgen ../../gamedata/blocks.json ../../gamedata/block_attributes.txt > ../../blocks_gen.c"
+ *
+ * The hash is "hash and displace": keys are split into buckets with one hash,
+ * then each bucket gets the first seed that sends all of its keys to free
+ * slots with a second, seeded hash. Lookups are two hashes + one strcmp.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../blocks.h"
+#include "../../include/jsmn/jsmn.h"
+
+/* FIXME: this just happens to work and is also a little too many */
+#define TOKENS 800000
+/* average keys per bucket. more makes the table smaller but the seeds
+ * harder to find */
+#define KEYS_PER_BUCKET 4
+#define MAX_SEED UINT16_MAX
+#define ATTRIBUTES_LINE_LEN 256
+#define NAMESPACE "minecraft:"
+
+struct key {
+	char *name;
+	int id;
+};
+
+struct json {
+	char *src;
+	int tokens_len;
+	jsmntok_t *tokens;
+};
+
+static struct key *keys;
+static size_t keys_len;
+static char **names;
+static size_t names_len;
+
+/* indexed by state ID, see blocks.h */
+static uint8_t *flags;
+static uint8_t *emission;
+static uint8_t *filter;
+static uint8_t *shapes;
+
+/* one line of block_attributes.txt. -1 leaves that attribute alone */
+struct rule {
+	uint8_t flags_set;
+	uint8_t flags_clear;
+	int shape;
+	int emit;
+	int filter;
+};
+
+char *read_blocks_json(char *blocks_json_path) {
+	FILE *f = fopen(blocks_json_path, "r");
+	if (f == NULL) {
+		char err[256];
+		snprintf(err, 256, "error opening '%s'", blocks_json_path);
+		perror(err);
+		return NULL;
+	}
+	fseek(f, 0L, SEEK_END);
+	size_t blocks_json_len = ftell(f);
+	rewind(f);
+	char *blocks_json = malloc(sizeof(char) * (blocks_json_len + 1));
+	size_t n = fread(blocks_json, sizeof(char), blocks_json_len, f);
+	fclose(f);
+	if (n < blocks_json_len) {
+		perror("error reading blocks file");
+		fprintf(stderr, "read %ld, expected %ld\n", n, blocks_json_len);
+		free(blocks_json);
+		return NULL;
+	}
+	blocks_json[blocks_json_len] = '\0';
+	return blocks_json;
+}
+
+int toklen(jsmntok_t *t) {
+	return t->end - t->start;
+}
+
+int jstrncmp(char *s, char *blocks_json, jsmntok_t *t) {
+	return strncmp(s, blocks_json + t->start, toklen(t));
+}
+
+/* assumes that the block IDs in blocks.json are sorted */
+int max_block_id(struct json *j) {
+	int i = j->tokens_len - 1;
+	int max_id_index = -1;
+	while (i > 0 && max_id_index < 0) {
+		if (j->tokens[i].type == JSMN_STRING &&
+				jstrncmp("id", j->src, &(j->tokens[i])) == 0) {
+			max_id_index = i + 1;
+		}
+		--i;
+	}
+
+	int max_id = -1;
+	if (max_id_index != -1) {
+		char id_str[16] = {0};
+		snprintf(id_str, 16, "%.*s", toklen(&(j->tokens[max_id_index])), j->src + j->tokens[max_id_index].start);
+		max_id = atoi(id_str);
+	}
+	return max_id;
+}
+
+int jseek(struct json *j, char *s, int from) {
+	int index = -1;
+
+	for (int i = from; i < j->tokens_len && index == -1; ++i) {
+		if (j->tokens[i].type == JSMN_STRING &&
+				jstrncmp(s, j->src, &(j->tokens[i])) == 0) {
+			index = i;
+		}
+	}
+
+	return index;
+}
+
+int add_block_id(char *name, int id) {
+	keys = realloc(keys, sizeof(struct key) * (keys_len + 1));
+	keys[keys_len].name = strdup(name);
+	keys[keys_len].id = id;
+	++keys_len;
+
+	if (names[id] == NULL)
+		names[id] = strdup(name);
+	return 1;
+}
+
+int parse_block_states(struct json *j, char *block_name, int state_index, int *count) {
+	char prop_name[256] = {0};
+	snprintf(prop_name, 256, "%s", block_name);
+	int state_end = j->tokens[state_index].end;
+	int i = state_index;
+
+	bool is_default = false;
+	int default_index = jseek(j, "default", state_index);
+	if (default_index != -1 && j->tokens[default_index].start < state_end) {
+		/* assumes that the value for "default" is true */
+		is_default = true;
+	}
+
+	bool has_properties = false;
+	int properties_index = jseek(j, "properties", state_index);
+	if (properties_index != -1 && j->tokens[properties_index].start < state_end) {
+		has_properties = true;
+		i = properties_index;
+
+		++i;
+		int prop_end = j->tokens[i].end;
+		assert(j->tokens[i].type == JSMN_OBJECT);
+		++i;
+		while (j->tokens[i].start < prop_end) {
+			/* add property name */
+			strcat(prop_name, ";");
+			strncat(prop_name, j->src + j->tokens[i].start, toklen(&(j->tokens[i])));
+			++i;
+			/* add property value */
+			strcat(prop_name, "=");
+			strncat(prop_name, j->src + j->tokens[i].start, toklen(&(j->tokens[i])));
+			++i;
+		}
+	}
+
+	int id_index = jseek(j, "id", state_index);
+	if (id_index != -1 && j->tokens[id_index].start < state_end) {
+		i = id_index + 1;
+		assert(j->tokens[i].type == JSMN_PRIMITIVE);
+
+		char id_str[16];
+		snprintf(id_str, 16, "%.*s", toklen(&(j->tokens[i])), j->src + j->tokens[i].start);
+		int id = atoi(id_str);
+
+		*count += add_block_id(prop_name, id);
+		/* a block's name on its own means its default state */
+		if (is_default && has_properties)
+			add_block_id(block_name, id);
+	}
+
+	i = state_index;
+	while (i < j->tokens_len && j->tokens[i].start < state_end)
+		++i;
+
+	return i;
+}
+
+/* parse each of the block states into keys */
+int parse_blocks_json(struct json *j) {
+	int count = 0;
+	int i = 1;
+	int name_len = 128;
+	char name[128] = {0};
+	while (i < j->tokens_len && j->tokens[i].type == JSMN_STRING) {
+		snprintf(name, name_len, "%.*s", toklen(&(j->tokens[i])), j->src + j->tokens[i].start);
+		++i;
+
+		assert(j->tokens[i].type == JSMN_OBJECT);
+		int block_token_end = j->tokens[i].end;
+
+		int states_index = jseek(j, "states", i);
+		if (states_index != -1) {
+			i = states_index + 1;
+			assert(j->tokens[i].type == JSMN_ARRAY);
+			int states_index = i;
+			int states_end = j->tokens[states_index].end;
+			++i;
+			assert(j->tokens[i].type == JSMN_OBJECT);
+			while (i < j->tokens_len && j->tokens[i].start < states_end)
+				i = parse_block_states(j, name, i, &count);
+		}
+
+		while (i < j->tokens_len && j->tokens[i].start < block_token_end)
+			++i;
+	}
+	return count;
+}
+
+int parse_blocks(char *blocks_json) {
+	jsmn_parser p;
+	jsmn_init(&p);
+	jsmntok_t *t = malloc(sizeof(jsmntok_t) * TOKENS);
+	int tokens = jsmn_parse(&p, blocks_json, strlen(blocks_json), t, TOKENS);
+	if (tokens < 0) {
+		fprintf(stderr, "error parsing blocks.json: %d\n", tokens);
+		free(t);
+		return -1;
+	}
+
+	struct json j = {0};
+	j.src = blocks_json;
+	j.tokens_len = tokens;
+	j.tokens = t;
+	int block_ids = max_block_id(&j) + 1;
+	names_len = block_ids;
+	names = calloc(block_ids, sizeof(char *));
+	int parsed = parse_blocks_json(&j);
+	free(t);
+	if (parsed != block_ids) {
+		fprintf(stderr, "too few blocks parsed; parsed (%d) != block_ids (%d)\n", parsed, block_ids);
+		return -1;
+	}
+	return 0;
+}
+
+/* the pattern's name part against the state's name w/o its namespace or
+ * properties. one '*' matches anything, including nothing */
+static bool name_matches(const char *state, const char *pattern, size_t pattern_len) {
+	if (strncmp(state, NAMESPACE, strlen(NAMESPACE)) == 0)
+		state += strlen(NAMESPACE);
+	const char *props = strchr(state, ';');
+	size_t state_len = props != NULL ? (size_t) (props - state) : strlen(state);
+
+	const char *star = memchr(pattern, '*', pattern_len);
+	if (star == NULL)
+		return state_len == pattern_len && strncmp(state, pattern, pattern_len) == 0;
+	size_t prefix_len = star - pattern;
+	size_t suffix_len = pattern_len - prefix_len - 1;
+	return state_len >= prefix_len + suffix_len &&
+		strncmp(state, pattern, prefix_len) == 0 &&
+		strncmp(state + state_len - suffix_len, star + 1, suffix_len) == 0;
+}
+
+/* whether a state has a "property=value" */
+static bool state_has(const char *state, const char *cond, size_t cond_len) {
+	const char *p = strchr(state, ';');
+	while (p != NULL) {
+		++p;
+		if (strncmp(p, cond, cond_len) == 0 && (p[cond_len] == ';' || p[cond_len] == '\0'))
+			return true;
+		p = strchr(p, ';');
+	}
+	return false;
+}
+
+static bool state_matches(const char *state, const char *pattern) {
+	const char *cond = strchr(pattern, ';');
+	size_t name_len = cond != NULL ? (size_t) (cond - pattern) : strlen(pattern);
+	if (!name_matches(state, pattern, name_len))
+		return false;
+	while (cond != NULL) {
+		++cond;
+		const char *end = strchr(cond, ';');
+		size_t cond_len = end != NULL ? (size_t) (end - cond) : strlen(cond);
+		if (!state_has(state, cond, cond_len))
+			return false;
+		cond = end;
+	}
+	return true;
+}
+
+static int parse_level(const char *s) {
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || n < 0 || n > 15)
+		return -1;
+	return n;
+}
+
+static int parse_rule(char *attrs, struct rule *r) {
+	*r = (struct rule) {0, 0, -1, -1, -1};
+	for (char *a = strtok(attrs, " \t"); a != NULL; a = strtok(NULL, " \t")) {
+		if (strcmp(a, "air") == 0) {
+			r->flags_set |= BLOCK_AIR;
+		} else if (strcmp(a, "opaque") == 0) {
+			r->flags_set |= BLOCK_OPAQUE;
+		} else if (strcmp(a, "transparent") == 0) {
+			r->flags_clear |= BLOCK_OPAQUE;
+		} else if (strcmp(a, "motion_blocking") == 0) {
+			r->flags_set |= BLOCK_MOTION_BLOCKING;
+		} else if (strcmp(a, "no_motion_blocking") == 0) {
+			r->flags_clear |= BLOCK_MOTION_BLOCKING;
+		} else if (strcmp(a, "shape=empty") == 0) {
+			r->shape = BLOCK_SHAPE_EMPTY;
+		} else if (strcmp(a, "shape=partial") == 0) {
+			r->shape = BLOCK_SHAPE_PARTIAL;
+		} else if (strcmp(a, "shape=full") == 0) {
+			r->shape = BLOCK_SHAPE_FULL;
+		} else if (strncmp(a, "emit=", 5) == 0) {
+			r->emit = parse_level(a + 5);
+		} else if (strncmp(a, "filter=", 7) == 0) {
+			r->filter = parse_level(a + 7);
+		} else {
+			fprintf(stderr, "unknown attribute '%s'\n", a);
+			return -1;
+		}
+		if ((strncmp(a, "emit=", 5) == 0 && r->emit < 0) ||
+				(strncmp(a, "filter=", 7) == 0 && r->filter < 0)) {
+			fprintf(stderr, "bad light level in '%s'\n", a);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void apply_rule(const struct rule *r, size_t id) {
+	flags[id] = (flags[id] | r->flags_set) & ~r->flags_clear;
+	if (r->shape >= 0)
+		shapes[id] = r->shape;
+	if (r->emit >= 0)
+		emission[id] = r->emit;
+	if (r->filter >= 0)
+		filter[id] = r->filter;
+}
+
+int parse_attributes(char *attributes_path) {
+	FILE *f = fopen(attributes_path, "r");
+	if (f == NULL) {
+		char err[256];
+		snprintf(err, 256, "error opening '%s'", attributes_path);
+		perror(err);
+		return -1;
+	}
+
+	flags = malloc(names_len);
+	emission = calloc(names_len, 1);
+	filter = malloc(names_len);
+	shapes = malloc(names_len);
+	memset(flags, BLOCK_OPAQUE | BLOCK_MOTION_BLOCKING, names_len);
+	memset(filter, 15, names_len);
+	memset(shapes, BLOCK_SHAPE_FULL, names_len);
+
+	char line[ATTRIBUTES_LINE_LEN];
+	int line_no = 0;
+	int err = 0;
+	while (!err && fgets(line, ATTRIBUTES_LINE_LEN, f) != NULL) {
+		++line_no;
+		line[strcspn(line, "#\n")] = '\0';
+		char *pattern = strtok(line, " \t");
+		if (pattern == NULL)
+			continue;
+		char *attrs = strtok(NULL, "");
+		struct rule r;
+		if (attrs == NULL || parse_rule(attrs, &r) < 0) {
+			fprintf(stderr, "%s:%d: bad rule for '%s'\n", attributes_path, line_no, pattern);
+			err = 1;
+			break;
+		}
+
+		size_t matched = 0;
+		for (size_t id = 0; id < names_len; ++id) {
+			if (state_matches(names[id], pattern)) {
+				apply_rule(&r, id);
+				++matched;
+			}
+		}
+		if (matched == 0) {
+			fprintf(stderr, "%s:%d: '%s' doesn't match any block\n", attributes_path, line_no, pattern);
+			err = 1;
+		}
+	}
+	fclose(f);
+	return err ? -1 : 0;
+}
+
+static void print_state_array(const char *name, const uint8_t *a) {
+	printf("const uint8_t %s[] = {", name);
+	for (size_t i = 0; i < names_len; ++i)
+		printf("%s%d,", i % 16 == 0 ? "\n\t" : " ", a[i]);
+	puts("\n};");
+}
+
+static uint32_t key_hash(const char *key, uint32_t seed) {
+	return block_key_hash(key, strlen(key), seed);
+}
+
+static size_t *bucket_order;
+static size_t *bucket_lens;
+
+static int compare_buckets(const void *a, const void *b) {
+	size_t a_len = bucket_lens[*(const size_t *) a];
+	size_t b_len = bucket_lens[*(const size_t *) b];
+	return (a_len < b_len) - (a_len > b_len);
+}
+
+/* finds a seed for every bucket, biggest buckets first while there are
+ * still lots of free slots. fills in slots[] with key indices */
+int build_hash(size_t buckets_len, uint16_t *seeds, size_t *slots) {
+	bucket_lens = calloc(buckets_len, sizeof(size_t));
+	size_t **buckets = calloc(buckets_len, sizeof(size_t *));
+	for (size_t i = 0; i < keys_len; ++i) {
+		size_t b = key_hash(keys[i].name, 0) % buckets_len;
+		buckets[b] = realloc(buckets[b], sizeof(size_t) * (bucket_lens[b] + 1));
+		buckets[b][bucket_lens[b]++] = i;
+	}
+	bucket_order = malloc(sizeof(size_t) * buckets_len);
+	for (size_t i = 0; i < buckets_len; ++i)
+		bucket_order[i] = i;
+	qsort(bucket_order, buckets_len, sizeof(size_t), compare_buckets);
+
+	bool *taken = calloc(keys_len, sizeof(bool));
+	size_t *tried = malloc(sizeof(size_t) * keys_len);
+	int err = 0;
+	for (size_t i = 0; i < buckets_len && !err; ++i) {
+		size_t b = bucket_order[i];
+		if (bucket_lens[b] == 0)
+			break;
+
+		uint32_t seed = 1;
+		for (; seed <= MAX_SEED; ++seed) {
+			size_t placed = 0;
+			for (; placed < bucket_lens[b]; ++placed) {
+				size_t slot = key_hash(keys[buckets[b][placed]].name, seed) % keys_len;
+				if (taken[slot])
+					break;
+				taken[slot] = true;
+				tried[placed] = slot;
+			}
+			if (placed == bucket_lens[b])
+				break;
+			for (size_t k = 0; k < placed; ++k)
+				taken[tried[k]] = false;
+		}
+
+		if (seed > MAX_SEED) {
+			fprintf(stderr, "no seed works for bucket %ld (%ld keys)\n", b, bucket_lens[b]);
+			err = 1;
+		} else {
+			seeds[b] = seed;
+			for (size_t k = 0; k < bucket_lens[b]; ++k)
+				slots[tried[k]] = buckets[b][k];
+		}
+	}
+
+	for (size_t i = 0; i < buckets_len; ++i)
+		free(buckets[i]);
+	free(buckets);
+	free(bucket_lens);
+	free(bucket_order);
+	free(taken);
+	free(tried);
+	return err ? -1 : 0;
+}
+
+void print_tables(size_t buckets_len, const uint16_t *seeds, const size_t *slots) {
+	puts("/* generated from blocks.json by utils/blockgen, don't edit */");
+	puts("#include \"blocks.h\"");
+	puts("");
+	printf("const size_t block_names_len = %ld;\n", names_len);
+	puts("const char *const block_names[] = {");
+	for (size_t i = 0; i < names_len; ++i)
+		printf("\t\"%s\",\n", names[i]);
+	puts("};");
+	puts("");
+	printf("const size_t block_keys_len = %ld;\n", keys_len);
+	puts("const struct block_key block_keys[] = {");
+	for (size_t i = 0; i < keys_len; ++i)
+		printf("\t{\"%s\", %d},\n", keys[slots[i]].name, keys[slots[i]].id);
+	puts("};");
+	puts("");
+	printf("const size_t block_key_seeds_len = %ld;\n", buckets_len);
+	puts("const uint16_t block_key_seeds[] = {");
+	for (size_t i = 0; i < buckets_len; ++i)
+		printf("\t%d,\n", seeds[i]);
+	puts("};");
+	puts("");
+	print_state_array("block_flags", flags);
+	print_state_array("block_light_emission", emission);
+	print_state_array("block_light_filter", filter);
+	print_state_array("block_shapes", shapes);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		printf("usage: blockgen BLOCKS_JSON BLOCK_ATTRIBUTES\n");
+		exit(EXIT_FAILURE);
+	}
+
+	char *blocks_json = read_blocks_json(argv[1]);
+	if (blocks_json == NULL)
+		exit(EXIT_FAILURE);
+	int err = parse_blocks(blocks_json);
+	free(blocks_json);
+	if (err < 0 || parse_attributes(argv[2]) < 0)
+		exit(EXIT_FAILURE);
+
+	size_t buckets_len = (keys_len + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+	uint16_t *seeds = calloc(buckets_len, sizeof(uint16_t));
+	size_t *slots = malloc(sizeof(size_t) * keys_len);
+	if (build_hash(buckets_len, seeds, slots) < 0)
+		exit(EXIT_FAILURE);
+	print_tables(buckets_len, seeds, slots);
+
+	for (size_t i = 0; i < keys_len; ++i)
+		free(keys[i].name);
+	for (size_t i = 0; i < names_len; ++i)
+		free(names[i]);
+	free(keys);
+	free(names);
+	free(flags);
+	free(emission);
+	free(filter);
+	free(shapes);
+	free(seeds);
+	free(slots);
+	exit(EXIT_SUCCESS);
+}
@@ -15,9 +15,6 @@
 
 #include "../../blocks.h"
 #include "../../region.h"
-#include "../../include/hashmap.h"
-
-#define BLOCKS_JSON_PATH "../../gamedata/blocks.json"
 
 struct pos {
 	int x;
@@ -33,7 +30,7 @@ struct world_pos {
 int is_region_file(const char *filename);
 struct pos *parse_chunk_pos(const char *in);
 struct world_pos *parse_world_pos(const char *in);
-struct chunk *chunk_at(const char *filename, struct hashmap *block_table, int x, int z);
+struct chunk *chunk_at(const char *filename, int x, int z);
 void print_section(struct section *, const struct pos *);
 void print_sections(struct chunk *, struct pos *);
 void print_block_at(struct chunk *, struct world_pos *);
@@ -64,21 +61,16 @@ int main(int argc, char **argv) {
 			exit(EXIT_FAILURE);
 		}
 	}
-	
-	struct hashmap *block_table = create_block_table(BLOCKS_JSON_PATH);
-	if (block_table == NULL) {
-		fprintf(stderr, "cv: error creating block table\n");
-		exit(EXIT_FAILURE);
-	}
+
 	struct chunk *c;
 	if (world_coords) {
 		struct world_pos *w = p;
 		int x = w->x / 16;
 		int z = w->z / 16;
-		c = chunk_at(argv[1], block_table, x, z);
+		c = chunk_at(argv[1], x, z);
 	} else {
 		struct pos *pos = p;
-		c = chunk_at(argv[1], block_table, pos->x, pos->z);
+		c = chunk_at(argv[1], pos->x, pos->z);
 	}
 
 	if (world_coords) {
@@ -97,10 +89,9 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	hashmap_free(block_table, free);
 	free(p);
 	free_chunk(c);
-	free_block_names();
+	read_chunk_buffers_free();
 	exit(EXIT_SUCCESS);
 }
 
@@ -131,7 +122,7 @@ struct world_pos *parse_world_pos(const char *in) {
 	return p;
 }
 
-struct chunk *chunk_at(const char *filename, struct hashmap *block_table, int x, int z) {
+struct chunk *chunk_at(const char *filename, int x, int z) {
 	FILE *f = fopen(filename, "r");
 
 	Bytef *chunk_buf = NULL;
@@ -145,7 +136,7 @@ struct chunk *chunk_at(const char *filename, struct hashmap *block_table, int x,
 		fprintf(stderr, "cv: no chunk at \"%d,%d\"\n", x, z);
 		exit(EXIT_FAILURE);
 	}
-	struct chunk *c = parse_chunk(block_table, len, chunk_buf);
+	struct chunk *c = parse_chunk(len, chunk_buf, NULL);
 	free(chunk_buf);
 	if (c == NULL) {
 		fprintf(stderr, "cv: error parsing chunk\n");
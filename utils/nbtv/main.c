@@ -2,9 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
-#include "../../nbt.h"
-#include "../../include/linked_list.h"
+#include "../../nbt_view.h"
 
 #define INDENT_SPACES 4
 
@@ -17,21 +17,20 @@ void put_indent(int level)
 	}
 }
 
-void print_array(struct nbt_array *a, int indent)
+void print_array(struct nbt_view *v, int t, int indent)
 {
-	printf("%d entries\n", a->len);
-	for (int32_t i = 0; i < a->len; ++i) {
+	int32_t len = nbt_view_len(v, t);
+	printf("%d entries\n", len);
+	for (int32_t i = 0; i < len; ++i) {
 		put_indent(indent + 1);
 		printf("%d: ", i);
-		switch (a->type) {
+		switch (nbt_view_tag(v, t)) {
 			case TAG_Byte_Array:
-				printf("%d\n", a->data.bytes[i]);
-				break;
 			case TAG_Int_Array:
-				printf("%d\n", a->data.ints[i]);
+				printf("%d\n", (int32_t) nbt_view_integer_at(v, t, i));
 				break;
 			case TAG_Long_Array:
-				printf("%ld\n", a->data.longs[i]);
+				printf("%ld\n", nbt_view_integer_at(v, t, i));
 				break;
 			default:
 				break;
@@ -39,37 +38,34 @@ void print_array(struct nbt_array *a, int indent)
 	}
 }
 
-void print_node_data(struct nbt *node, int indent)
+void print_node_data(struct nbt_view *v, int t, int indent)
 {
-	switch (node->tag) {
+	uint16_t len;
+	const char *s;
+	switch (nbt_view_tag(v, t)) {
 		case TAG_Byte:
-			printf("%d\n", node->data.t_byte);
-			break;
 		case TAG_Short:
-			printf("%d\n", node->data.t_short);
-			break;
 		case TAG_Int:
-			printf("%d\n", node->data.t_int);
+			printf("%d\n", (int32_t) nbt_view_integer(v, t));
 			break;
 		case TAG_Long:
-			printf("%ld\n", node->data.t_long);
+			printf("%ld\n", nbt_view_integer(v, t));
 			break;
 		case TAG_Float:
-			printf("%f\n", node->data.t_float);
-			break;
 		case TAG_Double:
-			printf("%f\n", node->data.t_double);
+			printf("%f\n", nbt_view_real(v, t));
 			break;
 		case TAG_String:
-			printf("'%s'\n", node->data.string);
+			s = nbt_view_string(v, t, &len);
+			printf("'%.*s'\n", len, s);
 			break;
 		case TAG_Byte_Array:
 		case TAG_Int_Array:
 		case TAG_Long_Array:
-			print_array(node->data.array, indent);
+			print_array(v, t, indent);
 			break;
 		case TAG_List:
-			printf("%d %s entries\n", list_len(node->data.list->head), tagNames[node->data.list->type]);
+			printf("%d %s entries\n", nbt_view_len(v, t), tagNames[nbt_view_list_type(v, t)]);
 			break;
 		default:
 			printf("idk how to handle this\n");
@@ -77,52 +73,61 @@ void print_node_data(struct nbt *node, int indent)
 	}
 }
 
-void print_tree_rec(struct nbt *root, int indent)
+void print_tree_rec(struct nbt_view *v, int root, int indent)
 {
+	uint16_t name_len;
+	const char *name = nbt_view_name(v, root, &name_len);
 	put_indent(indent);
-	struct node *children = root->data.children;
-	printf("%s('%s'): %d entries\n", tagNames[root->tag], root->name, list_len(root->data.children));
+	printf("%s('%.*s'): %d entries\n", tagNames[nbt_view_tag(v, root)], name_len, name, nbt_view_len(v, root));
 	put_indent(indent);
 	printf("{\n");
 
-	while (!list_empty(children)) {
-		struct nbt *nbt = list_item(children);
-		if (nbt->tag == TAG_Compound) {
-			print_tree_rec(nbt, indent + 1);
+	for (int t = nbt_view_first(v, root); t >= 0; t = nbt_view_next(v, root, t)) {
+		if (nbt_view_tag(v, t) == TAG_Compound) {
+			print_tree_rec(v, t, indent + 1);
 		} else {
 			put_indent(indent + 1);
-			char *name = "None";
-			if (nbt->name != NULL) {
-				name = nbt->name;
+			name = nbt_view_name(v, t, &name_len);
+			if (name == NULL) {
+				name = "None";
+				name_len = strlen(name);
 			}
-			printf("%s('%s'): ", tagNames[nbt->tag], name);
-			print_node_data(nbt, indent + 1);
+			printf("%s('%.*s'): ", tagNames[nbt_view_tag(v, t)], name_len, name);
+			print_node_data(v, t, indent + 1);
 		}
-		children = list_next(children);
 	}
 
 	put_indent(indent);
 	printf("}\n");
 }
 
-void print_tree(struct nbt *root)
+void print_tree(struct nbt_view *v)
 {
-	print_tree_rec(root, 0);
+	print_tree_rec(v, 0, 0);
 }
 
-void write_tree(struct nbt *root, char *filename)
+/* a tag's bytes are written out as they are, with anything but a compound
+ * wrapped in an unnamed one to make it a valid NBT file */
+void write_tree(struct nbt_view *v, int t, char *filename)
 {
-	uint8_t *data = NULL;
-	size_t len = nbt_pack(root, &data);
+	static const uint8_t header[] = {TAG_Compound, 0, 0};
+	static const uint8_t footer[] = {TAG_End};
+	size_t len;
+	const uint8_t *data = nbt_view_raw(v, t, &len);
 	FILE *f = fopen(filename, "w");
 	if (f == NULL) {
 		perror("nbtv: fopen: ");
 		exit(EXIT_FAILURE);
 	}
-	size_t n = fwrite(data, 1, len, f);
+	int wrap = nbt_view_tag(v, t) != TAG_Compound;
+	size_t n = 0;
+	if (wrap)
+		n += fwrite(header, 1, sizeof(header), f);
+	n += fwrite(data, 1, len, f);
+	if (wrap)
+		n += fwrite(footer, 1, sizeof(footer), f);
 	printf("wrote %ld bytes to '%s'\n", n, filename);
 	fclose(f);
-	free(data);
 }
 
 enum tag tag_name_to_number(char *name)
@@ -165,9 +170,8 @@ int main(int argc, char **argv)
 	fread(buf, 1, f_len, f);
 	fclose(f);
 
-	struct nbt *root = nbt_unpack(f_len, buf);
-	free(buf);
-	if (root == NULL) {
+	struct nbt_view v;
+	if (nbt_view_init(&v, f_len, buf) < 0) {
 		fprintf(stderr, "nbtv: invalid NBT\n");
 		exit(EXIT_FAILURE);
 	} else if (save_filename != NULL && argc == 5) {
@@ -176,20 +180,19 @@ int main(int argc, char **argv)
 			fprintf(stderr, "nbtv: invalid tag '%s'\n", argv[3]);
 			exit(EXIT_FAILURE);
 		}
-		struct nbt *node = nbt_find(root, t, argv[4]);
-		if (node == NULL) {
+		int node = nbt_view_find(&v, 0, t, argv[4]);
+		if (node < 0) {
 			fprintf(stderr, "nbtv: couldn't find tag '%s'\n", argv[4]);
 			exit(EXIT_FAILURE);
 		}
-		write_tree(node, save_filename);
-		nbt_free(root);
+		write_tree(&v, node, save_filename);
 	} else if (save_filename != NULL) {
-		write_tree(root, save_filename);
-		nbt_free(root);
+		write_tree(&v, 0, save_filename);
 	} else {
-		print_tree(root);
-		nbt_free(root);
+		print_tree(&v);
 	}
+	nbt_view_free(&v);
+	free(buf);
 
 	exit(EXIT_SUCCESS);
 }
@@ -1,110 +1,560 @@
 #include "world.h"
 #include "region.h"
+#include "save.h"
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 
+#define REGIONS_MIN_CAP 16
+
+/* marks a slot whose region was removed. readers have to keep probing past
+ * it, since regions can't be shifted around while they're being read */
+static struct region tombstone;
+#define TOMBSTONE (&tombstone)
+
+static struct region_table *region_table_new(size_t cap) {
+	struct region_table *t = malloc(sizeof(struct region_table) + cap * sizeof(struct region *));
+	t->cap = cap;
+	t->len = 0;
+	t->tombstones = 0;
+	for (size_t i = 0; i < cap; ++i)
+		atomic_init(&(t->slots[i]), NULL);
+	return t;
+}
+
 struct world *world_new() {
-	struct world *w = malloc(sizeof(struct world));
-	w->regions = list_new();
+	struct world *w = calloc(1, sizeof(struct world));
+	atomic_init(&(w->regions), region_table_new(REGIONS_MIN_CAP));
+	epoch_init(&(w->epoch));
 	return w;
 }
 
-bool region_list_z_equal(void *list, void *item) {
-	struct region *r1 = item;
-	struct region *r2 = list_item((struct node *) list);
-	return r1->z == r2->z;
+static size_t region_hash(int x, int z) {
+	uint64_t h = ((uint64_t)(uint32_t) x << 32) | (uint32_t) z;
+	/* splitmix64 finalizer */
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111eb;
+	h ^= h >> 31;
+	return h;
+}
+
+static struct region *load_slot(struct region_table *t, size_t i) {
+	return atomic_load_explicit(&(t->slots[i]), memory_order_acquire);
+}
+
+/* returns the region at x,z, or NULL. it's the pointer that was compared,
+ * since the slot can be changed by the tick thread right after. slot (if it
+ * isn't NULL) gets the slot it was in, which is only stable on the tick
+ * thread */
+static struct region *region_find(struct region_table *t, int x, int z, size_t *slot) {
+	size_t mask = t->cap - 1;
+	size_t i = region_hash(x, z) & mask;
+	struct region *r;
+	while ((r = load_slot(t, i)) != NULL) {
+		if (r != TOMBSTONE && r->x == x && r->z == z) {
+			if (slot != NULL)
+				*slot = i;
+			return r;
+		}
+		i = (i + 1) & mask;
+	}
+	return NULL;
 }
 
-bool region_list_z_greater(void *list, void *item) {
-	struct region *r1 = item;
-	struct region *r2 = list_item((struct node *) list);
-	return r2->z > r1->z;
+/* returns the first free slot (empty or tombstone) for a region at x,z,
+ * assuming it isn't already in the table */
+static size_t region_free_slot(struct region_table *t, int x, int z) {
+	size_t mask = t->cap - 1;
+	size_t i = region_hash(x, z) & mask;
+	struct region *r;
+	while ((r = load_slot(t, i)) != NULL && r != TOMBSTONE)
+		i = (i + 1) & mask;
+	return i;
 }
 
-bool region_list_x_greater(void *list, void *item) {
-	struct region *r1 = item;
-	struct region *r2 = list_item(list);
-	return r2->x > r1->x;
+/* copies every live region into a new table and publishes it. the old table
+ * is retired, since readers could still be probing it */
+static void world_rebuild_regions(struct world *w, size_t cap) {
+	struct region_table *old = atomic_load_explicit(&(w->regions), memory_order_relaxed);
+	struct region_table *t = region_table_new(cap);
+	for (size_t i = 0; i < old->cap; ++i) {
+		struct region *r = load_slot(old, i);
+		if (r != NULL && r != TOMBSTONE) {
+			atomic_init(&(t->slots[region_free_slot(t, r->x, r->z)]), r);
+			++(t->len);
+		}
+	}
+	atomic_store_explicit(&(w->regions), t, memory_order_release);
+	epoch_retire(&(w->epoch), old, free);
 }
 
+static void free_region_item(void *);
+static void world_forget_region(struct world *, struct region *);
+
 void world_add_region(struct world *w, struct region *r) {
-	struct node *region_list = list_find(w->regions, &region_list_z_equal, r);
+	struct region_table *t = atomic_load_explicit(&(w->regions), memory_order_relaxed);
+	size_t existing;
+	struct region *old = region_find(t, r->x, r->z, &existing);
+	if (old != NULL) {
+		if (old == r)
+			return;
+		if (w->last_region == old)
+			w->last_region = NULL;
+		atomic_store_explicit(&(t->slots[existing]), r, memory_order_release);
+		world_forget_region(w, old);
+		epoch_retire(&(w->epoch), old, free_region_item);
+		return;
+	}
 
-	if (list_empty(region_list)) {
-		struct node *l = list_new();
-		list_prepend(l, sizeof(struct region *), &r);
+	/* keep the load factor (tombstones included) under 3/4 so probe
+	 * sequences stay short, only growing if live regions need the space */
+	if ((t->len + t->tombstones + 1) * 4 > t->cap * 3) {
+		size_t cap = t->cap;
+		if ((t->len + 1) * 2 > cap)
+			cap *= 2;
+		world_rebuild_regions(w, cap);
+		t = atomic_load_explicit(&(w->regions), memory_order_relaxed);
+	}
+
+	size_t i = region_free_slot(t, r->x, r->z);
+	if (load_slot(t, i) == TOMBSTONE)
+		--(t->tombstones);
+	++(t->len);
+	/* release, so readers that find r also see everything written to it */
+	atomic_store_explicit(&(t->slots[i]), r, memory_order_release);
+}
+
+struct region *world_region_get(struct world *w, int x, int z) {
+	struct region_table *t = atomic_load_explicit(&(w->regions), memory_order_acquire);
+	return region_find(t, x, z, NULL);
+}
+
+struct chunk *world_chunk_get(struct world *w, int x, int z) {
+	struct region *r = world_region_get(w, floor_div(x, 32), floor_div(z, 32));
+	if (r == NULL)
+		return NULL;
+	return atomic_load_explicit(&(r->chunks[z & 31][x & 31]), memory_order_acquire);
+}
+
+struct region *world_region_at(struct world *w, int x, int z) {
+	struct region *r = w->last_region;
+	if (r != NULL && r->x == x && r->z == z)
+		return r;
+
+	r = world_region_get(w, x, z);
+	if (r != NULL)
+		w->last_region = r;
+	return r;
+}
+
+static bool lru_contains(struct world *w, struct chunk *c) {
+	return c->lru_prev != NULL || w->lru_head == c;
+}
 
-		struct node *greater_z = list_find(w->regions, &region_list_z_greater, r);
-		list_prepend(greater_z, sizeof(struct node *), &l);
-	} else {
-		region_list = list_find(region_list, &region_list_x_greater, r);
-		list_prepend(region_list, sizeof(struct region *), r);
+static void lru_unlink(struct world *w, struct chunk *c) {
+	if (!lru_contains(w, c))
+		return;
+	if (c->lru_prev != NULL)
+		c->lru_prev->lru_next = c->lru_next;
+	else
+		w->lru_head = c->lru_next;
+	if (c->lru_next != NULL)
+		c->lru_next->lru_prev = c->lru_prev;
+	else
+		w->lru_tail = c->lru_prev;
+	c->lru_prev = NULL;
+	c->lru_next = NULL;
+}
+
+static void lru_push(struct world *w, struct chunk *c) {
+	c->lru_prev = NULL;
+	c->lru_next = w->lru_head;
+	if (w->lru_head != NULL)
+		w->lru_head->lru_prev = c;
+	else
+		w->lru_tail = c;
+	w->lru_head = c;
+}
+
+/* looks up a chunk without counting it as used */
+static struct chunk *world_chunk_peek(struct world *w, int x, int z) {
+	struct region *r = world_region_at(w, floor_div(x, 32), floor_div(z, 32));
+	if (r == NULL)
+		return NULL;
+	return atomic_load_explicit(&(r->chunks[z & 31][x & 31]), memory_order_relaxed);
+}
+
+static void cold_unlink(struct world *w, struct cold_chunk *cc) {
+	if (cc->lru_prev != NULL)
+		cc->lru_prev->lru_next = cc->lru_next;
+	else
+		w->cold_head = cc->lru_next;
+	if (cc->lru_next != NULL)
+		cc->lru_next->lru_prev = cc->lru_prev;
+	else
+		w->cold_tail = cc->lru_prev;
+	cc->lru_prev = NULL;
+	cc->lru_next = NULL;
+}
+
+static void cold_push(struct world *w, struct cold_chunk *cc) {
+	cc->lru_prev = NULL;
+	cc->lru_next = w->cold_head;
+	if (w->cold_head != NULL)
+		w->cold_head->lru_prev = cc;
+	else
+		w->cold_tail = cc;
+	w->cold_head = cc;
+}
+
+static size_t cold_chunk_mem(const struct cold_chunk *cc) {
+	return sizeof(struct cold_chunk) + cc->len;
+}
+
+static void world_drop_cold(struct world *w, struct region *r, struct cold_chunk *cc) {
+	cold_unlink(w, cc);
+	w->cold_mem -= cold_chunk_mem(cc);
+	r->cold[cc->z & 31][cc->x & 31] = NULL;
+	--(r->cold_len);
+	free_cold_chunk(cc);
+}
+
+static void world_freeze_chunk(struct world *w, struct region *r, struct chunk *c) {
+	struct cold_chunk *cc = chunk_freeze(c);
+	if (cc == NULL)
+		return;
+	struct cold_chunk *old = r->cold[c->z & 31][c->x & 31];
+	if (old != NULL)
+		world_drop_cold(w, r, old);
+	r->cold[c->z & 31][c->x & 31] = cc;
+	++(r->cold_len);
+	w->cold_mem += cold_chunk_mem(cc);
+	cold_push(w, cc);
+}
+
+struct chunk *world_chunk(struct world *w, int x, int z) {
+	struct chunk *c = world_chunk_peek(w, x, z);
+	if (c != NULL && lru_contains(w, c) && w->lru_head != c) {
+		lru_unlink(w, c);
+		lru_push(w, c);
 	}
+
+	if (c == NULL) {
+		struct region *r = world_region_at(w, floor_div(x, 32), floor_div(z, 32));
+		struct cold_chunk *cc = r != NULL ? r->cold[z & 31][x & 31] : NULL;
+		if (cc != NULL) {
+			c = chunk_thaw(cc);
+			world_drop_cold(w, r, cc);
+			if (c != NULL) {
+				++(w->cold_hits);
+				world_add_chunk(w, x, z, c);
+			}
+		}
+	}
+	return c;
 }
 
-bool region_list_x_equal(void *list, void *item) {
-	struct region *r1 = item;
-	struct region *r2 = list;
-	return r1->x == r2->x;
+struct chunk *world_chunk_at(struct world *w, int x, int z) {
+	return world_chunk(w, floor_div(x, 16), floor_div(z, 16));
 }
 
-struct node *find_region_sublist(struct world *w, struct region *r) {
-	struct node *sublist = NULL;
+static void free_chunk_item(void *c) {
+	free_chunk(c);
+}
 
-	struct node *n = list_find(w->regions, &region_list_z_equal, r);
-	if (!list_empty(n)) {
-		n = list_find(list_item(n), &region_list_x_equal, r);
-		if (!list_empty(n)) {
-			sublist = n;
+static struct region_file *world_region_file(struct world *w, struct region *r) {
+	if (r->file == NULL) {
+		char path[256];
+		snprintf(path, 256, "%s/region/r.%d.%d.mca", w->level_path, r->x, r->z);
+		r->file = region_file_open(path);
+		if (r->file == NULL && errno != ENOENT) {
+			char err[300];
+			snprintf(err, 300, "error opening '%s'", path);
+			perror(err);
 		}
 	}
+	return r->file;
+}
 
-	return sublist;
+static void dirty_remove(struct world *w, struct chunk *c) {
+	struct chunk *last = w->dirty[--(w->dirty_len)];
+	w->dirty[c->dirty_index] = last;
+	last->dirty_index = c->dirty_index;
 }
 
-struct region *world_region_at(struct world *w, int x, int z) {
-	struct region search_region = {0};
-	search_region.x = x;
-	search_region.z = z;
+/* saves that failed go back on the dirty list if their chunk is still
+ * loaded, so the next save of it includes them. otherwise nothing can have
+ * changed since, so they're queued again as they are. this runs before the
+ * last save of a chunk that's being forgotten is queued, so a retried save
+ * never goes after it. regions are out of the table by the time their chunks
+ * are forgotten, so this never marks a chunk that's already been forgotten */
+static void world_retry_saves(struct world *w) {
+	struct chunk_save *s = save_take_failed();
+	while (s != NULL) {
+		struct chunk_save *next = s->next;
+		struct chunk *c = world_chunk_peek(w, s->x, s->z);
+		if (c == NULL) {
+			save_retry(w->pool, s);
+			s = next;
+			continue;
+		}
+		for (int i = 0; i < s->sections_len; ++i) {
+			for (int j = 0; j < c->sections_len; ++j) {
+				if (c->sections[j]->y == s->sections[i]->y)
+					world_mark_dirty(w, c, j);
+			}
+		}
+		save_discard(s);
+		s = next;
+	}
+}
 
-	struct node *list = find_region_sublist(w, &search_region);
-	if (list == NULL) {
-		return NULL;
-	} else {
-		return list_item(list);
+static void world_save_chunk(struct world *w, struct region *r, struct chunk *c) {
+	dirty_remove(w, c);
+	struct region_file *rf = world_region_file(w, r);
+	if (rf == NULL) {
+		fprintf(stderr, "can't save chunk (%d, %d), its region file isn't open\n", c->x, c->z);
+		c->dirty_sections = 0;
+		return;
 	}
+	if (save_chunk(w->pool, rf, c) < 0)
+		c->dirty_sections = 0;
 }
 
-struct chunk *world_chunk_at(struct world *w, int x, int z) {
-	struct chunk *c = NULL;
+/* takes a chunk out of the world's bookkeeping, without touching its slot.
+ * unsaved changes get saved first */
+static void world_forget_chunk(struct world *w, struct region *r, struct chunk *c) {
+	if (c->dirty_sections != 0) {
+		world_retry_saves(w);
+		world_save_chunk(w, r, c);
+	}
+	lru_unlink(w, c);
+	w->chunk_mem -= c->mem;
+	--(r->chunks_len);
+}
+
+static void world_forget_region(struct world *w, struct region *r) {
+	for (int z = 0; z < 32; ++z) {
+		for (int x = 0; x < 32; ++x) {
+			struct chunk *c = atomic_load_explicit(&(r->chunks[z][x]), memory_order_relaxed);
+			if (c != NULL)
+				world_forget_chunk(w, r, c);
+			/* the region frees its cold chunks itself */
+			struct cold_chunk *cc = r->cold[z][x];
+			if (cc != NULL) {
+				cold_unlink(w, cc);
+				w->cold_mem -= cold_chunk_mem(cc);
+			}
+		}
+	}
+}
 
-	int r_x = x / 512;
-	int r_z = z / 512;
+void world_add_chunk(struct world *w, int x, int z, struct chunk *c) {
+	int r_x = floor_div(x, 32);
+	int r_z = floor_div(z, 32);
 	struct region *r = world_region_at(w, r_x, r_z);
-	if (r != NULL) {
-		int c_x = (x % 512) / 16;
-		int c_z = (z % 512) / 16;
-		c = r->chunks[c_z][c_x];
+	if (r == NULL) {
+		r = calloc(1, sizeof(struct region));
+		r->x = r_x;
+		r->z = r_z;
+		world_add_region(w, r);
 	}
 
+	struct chunk *old = atomic_load_explicit(&(r->chunks[z & 31][x & 31]), memory_order_relaxed);
+	if (old == c)
+		return;
+	if (old != NULL)
+		world_forget_chunk(w, r, old);
+	if (r->cold[z & 31][x & 31] != NULL)
+		world_drop_cold(w, r, r->cold[z & 31][x & 31]);
+
+	c->x = x;
+	c->z = z;
+	w->chunk_mem += chunk_mem(c);
+	++(r->chunks_len);
+	if (c->tickets == 0)
+		lru_push(w, c);
+
+	atomic_store_explicit(&(r->chunks[z & 31][x & 31]), c, memory_order_release);
+	if (old != NULL)
+		epoch_retire(&(w->epoch), old, free_chunk_item);
+}
+
+void world_remove_chunk(struct world *w, int x, int z) {
+	struct region *r = world_region_at(w, floor_div(x, 32), floor_div(z, 32));
+	if (r == NULL)
+		return;
+
+	struct chunk *old = atomic_exchange(&(r->chunks[z & 31][x & 31]), NULL);
+	if (old == NULL)
+		return;
+	world_forget_chunk(w, r, old);
+	epoch_retire(&(w->epoch), old, free_chunk_item);
+
+	/* empty regions are only holding on to their file */
+	if (r->chunks_len == 0 && r->cold_len == 0)
+		world_remove_region(w, r);
+}
+
+struct chunk *world_load_chunk(struct world *w, int x, int z) {
+	struct chunk *c = world_chunk(w, x, z);
+	if (c != NULL)
+		return c;
+
+	int r_x = floor_div(x, 32);
+	int r_z = floor_div(z, 32);
+	struct region *r = world_region_at(w, r_x, r_z);
+	if (r == NULL) {
+		r = calloc(1, sizeof(struct region));
+		r->x = r_x;
+		r->z = r_z;
+		world_add_region(w, r);
+	}
+
+	struct region_file *rf = world_region_file(w, r);
+	if (rf != NULL) {
+		ssize_t len = region_file_read_chunk(rf, x, z, &(w->chunk_buf_len), &(w->chunk_buf));
+		if (len < 0) {
+			fprintf(stderr, "error reading chunk (%d, %d)\n", x, z);
+		} else if (len > 0) {
+			++(w->cold_misses);
+			c = parse_chunk(len, w->chunk_buf, &(w->palettes));
+			if (c == NULL)
+				fprintf(stderr, "error parsing chunk (%d, %d)\n", x, z);
+			else
+				world_add_chunk(w, x, z, c);
+		}
+	}
+
+	if (c == NULL && r->chunks_len == 0 && r->cold_len == 0)
+		world_remove_region(w, r);
 	return c;
 }
 
-void world_remove_region(struct world *w, struct region *r) {
-	struct node *list = find_region_sublist(w, r);
-	if (list != NULL) {
-		list_remove(list);
+struct chunk *world_add_ticket(struct world *w, int x, int z) {
+	struct chunk *c = world_load_chunk(w, x, z);
+	if (c != NULL && c->tickets++ == 0)
+		lru_unlink(w, c);
+	return c;
+}
+
+void world_remove_ticket(struct world *w, int x, int z) {
+	struct chunk *c = world_chunk_peek(w, x, z);
+	if (c != NULL && c->tickets > 0 && --(c->tickets) == 0)
+		lru_push(w, c);
+}
+
+void world_mark_dirty(struct world *w, struct chunk *c, int section) {
+	if (c->dirty_sections == 0) {
+		if (w->dirty_len == w->dirty_cap) {
+			w->dirty_cap = w->dirty_cap == 0 ? 64 : w->dirty_cap * 2;
+			w->dirty = realloc(w->dirty, sizeof(struct chunk *) * w->dirty_cap);
+		}
+		c->dirty_index = w->dirty_len;
+		w->dirty[w->dirty_len++] = c;
+	}
+	c->dirty_sections |= 1 << section;
+	w->chunk_mem -= c->mem;
+	w->chunk_mem += chunk_mem(c);
+}
+
+void world_place_block(struct world *w, int x, int y, int z) {
+	struct chunk *c = world_chunk_at(w, x, z);
+	if (c == NULL)
+		return;
+	int i = floor_div(y, 16) + 1;
+	if (i >= 0 && i < c->sections_len && c->sections[i]->bits_per_block > 0) {
+		printf("INFO: writing blockstate to (%d,%d,%d)\n", x, y, z);
+		/* TODO: track what the player is holding and write that block
+		 *       instead of some random block from the palette */
+		struct section *s = chunk_section_mut(c, i);
+		write_blockstate_at(s, x, y, z, s->palette_len - 1);
+		world_mark_dirty(w, c, i);
+	}
+}
+
+int world_save_dirty(struct world *w) {
+	world_retry_saves(w);
+	int saved = 0;
+	while (w->dirty_len > 0) {
+		struct chunk *c = w->dirty[w->dirty_len - 1];
+		world_save_chunk(w, world_region_at(w, floor_div(c->x, 32), floor_div(c->z, 32)), c);
+		++saved;
 	}
+	return saved;
+}
+
+int world_unload_chunks(struct world *w) {
+	int unloaded = 0;
+	struct chunk *c = w->lru_tail;
+	while (c != NULL && w->chunk_mem > w->chunk_mem_budget) {
+		struct chunk *prev = c->lru_prev;
+		if (w->cold_mem_budget > 0)
+			world_freeze_chunk(w, world_region_at(w, floor_div(c->x, 32), floor_div(c->z, 32)), c);
+		world_remove_chunk(w, c->x, c->z);
+		++unloaded;
+		c = prev;
+	}
+
+	while (w->cold_mem > w->cold_mem_budget && w->cold_tail != NULL) {
+		struct cold_chunk *cc = w->cold_tail;
+		struct region *r = world_region_at(w, floor_div(cc->x, 32), floor_div(cc->z, 32));
+		world_drop_cold(w, r, cc);
+		if (r->chunks_len == 0 && r->cold_len == 0)
+			world_remove_region(w, r);
+	}
+	return unloaded;
+}
+
+static void free_region_item(void *r) {
+	free_region(r);
+	free(r);
+}
+
+void world_remove_region(struct world *w, struct region *r) {
+	struct region_table *t = atomic_load_explicit(&(w->regions), memory_order_relaxed);
+	size_t i;
+	struct region *removed = region_find(t, r->x, r->z, &i);
+	if (removed == NULL)
+		return;
+
+	if (w->last_region == removed)
+		w->last_region = NULL;
+	/* out of the table first, so saves retried while its chunks are saved
+	 * can't find them (see world_retry_saves()) */
+	atomic_store_explicit(&(t->slots[i]), TOMBSTONE, memory_order_release);
+	world_forget_region(w, removed);
+	--(t->len);
+	++(t->tombstones);
+	epoch_retire(&(w->epoch), removed, free_region_item);
+}
+
+void world_collect(struct world *w) {
+	epoch_collect(&(w->epoch));
 }
 
 void world_free(struct world *w) {
-	struct node *regions_list = w->regions;
-	while (!list_empty(regions_list)) {
-		struct node *region_list = list_item(regions_list);
-		while (!list_empty(region_list)) {
-			free(list_remove(region_list));
-		}
-		regions_list = list_next(regions_list);
+	struct chunk_save *s = save_take_failed();
+	while (s != NULL) {
+		struct chunk_save *next = s->next;
+		fprintf(stderr, "changes to chunk (%d, %d) couldn't be saved\n", s->x, s->z);
+		save_discard(s);
+		s = next;
+	}
+
+	epoch_finish(&(w->epoch));
+	struct region_table *t = atomic_load(&(w->regions));
+	for (size_t i = 0; i < t->cap; ++i) {
+		struct region *r = load_slot(t, i);
+		if (r != NULL && r != TOMBSTONE)
+			free_region_item(r);
 	}
-	hashmap_free(w->block_table, free);
+	free(t);
+	free(w->dirty);
+	free(w->chunk_buf);
+	palette_cache_free(&(w->palettes));
 }
@@ -1,16 +1,82 @@
 #ifndef CHOWDER_WORLD_H
 #define CHOWDER_WORLD_H
 
-#include "include/hashmap.h"
-#include "include/linked_list.h"
+#include <stdatomic.h>
+
+#include "epoch.h"
+#include "pool.h"
 #include "region.h"
 
+/* open-addressed hash table of regions, keyed on region x,z. it's only ever
+ * changed by the tick thread, other threads read it without locking, and
+ * it's replaced wholesale (and the old one retired) when it needs to grow */
+struct region_table {
+	/* always a power of 2 */
+	size_t cap;
+	size_t len;
+	size_t tombstones;
+	_Atomic(struct region *) slots[];
+};
+
 struct world {
-	struct hashmap *block_table;
-	/* 2D linked-list of loaded regions */
-	struct node *regions;
+	/* directory holding the level's region/ folder */
+	const char *level_path;
+	_Atomic(struct region_table *) regions;
+	/* regions + chunks removed from the world are freed through here */
+	struct epoch epoch;
+	/* most lookups land in the same region as the one before them.
+	 * only used by the tick thread */
+	struct region *last_region;
+
+	/* Loaded chunks stay in memory while they have tickets (some player can
+	 * see them). Chunks without tickets sit in an LRU list, most recently
+	 * used first, and get unloaded from the tail by world_unload_chunks()
+	 * whenever chunk_mem goes over chunk_mem_budget. */
+	size_t chunk_mem;
+	size_t chunk_mem_budget;
+	struct chunk *lru_head;
+	struct chunk *lru_tail;
+
+	/* Chunks unloaded by world_unload_chunks() are frozen (see struct
+	 * cold_chunk) instead of dropped, as long as frozen chunks fit in
+	 * cold_mem_budget, and the next lookup of one thaws it. The LRU list
+	 * has the most recently frozen first. 0 turns this off */
+	size_t cold_mem;
+	size_t cold_mem_budget;
+	struct cold_chunk *cold_head;
+	struct cold_chunk *cold_tail;
+	/* metrics: lookups of unloaded chunks that were thawed, and ones that
+	 * had to be read from the region file instead. lookups of chunks the
+	 * file doesn't have aren't either */
+	size_t cold_hits;
+	size_t cold_misses;
+
+	/* chunks with changes that haven't been saved yet. they're saved on
+	 * w->pool (or right away, if it's NULL) by world_save_dirty() and
+	 * whenever they're unloaded. ones that fail to save are marked dirty
+	 * again, or retried as they were if the chunk's gone */
+	struct pool *pool;
+	size_t dirty_len;
+	size_t dirty_cap;
+	struct chunk **dirty;
+
+	/* reused for every chunk read from disk */
+	size_t chunk_buf_len;
+	Bytef *chunk_buf;
+	struct palette_cache palettes;
 };
 
+/* division that rounds towards negative infinity, so block -1 is in chunk -1
+ * and chunk -1 is in region -1 instead of both being in 0 */
+static inline int floor_div(int a, int b) {
+	int q = a / b;
+	if ((a % b != 0) && ((a < 0) != (b < 0)))
+		--q;
+	return q;
+}
+
+/* Everything below is only safe to call from the tick thread, which is
+ * the only thread allowed to change the world. */
 struct world *world_new();
 void world_add_region(struct world *, struct region *);
 /* Takes region x,z coords */
@@ -18,9 +84,53 @@ struct region *world_region_at(struct world *, int x, int z);
 /* TODO: implement this */
 /* Takes world x,z coords */
 struct chunk **world_chunks(struct world *, int x1, int x2, int z1, int z2);
+/* Takes world x,z coords */
 struct chunk *world_chunk_at(struct world *, int x, int z);
+/* Takes chunk x,z coords. Thaws the chunk if it's cold */
+struct chunk *world_chunk(struct world *, int x, int z);
+/* Takes chunk x,z coords. Creates the chunk's region if it isn't loaded, and
+ * retires whatever chunk was there before */
+void world_add_chunk(struct world *, int x, int z, struct chunk *);
+/* Takes chunk x,z coords. The chunk is freed once no reader can see it */
+void world_remove_chunk(struct world *, int x, int z);
+/* Takes chunk x,z coords. Returns the loaded chunk, reading it from the
+ * level's region files if it isn't loaded yet. Returns NULL if the chunk
+ * doesn't exist or couldn't be read */
+struct chunk *world_load_chunk(struct world *, int x, int z);
 
+/* Takes chunk x,z coords. Tickets pin a chunk in memory; adding one loads the
+ * chunk and returns it (or NULL if there's no chunk there) */
+struct chunk *world_add_ticket(struct world *, int x, int z);
+void world_remove_ticket(struct world *, int x, int z);
+/* call after changing blocks in c->sections[section], so the change gets
+ * saved */
+void world_mark_dirty(struct world *, struct chunk *c, int section);
+/* Takes world x,y,z coords. Does nothing if the chunk isn't there */
+void world_place_block(struct world *, int x, int y, int z);
+/* queues every dirty chunk to be saved. returns how many were queued */
+int world_save_dirty(struct world *);
+/* unloads least recently used chunks without tickets until the world's
+ * chunks fit in w->chunk_mem_budget, freezing them if there's room in
+ * w->cold_mem_budget. returns how many were unloaded */
+int world_unload_chunks(struct world *);
+
+/* removes the region from the world, and frees it + its chunks once no
+ * reader can see them */
 void world_remove_region(struct world *, struct region *);
+/* frees regions + chunks retired since the last call, if no readers can
+ * still see them. call it once a tick */
+void world_collect(struct world *);
 void world_free(struct world *w);
 
+/* Lookups for any thread. They have to happen between epoch_enter() and
+ * epoch_exit() on a reader made with epoch_reader_new(&w->epoch), and the
+ * pointers they return are only valid until epoch_exit().
+ *
+ * Nothing reads the world this way yet: shards only run while the tick
+ * thread waits for them, and only use chunks the tick thread handed them
+ * (see chunk_sender_plan()), so they don't need readers. */
+struct region *world_region_get(struct world *, int x, int z);
+/* Takes chunk x,z coords */
+struct chunk *world_chunk_get(struct world *, int x, int z);
+
 #endif